@@ -30,6 +30,11 @@
 #include <iostream>
 #include <stdio.h>
 
+// The vector Viterbi decoder needs only SSE2, which every x86-64 compiler enables.
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 
@@ -198,10 +203,42 @@ void BitVector::LSB8MSB()
 
 
 
+void Generator::computeTable()
+{
+	// Registers shorter than a byte are widened with zeros below,
+	// which scales every remainder by the same power of x.
+	const unsigned width = mLen + mPad;
+	const uint64_t coeff = mCoeff << mPad;
+	const uint64_t mask = (1ULL<<width)-1;
+	for (unsigned byte=0; byte<256; byte++) {
+		uint64_t reg = ((uint64_t)byte) << (width-8);
+		for (unsigned i=0; i<8; i++) {
+			const unsigned fb = (reg>>(width-1)) & 0x01;
+			reg <<= 1;
+			if (fb) reg ^= coeff;
+		}
+		mTable[byte] = reg & mask;
+	}
+}
+
+
+
+/** Pack the next 8 bits into a byte, the first in the MSB. */
+static inline unsigned packByte(const char *dp)
+{
+	unsigned byte = 0;
+	for (unsigned i=0; i<8; i++) byte = (byte<<1) | (dp[i] & 0x01);
+	return byte;
+}
+
+
 uint64_t BitVector::syndrome(Generator& gen) const
 {
 	gen.clear();
 	const char *dp = mStart;
+	if (gen.size()>=8) {
+		for (; dp+8<=mEnd; dp+=8) gen.syndromeShift8(packByte(dp));
+	}
 	while (dp<mEnd) gen.syndromeShift(*dp++);
 	return gen.state();
 }
@@ -211,6 +248,7 @@ uint64_t BitVector::parity(Generator& gen) const
 {
 	gen.clear();
 	const char *dp = mStart;
+	for (; dp+8<=mEnd; dp+=8) gen.encoderShift8(packByte(dp));
 	while (dp<mEnd) gen.encoderShift(*dp++);
 	return gen.state();
 }
@@ -297,6 +335,7 @@ ViterbiR2O4::ViterbiR2O4()
 	computeStateTables(0);
 	computeStateTables(1);
 	computeGeneratorTable();
+	computeBranchMasks();
 }
 
 
@@ -330,6 +369,20 @@ void ViterbiR2O4::computeGeneratorTable()
 	}
 }
 
+void ViterbiR2O4::computeBranchMasks()
+{
+	// Decoding starts with every survivor in the zero state, so during the first
+	// mOrder steps candidate c holds only its low step+1 input bits.
+	for (unsigned step=0; step<=mOrder; step++) {
+		const uint32_t iMask = (0x02<<step)-1;
+		for (unsigned c=0; c<mNumCands; c++) {
+			const uint32_t output = mGeneratorTable[c & iMask & mCMask];
+			mBranchMasks[step][0][c] = (output & 0x02) ? 0xffffffff : 0;
+			mBranchMasks[step][1][c] = (output & 0x01) ? 0xffffffff : 0;
+		}
+	}
+}
+
 
 
 
@@ -448,17 +501,22 @@ BitVector SoftVector::sliced() const
 
 
 
-void SoftVector::decode(ViterbiR2O4 &decoder, BitVector& target) const
+/**
+	Build the inputs of the Viterbi decoder.
+	@param in The soft coded bits.
+	@param ctsz Length of the tables, the input padded by the deferral.
+	@param history Each hard bit with all of the bits before it.
+	@param matchCostTable Cost of each bit matching a candidate.
+	@param mismatchCostTable Cost of each bit not matching a candidate.
+*/
+static void buildViterbiTables(const SoftVector& in, size_t ctsz, uint32_t *history,
+	float *matchCostTable, float *mismatchCostTable)
 {
-	const size_t sz = size();
-	const unsigned deferral = decoder.deferral();
-	const size_t ctsz = sz + deferral*decoder.iRate();
-	assert(sz <= decoder.iRate()*target.size());
+	const size_t sz = in.size();
 
 	// Build a "history" array where each element contains the full history.
-	uint32_t history[ctsz];
 	{
-		BitVector bits = sliced();
+		BitVector bits = in.sliced();
 		uint32_t accum = 0;
 		for (size_t i=0; i<sz; i++) {
 			accum = (accum<<1) | bits.bit(i);
@@ -472,10 +530,8 @@ void SoftVector::decode(ViterbiR2O4 &decoder, BitVector& target) const
 	}
 
 	// Precompute metric tables.
-	float matchCostTable[ctsz];
-	float mismatchCostTable[ctsz];
 	{
-		const float *dp = mStart;
+		const float *dp = in.begin();
 		for (size_t i=0; i<sz; i++) {
 			// pVal is the probability that a bit is correct.
 			// ipVal is the probability that a bit is incorrect.
@@ -495,12 +551,26 @@ void SoftVector::decode(ViterbiR2O4 &decoder, BitVector& target) const
 			mismatchCostTable[i] = 0.5F;
 		}
 	}
+}
+
+
+void ViterbiR2O4::decodeScalar(const SoftVector& in, BitVector& target)
+{
+	const size_t sz = in.size();
+	const unsigned deferral = mDeferral;
+	const size_t ctsz = sz + deferral*mIRate;
+	assert(sz <= mIRate*target.size());
+
+	uint32_t history[ctsz];
+	float matchCostTable[ctsz];
+	float mismatchCostTable[ctsz];
+	buildViterbiTables(in,ctsz,history,matchCostTable,mismatchCostTable);
 
 	{
-		decoder.initializeStates();
+		initializeStates();
 		// Each sample of history[] carries its history.
 		// So we only have to process every iRate-th sample.
-		const unsigned step = decoder.iRate();
+		const unsigned step = mIRate;
 		// input pointer
 		const uint32_t *ip = history + step - 1;
 		// output pointers
@@ -514,7 +584,7 @@ void SoftVector::decode(ViterbiR2O4 &decoder, BitVector& target) const
 			// Viterbi algorithm
 			assert(match-matchCostTable<sizeof(matchCostTable)/sizeof(matchCostTable[0])-1);
 			assert(mismatch-mismatchCostTable<sizeof(mismatchCostTable)/sizeof(mismatchCostTable[0])-1);
-			const ViterbiR2O4::vCand &minCost = decoder.step(*ip, match, mismatch);
+			const ViterbiR2O4::vCand &minCost = this->step(*ip, match, mismatch);
 			ip += step;
 			match += step;
 			mismatch += step;
@@ -526,6 +596,122 @@ void SoftVector::decode(ViterbiR2O4 &decoder, BitVector& target) const
 }
 
 
+#ifdef __SSE2__
+
+void ViterbiR2O4::decodeVector(const SoftVector& in, BitVector& target)
+{
+	// This follows decodeScalar step by step with the 16 survivors in lanes,
+	// survivor i in lane i%4 of register i/4.  The costs are added in the
+	// same order as the scalar decoder so the results are bit-exact.
+	const size_t sz = in.size();
+	const unsigned deferral = mDeferral;
+	const size_t ctsz = sz + deferral*mIRate;
+	assert(sz <= mIRate*target.size());
+	assert(mIStates==16 && mIRate==2);
+
+	uint32_t history[ctsz];
+	float matchCostTable[ctsz];
+	float mismatchCostTable[ctsz];
+	buildViterbiTables(in,ctsz,history,matchCostTable,mismatchCostTable);
+
+	// Survivor costs and input states, all starting from zero.
+	__m128 cost[4];
+	__m128i iState[4];
+	for (unsigned k=0; k<4; k++) {
+		cost[k] = _mm_setzero_ps();
+		iState[k] = _mm_setzero_si128();
+	}
+	// Input bit appended by the candidates of even and odd survivors.
+	const __m128i inputBit = _mm_set_epi32(1,0,1,0);
+
+	char *op = target.begin();
+	const char *const opt = target.end();
+	size_t n = 0;
+	while (op<opt) {
+		const size_t i = n*mIRate;
+		assert(i+1<ctsz);
+		const uint32_t inSample = history[i+1];
+		const unsigned stage = (n<mOrder) ? n : mOrder;
+		const uint32_t (*masks)[mNumCands] = mBranchMasks[stage];
+
+		// Each coded bit costs one of two values, depending on whether it matches the candidate.
+		const float match1 = matchCostTable[i+1], mismatch1 = mismatchCostTable[i+1];
+		const float match0 = matchCostTable[i], mismatch0 = mismatchCostTable[i];
+		const __m128 gen1Zero = _mm_set1_ps((inSample & 0x01) ? mismatch1 : match1);
+		const __m128 gen1One = _mm_set1_ps((inSample & 0x01) ? match1 : mismatch1);
+		const __m128 gen0Zero = _mm_set1_ps((inSample & 0x02) ? mismatch0 : match0);
+		const __m128 gen0One = _mm_set1_ps((inSample & 0x02) ? match0 : mismatch0);
+
+		// Branch metric of the 32 candidates, 4 at a time.
+		__m128 metric[8];
+		for (unsigned k=0; k<8; k++) {
+			const __m128 m1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&masks[1][4*k]));
+			const __m128 m0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&masks[0][4*k]));
+			const __m128 c1 = _mm_or_ps(_mm_and_ps(m1,gen1One),_mm_andnot_ps(m1,gen1Zero));
+			const __m128 c0 = _mm_or_ps(_mm_and_ps(m0,gen0One),_mm_andnot_ps(m0,gen0Zero));
+			metric[k] = _mm_add_ps(c1,c0);
+		}
+
+		// Candidate i extends survivor i/2 and competes with candidate i+16,
+		// which extends survivor i/2+8.
+		__m128 newCost[4];
+		__m128i newState[4];
+		for (unsigned k=0; k<4; k++) {
+			const unsigned lo = k>>1;
+			const bool high = k & 0x01;
+			const __m128 cost1 = high ? _mm_unpackhi_ps(cost[lo],cost[lo]) : _mm_unpacklo_ps(cost[lo],cost[lo]);
+			const __m128 cost2 = high ? _mm_unpackhi_ps(cost[lo+2],cost[lo+2]) : _mm_unpacklo_ps(cost[lo+2],cost[lo+2]);
+			const __m128i state1 = high ? _mm_unpackhi_epi32(iState[lo],iState[lo]) : _mm_unpacklo_epi32(iState[lo],iState[lo]);
+			const __m128i state2 = high ? _mm_unpackhi_epi32(iState[lo+2],iState[lo+2]) : _mm_unpacklo_epi32(iState[lo+2],iState[lo+2]);
+			const __m128 cand1 = _mm_add_ps(cost1,metric[k]);
+			const __m128 cand2 = _mm_add_ps(cost2,metric[k+4]);
+			// Ties go to the second candidate, as in pruneCandidates.
+			const __m128 take1 = _mm_cmplt_ps(cand1,cand2);
+			const __m128i take1i = _mm_castps_si128(take1);
+			newCost[k] = _mm_or_ps(_mm_and_ps(take1,cand1),_mm_andnot_ps(take1,cand2));
+			const __m128i state = _mm_or_si128(_mm_and_si128(take1i,state1),_mm_andnot_si128(take1i,state2));
+			newState[k] = _mm_or_si128(_mm_slli_epi32(state,1),inputBit);
+		}
+		for (unsigned k=0; k<4; k++) {
+			cost[k] = newCost[k];
+			iState[k] = newState[k];
+		}
+
+		// Output the deferred bit of the first minimum cost survivor.
+		if (n>=deferral) {
+			__m128 least = _mm_min_ps(_mm_min_ps(cost[0],cost[1]),_mm_min_ps(cost[2],cost[3]));
+			least = _mm_min_ps(least,_mm_shuffle_ps(least,least,_MM_SHUFFLE(1,0,3,2)));
+			least = _mm_min_ps(least,_mm_shuffle_ps(least,least,_MM_SHUFFLE(2,3,0,1)));
+			unsigned isLeast = 0;
+			unsigned bits = 0;
+			for (unsigned k=0; k<4; k++) {
+				isLeast |= _mm_movemask_ps(_mm_cmpeq_ps(cost[k],least)) << (4*k);
+				bits |= _mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(iState[k],31-deferral))) << (4*k);
+			}
+			*op++ = (bits >> __builtin_ctz(isLeast)) & 0x01;
+		}
+		n++;
+	}
+}
+
+#endif
+
+
+void ViterbiR2O4::decode(const SoftVector& in, BitVector& target)
+{
+#ifdef __SSE2__
+	decodeVector(in,target);
+#else
+	decodeScalar(in,target);
+#endif
+}
+
+
+void SoftVector::decode(ViterbiR2O4 &decoder, BitVector& target) const
+{
+	decoder.decode(*this,target);
+}
+
 
 
 ostream& operator<<(ostream& os, const SoftVector& sv)
@@ -45,14 +45,20 @@ class Generator {
 	uint64_t mMask;		///< mask for reading state
 	unsigned mLen;		///< number of bits used in shift register
 	unsigned mLen_1;	///< mLen - 1
+	unsigned mPad;		///< zero bits below the register in mTable, for registers shorter than 8 bits
+	uint64_t mTable[256];	///< each byte times x^mLen, modulo the polynomial, shifted up by mPad
 
 	public:
 
 	Generator(uint64_t wCoeff, unsigned wLen)
 		:mCoeff(wCoeff),mState(0),
 		mMask((1ULL<<wLen)-1),
-		mLen(wLen),mLen_1(wLen-1)
-	{ assert(wLen<64); }
+		mLen(wLen),mLen_1(wLen-1),
+		mPad(wLen<8 ? 8-wLen : 0)
+	{
+		assert(wLen<64);
+		computeTable();
+	}
 
 	void clear() { mState=0; }
 
@@ -84,6 +90,32 @@ class Generator {
 		if (fb) mState ^= mCoeff;
 	}
 
+	/**
+		Calculate 8 bits of a syndrome, the same as 8 calls to syndromeShift.
+		Only for registers of 8 bits or more.
+		@param inByte The bits, the first in the MSB.
+	*/
+	void syndromeShift8(unsigned inByte)
+	{
+		const unsigned index = (mState>>(mLen-8)) & 0x0ff;
+		mState = (mState<<8) ^ mTable[index] ^ (inByte & 0x0ff);
+	}
+
+	/**
+		Update the generator state by 8 cycles, the same as 8 calls to encoderShift.
+		@param inByte The bits, the first in the MSB.
+	*/
+	void encoderShift8(unsigned inByte)
+	{
+		const uint64_t reg = mState << mPad;
+		const unsigned index = ((reg>>(mLen+mPad-8)) ^ inByte) & 0x0ff;
+		mState = ((reg<<8) ^ mTable[index]) >> mPad;
+	}
+
+	private:
+
+	/** Precompute mTable from the polynomial. */
+	void computeTable();
 
 };
 
@@ -144,6 +176,12 @@ class ViterbiR2O4 {
 		uint32_t mCoeffs[mIRate];					///< polynomial for each generator
 		uint32_t mStateTable[mIRate][2*mIStates];	///< precomputed generator output tables
 		uint32_t mGeneratorTable[2*mIStates];		///< precomputed coder output table
+		/**
+			Generator output bits of each candidate as all-ones or all-zeros lane masks,
+			for the vector decoder.  Indexed by the step, up to mOrder where the
+			candidates first reach full states, then by generator and candidate.
+		*/
+		uint32_t mBranchMasks[mOrder+1][mIRate][mNumCands];
 		//@}
 	
 	public:
@@ -194,8 +232,21 @@ class ViterbiR2O4 {
 		*/
 		const vCand& step(uint32_t inSample, const float *probs, const float *iprobs);
 
+		/**
+			Decode soft symbols, with the vector decoder where the processor has one.
+			@param in Soft coded bits, twice the length of target.
+			@param target Storage for the decoded bits.
+		*/
+		void decode(const SoftVector& in, BitVector& target);
+
+		/** Decode soft symbols one candidate at a time, the reference for the vector decoder. */
+		void decodeScalar(const SoftVector& in, BitVector& target);
+
 	private:
 
+		/** Decode soft symbols with all 16 states in SSE registers. */
+		void decodeVector(const SoftVector& in, BitVector& target);
+
 		/** Branch survivors into new candidates. */
 		void branchCandidates();
 
@@ -220,6 +271,12 @@ class ViterbiR2O4 {
 		*/
 		void computeGeneratorTable();
 
+		/**
+			Precompute the vector decoder lane masks.
+			The generator table must be defined first.
+		*/
+		void computeBranchMasks();
+
 };
 
 
@@ -85,4 +85,57 @@ int main(int argc, char *argv[])
 	cout << "tp=" << tp << endl;
 	tp.pack(ts);
 	cout << "ts=" << ts << endl;
+
+	// The vector decoder must match the scalar decoder bit for bit,
+	// for the xCCH, TCH class 1 and RACH block sizes.
+	const unsigned sizes[3] = {228, 189, 18};
+	unsigned mismatches = 0;
+	for (unsigned trial=0; trial<2400; trial++) {
+		const unsigned size = sizes[trial%3];
+		BitVector u(size);
+		for (unsigned i=0; i<size; i++) u[i] = random() & 0x01;
+		BitVector c(2*size);
+		u.encode(vCoder,c);
+		SoftVector input(c);
+		// Noise, erasures and hard errors, more of them in later trials.
+		for (unsigned i=0; i<c.size(); i++) {
+			float &p = input[i];
+			switch (random() % (trial/240+4)) {
+				case 0: p = (random() % 1000) / 999.0F; break;
+				case 1: p = 0.5F; break;
+				case 2: p = 1.0F-p; break;
+			}
+		}
+		BitVector target(size);
+		BitVector reference(size);
+		vCoder.decode(input,target);
+		vCoder.decodeScalar(input,reference);
+		for (unsigned i=0; i<size; i++) {
+			if (target.bit(i)!=reference.bit(i)) mismatches++;
+		}
+	}
+	cout << "vector Viterbi mismatches=" << mismatches << endl;
+
+	// The byte-at-a-time parity and syndrome must match the bitwise shifts,
+	// for the Fire code and the SCH, RACH and TCH parity polynomials.
+	const uint64_t coeffs[4] = {0x10004820009ULL, 0x0575, 0x06f, 0x0b};
+	const unsigned lengths[4] = {40, 10, 6, 3};
+	unsigned parityMismatches = 0;
+	for (unsigned g=0; g<4; g++) {
+		Parity gen(coeffs[g],lengths[g],0);
+		Generator ref(coeffs[g],lengths[g]);
+		for (unsigned trial=0; trial<1000; trial++) {
+			BitVector v(random() % 300);
+			for (unsigned i=0; i<v.size(); i++) v[i] = random() & 0x01;
+			ref.clear();
+			for (unsigned i=0; i<v.size(); i++) ref.encoderShift(v.bit(i));
+			if (v.parity(gen)!=ref.state()) parityMismatches++;
+			ref.clear();
+			for (unsigned i=0; i<v.size(); i++) ref.syndromeShift(v.bit(i));
+			if (v.syndrome(gen)!=ref.state()) parityMismatches++;
+		}
+	}
+	cout << "byte parity mismatches=" << parityMismatches << endl;
+
+	return (mismatches || parityMismatches) ? 1 : 0;
 }
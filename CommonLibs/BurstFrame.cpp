@@ -0,0 +1,161 @@
+/*
+* Copyright 2012 Free Software Foundation, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "BurstFrame.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+
+/** Bytes of packed hard bits. */
+static const size_t gHardBytes = (BURST_RECORD_BITS+7)/8;
+
+/** Burst lengths after the header, including the per-burst fields. */
+static const size_t gHardLength = 1+4+1+gHardBytes;
+static const size_t gSoftLength = 1+4+1+2+BURST_RECORD_BITS;
+
+
+static char *writeTime(char *wp, unsigned TN, uint32_t FN, int level)
+{
+	*wp++ = TN;
+	*wp++ = (FN>>24) & 0x0ff;
+	*wp++ = (FN>>16) & 0x0ff;
+	*wp++ = (FN>>8) & 0x0ff;
+	*wp++ = FN & 0x0ff;
+	*wp++ = level;
+	return wp;
+}
+
+
+static const unsigned char *readTime(const unsigned char *rp, BurstRecord& record)
+{
+	record.TN = *rp++;
+	record.FN = *rp++;
+	record.FN = (record.FN<<8) | (*rp++);
+	record.FN = (record.FN<<8) | (*rp++);
+	record.FN = (record.FN<<8) | (*rp++);
+	record.power = (signed char)(*rp++);
+	return rp;
+}
+
+
+
+
+BurstFrame::BurstFrame(Format wFormat, unsigned wBatch)
+	:mFormat(wFormat),mBatch(wBatch)
+{
+	if (mBatch<1) mBatch = 1;
+	if (mBatch>BURST_FRAME_MAX) mBatch = BURST_FRAME_MAX;
+	clear();
+}
+
+
+void BurstFrame::clear()
+{
+	mCount = 0;
+	mBuffer[0] = BURST_FRAME_MARKER | BURST_FRAME_VERSION;
+	mBuffer[1] = mFormat;
+	mBuffer[2] = 0;
+	mBuffer[3] = 0;
+	mSize = BURST_FRAME_HEADER;
+}
+
+
+void BurstFrame::addHard(unsigned TN, uint32_t FN, int power, const char* bits)
+{
+	assert(mFormat==HardPacked);
+	assert(mCount<BURST_FRAME_MAX);
+
+	char *wp = writeTime(mBuffer+mSize,TN,FN,power);
+	memset(wp,0,gHardBytes);
+	for (unsigned i=0; i<BURST_RECORD_BITS; i++) {
+		if (bits[i] & 0x01) wp[i/8] |= 0x80 >> (i%8);
+	}
+
+	mSize += gHardLength;
+	mBuffer[2] = ++mCount;
+}
+
+
+void BurstFrame::addSoft(unsigned TN, uint32_t FN, int RSSI, int timing, const float* bits)
+{
+	assert(mFormat==SoftInt8);
+	assert(mCount<BURST_FRAME_MAX);
+
+	char *wp = writeTime(mBuffer+mSize,TN,FN,RSSI);
+	*wp++ = (timing>>8) & 0x0ff;
+	*wp++ = timing & 0x0ff;
+	// Same quantization as the single burst interface, offset to be signed.
+	for (unsigned i=0; i<BURST_RECORD_BITS; i++) {
+		*wp++ = (signed char)((int)round(bits[i]*255.0F) - 128);
+	}
+
+	mSize += gSoftLength;
+	mBuffer[2] = ++mCount;
+}
+
+
+int BurstFrame::parse(const char* buffer, size_t length, BurstRecord* records)
+{
+	const unsigned char *rp = (const unsigned char*)buffer;
+
+	if (!isFrame(buffer,length)) return -1;
+	if (rp[0]!=(BURST_FRAME_MARKER | BURST_FRAME_VERSION)) return -1;
+
+	unsigned count = rp[2];
+	if (count>BURST_FRAME_MAX) return -1;
+
+	size_t burstLength;
+	switch (rp[1]) {
+		case HardPacked: burstLength = gHardLength; break;
+		case SoftInt8: burstLength = gSoftLength; break;
+		default: return -1;
+	}
+	if (length!=BURST_FRAME_HEADER+count*burstLength) return -1;
+
+	rp += BURST_FRAME_HEADER;
+	for (unsigned n=0; n<count; n++) {
+		BurstRecord& record = records[n];
+		rp = readTime(rp,record);
+		if (buffer[1]==HardPacked) {
+			record.timing = 0;
+			for (unsigned i=0; i<BURST_RECORD_BITS; i++) {
+				record.data[i] = (rp[i/8] >> (7-i%8)) & 0x01;
+			}
+			rp += gHardBytes;
+		} else {
+			int timing = (signed char)(*rp++);
+			record.timing = (timing<<8) | (*rp++);
+			for (unsigned i=0; i<BURST_RECORD_BITS; i++) {
+				record.data[i] = (signed char)(*rp++) + 128;
+			}
+		}
+	}
+	return count;
+}
+
+
+// vim: ts=4 sw=4
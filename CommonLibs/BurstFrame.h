@@ -0,0 +1,124 @@
+/*
+* Copyright 2012 Free Software Foundation, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef BURSTFRAME_H
+#define BURSTFRAME_H
+
+#include "BurstRing.h"
+#include "Sockets.h"
+
+
+/** Version of the framing produced by this build. */
+#define BURST_FRAME_VERSION		1
+
+/**
+	Set in the first byte of a framed datagram.
+	The first byte of a single burst datagram is a timeslot number, so the two never collide.
+*/
+#define BURST_FRAME_MARKER		0x80
+
+/** Most bursts carried in one datagram, a frame of 8 timeslots. */
+#define BURST_FRAME_MAX			8
+
+/** Length of the datagram header. */
+#define BURST_FRAME_HEADER		4
+
+
+/**
+	A datagram carrying a batch of bursts on the TRX data interface.
+
+	The header is the marker ORed with the version, the payload format, the
+	burst count and a reserved zero byte.  Each burst follows as the timeslot,
+	the big endian frame number and the power level or RSSI, then:
+		HardPacked: 148 bits packed MSB first into 19 bytes.
+		SoftInt8: the big endian timing error in 1/256 symbols and 148
+			signed soft bits, -128 for a definite "0" and 127 for a definite "1".
+*/
+class BurstFrame {
+
+	public:
+
+	/** Payload format, sent in the header. */
+	enum Format {
+		HardPacked = 0,			///< downlink, packed hard bits
+		SoftInt8 = 1			///< uplink, one signed byte per soft bit
+	};
+
+	private:
+
+	Format mFormat;
+	unsigned mBatch;				///< bursts per datagram before it is full
+	unsigned mCount;				///< bursts in the datagram
+	size_t mSize;					///< bytes in the datagram
+	char mBuffer[MAX_UDP_LENGTH];
+
+	public:
+
+	/**
+		Create an empty datagram.
+		@param wFormat Payload format.
+		@param wBatch Bursts per datagram, 1 to BURST_FRAME_MAX.
+	*/
+	BurstFrame(Format wFormat, unsigned wBatch);
+
+	/** Discard all bursts. */
+	void clear();
+
+	bool empty() const { return mCount==0; }
+	bool full() const { return mCount>=mBatch; }
+	unsigned count() const { return mCount; }
+	unsigned batch() const { return mBatch; }
+
+	const char* data() const { return mBuffer; }
+	size_t size() const { return mSize; }
+
+	/**
+		Append a downlink burst, HardPacked only.
+		@param bits 148 symbols, one per byte, only the low bit is used.
+	*/
+	void addHard(unsigned TN, uint32_t FN, int power, const char* bits);
+
+	/**
+		Append an uplink burst, SoftInt8 only.
+		@param bits 148 soft bits from 0.0 to 1.0.
+	*/
+	void addSoft(unsigned TN, uint32_t FN, int RSSI, int timing, const float* bits);
+
+	/** Return true if a received datagram is framed rather than a single legacy burst. */
+	static bool isFrame(const char* buffer, size_t length)
+		{ return (length>=BURST_FRAME_HEADER) && (buffer[0] & BURST_FRAME_MARKER); }
+
+	/**
+		Unpack a received datagram.
+		Hard bits are returned as 0 and 1, soft bits as 0 to 255 as on the legacy interface.
+		@param records Storage for BURST_FRAME_MAX bursts.
+		@return Number of bursts, or -1 if the datagram is malformed or of another version.
+	*/
+	static int parse(const char* buffer, size_t length, BurstRecord* records);
+};
+
+
+#endif
+// vim: ts=4 sw=4
@@ -0,0 +1,103 @@
+/*
+* Copyright 2012 Free Software Foundation, Inc.
+*
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "BurstFrame.h"
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+
+using namespace std;
+
+
+int main(int argc, char * argv[] )
+{
+	BurstRecord records[BURST_FRAME_MAX];
+	char bits[BURST_RECORD_BITS];
+	float soft[BURST_RECORD_BITS];
+
+	// A frame of hard bursts, as sent on the downlink.
+	BurstFrame down(BurstFrame::HardPacked,8);
+	for (unsigned tn=0; tn<8; tn++) {
+		for (unsigned i=0; i<BURST_RECORD_BITS; i++) bits[i] = (i*7+tn)%3==0;
+		down.addHard(tn,2715647,-tn,bits);
+	}
+	cout << "downlink " << down.count() << " bursts in " << down.size() << " bytes" << endl;
+	if (!down.full() || (BurstFrame::parse(down.data(),down.size(),records)!=8)) {
+		cout << "failed to parse downlink frame" << endl;
+		return 1;
+	}
+	for (unsigned tn=0; tn<8; tn++) {
+		if ((records[tn].TN!=tn) || (records[tn].FN!=2715647) || (records[tn].power!=-(int)tn)) {
+			cout << "bad downlink header in burst " << tn << endl;
+			return 1;
+		}
+		for (unsigned i=0; i<BURST_RECORD_BITS; i++) {
+			if (records[tn].data[i]!=((i*7+tn)%3==0)) {
+				cout << "bad downlink bit " << i << " in burst " << tn << endl;
+				return 1;
+			}
+		}
+	}
+
+	// Uplink soft bits keep the quantization of single burst datagrams.
+	BurstFrame up(BurstFrame::SoftInt8,4);
+	for (unsigned i=0; i<BURST_RECORD_BITS; i++) soft[i] = i/(float)(BURST_RECORD_BITS-1);
+	up.addSoft(3,12345,90,-300,soft);
+	up.addSoft(4,12345,91,300,soft);
+	cout << "uplink " << up.count() << " bursts in " << up.size() << " bytes" << endl;
+	if (up.full() || (BurstFrame::parse(up.data(),up.size(),records)!=2)) {
+		cout << "failed to parse uplink frame" << endl;
+		return 1;
+	}
+	if ((records[0].timing!=-300) || (records[1].timing!=300) || (records[1].power!=91)) {
+		cout << "bad uplink header" << endl;
+		return 1;
+	}
+	for (unsigned i=0; i<BURST_RECORD_BITS; i++) {
+		if (records[0].data[i]!=(unsigned char)round(soft[i]*255.0F)) {
+			cout << "bad uplink soft bit " << i << endl;
+			return 1;
+		}
+	}
+
+	// Truncated frames and single burst datagrams are rejected.
+	if (BurstFrame::parse(up.data(),up.size()-1,records)>=0) {
+		cout << "accepted a truncated frame" << endl;
+		return 1;
+	}
+	char single[154] = { 3 };
+	if (BurstFrame::isFrame(single,sizeof(single))) {
+		cout << "single burst taken for a frame" << endl;
+		return 1;
+	}
+
+	up.clear();
+	cout << "cleared to " << up.size() << " bytes" << endl;
+	return 0;
+}
+
+// vim: ts=4 sw=4
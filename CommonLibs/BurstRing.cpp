@@ -0,0 +1,230 @@
+/*
+* Copyright 2012 Free Software Foundation, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "BurstRing.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+/** Identifies a burst link segment. */
+static const uint32_t gBurstLinkMagic = 0x4f425453;
+
+
+/** The shared segment, a header followed by the two rings. */
+struct BurstLink::Segment {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	char pad[52];
+	BurstRing uplink;
+	BurstRing downlink;
+};
+
+
+// The futex word is shared between processes, so the private variants do not apply.
+static int futexWait(volatile int32_t *addr, int32_t val, unsigned timeout)
+{
+	struct timespec ts;
+	ts.tv_sec = timeout/1000;
+	ts.tv_nsec = (timeout%1000)*1000000;
+	return syscall(SYS_futex,(int32_t*)addr,FUTEX_WAIT,val,&ts,NULL,0);
+}
+
+static void futexWake(volatile int32_t *addr)
+{
+	syscall(SYS_futex,(int32_t*)addr,FUTEX_WAKE,1,NULL,NULL,0);
+}
+
+
+
+
+void BurstRing::init()
+{
+	mHead = 0;
+	mTail = 0;
+	mWaiting = 0;
+	mDoorbell = 0;
+	__sync_synchronize();
+}
+
+
+bool BurstRing::write(const BurstRecord& record)
+{
+	uint32_t head = mHead;
+	if (head - mTail >= BURST_RING_SIZE) return false;
+
+	memcpy(&mRecords[head % BURST_RING_SIZE],&record,sizeof(record));
+
+	// Publish the record, then look for a sleeping reader.
+	// The full barrier pairs with the one in read() so that either the
+	// reader sees the new head or the writer sees the waiting flag.
+	__sync_synchronize();
+	mHead = head + 1;
+	__sync_synchronize();
+
+	if (mWaiting) {
+		__sync_fetch_and_add(&mDoorbell,1);
+		futexWake(&mDoorbell);
+	}
+	return true;
+}
+
+
+bool BurstRing::read(BurstRecord& record, unsigned timeout)
+{
+	uint32_t tail = mTail;
+
+	if (mHead == tail) {
+		int32_t doorbell = mDoorbell;
+		mWaiting = 1;
+		__sync_synchronize();
+		if (mHead == tail) futexWait(&mDoorbell,doorbell,timeout);
+		mWaiting = 0;
+		__sync_synchronize();
+		if (mHead == tail) return false;
+	}
+
+	// Read the record before releasing its slot to the writer.
+	__sync_synchronize();
+	memcpy(&record,&mRecords[tail % BURST_RING_SIZE],sizeof(record));
+	__sync_synchronize();
+	mTail = tail + 1;
+	return true;
+}
+
+
+
+
+BurstLink::BurstLink()
+	:mSegment(NULL)
+{
+	mName[0] = '\0';
+}
+
+
+bool BurstLink::create(const char* name)
+{
+	close();
+
+	// A stale segment of an earlier process with our name may still be mapped
+	// by a transceiver, so never reuse it.
+	shm_unlink(name);
+	int fd = shm_open(name,O_RDWR|O_CREAT|O_EXCL,S_IRUSR|S_IWUSR);
+	if (fd<0) return false;
+
+	if (ftruncate(fd,sizeof(Segment))<0) {
+		::close(fd);
+		shm_unlink(name);
+		return false;
+	}
+
+	void *map = mmap(NULL,sizeof(Segment),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	::close(fd);
+	if (map==MAP_FAILED) {
+		shm_unlink(name);
+		return false;
+	}
+
+	mSegment = (Segment*)map;
+	mSegment->uplink.init();
+	mSegment->downlink.init();
+	mSegment->size = sizeof(Segment);
+	mSegment->version = BURST_LINK_VERSION;
+	__sync_synchronize();
+	mSegment->magic = gBurstLinkMagic;
+
+	strncpy(mName,name,sizeof(mName)-1);
+	mName[sizeof(mName)-1] = '\0';
+	return true;
+}
+
+
+bool BurstLink::open(const char* name)
+{
+	close();
+
+	int fd = shm_open(name,O_RDWR,0);
+	if (fd<0) return false;
+
+	struct stat st;
+	if ((fstat(fd,&st)<0) || (st.st_size!=(off_t)sizeof(Segment))) {
+		::close(fd);
+		return false;
+	}
+
+	void *map = mmap(NULL,sizeof(Segment),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	::close(fd);
+	if (map==MAP_FAILED) return false;
+
+	Segment *segment = (Segment*)map;
+	if ((segment->magic!=gBurstLinkMagic) ||
+		(segment->version!=BURST_LINK_VERSION) ||
+		(segment->size!=sizeof(Segment))) {
+		munmap(map,sizeof(Segment));
+		return false;
+	}
+
+	mSegment = segment;
+	return true;
+}
+
+
+void BurstLink::unlink()
+{
+	if (!mName[0]) return;
+	shm_unlink(mName);
+	mName[0] = '\0';
+}
+
+
+void BurstLink::close()
+{
+	unlink();
+	if (!mSegment) return;
+	munmap(mSegment,sizeof(Segment));
+	mSegment = NULL;
+}
+
+
+BurstRing* BurstLink::uplink()
+{
+	return mSegment ? &mSegment->uplink : NULL;
+}
+
+
+BurstRing* BurstLink::downlink()
+{
+	return mSegment ? &mSegment->downlink : NULL;
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,147 @@
+/*
+* Copyright 2012 Free Software Foundation, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef BURSTRING_H
+#define BURSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Symbols carried in each burst record, the length of a GSM timeslot. */
+#define BURST_RECORD_BITS	148
+
+/** Records in each ring, a power of two and 32 frames of 8 timeslots. */
+#define BURST_RING_SIZE		256
+
+/** Layout version of the shared segment, checked when attaching. */
+#define BURST_LINK_VERSION	1
+
+
+/**
+	A burst as exchanged between the GSM core and the transceiver.
+	Downlink records carry one hard bit per byte and the power level.
+	Uplink records carry one soft bit per byte, 0..255, the RSSI and the timing error.
+*/
+struct BurstRecord {
+	uint32_t FN;					///< frame number
+	uint8_t TN;						///< timeslot number
+	int8_t power;					///< downlink power level or uplink RSSI
+	int16_t timing;					///< uplink timing error in 1/256 symbols
+	uint8_t data[BURST_RECORD_BITS];	///< hard or soft bits, one per byte
+};
+
+
+/**
+	A single-producer, single-consumer ring of burst records in shared memory.
+	The reader sleeps on a futex only when the ring is empty, and the writer
+	makes a system call only when the reader is asleep, so a busy link moves
+	bursts without entering the kernel.
+*/
+class BurstRing {
+
+	private:
+
+	volatile uint32_t mHead;		///< next record to write, written by the producer
+	char mPad0[60];
+	volatile uint32_t mTail;		///< next record to read, written by the consumer
+	volatile int32_t mWaiting;		///< set while the consumer sleeps on the doorbell
+	volatile int32_t mDoorbell;		///< futex word, bumped to wake the consumer
+	char mPad1[52];
+	BurstRecord mRecords[BURST_RING_SIZE];
+
+	public:
+
+	/** Empty the ring, before either side uses it. */
+	void init();
+
+	/**
+		Append a record, producer only.
+		@return false if the ring is full and the record was dropped.
+	*/
+	bool write(const BurstRecord& record);
+
+	/**
+		Remove the oldest record, consumer only.
+		@param record Storage for the record.
+		@param timeout Maximum wait in milliseconds for an empty ring.
+		@return false on timeout.
+	*/
+	bool read(BurstRecord& record, unsigned timeout);
+};
+
+
+/**
+	A POSIX shared memory segment holding the uplink and downlink rings of one ARFCN.
+	The GSM core creates the segment and passes its name to the transceiver
+	on the control link. The name can be unlinked once both sides are attached.
+*/
+class BurstLink {
+
+	private:
+
+	struct Segment;
+
+	Segment *mSegment;				///< mapped segment, or NULL
+	char mName[64];					///< name of a segment created here, empty once unlinked
+
+	public:
+
+	BurstLink();
+
+	~BurstLink() { close(); }
+
+	/**
+		Create, map and initialize a new segment, removing any stale segment of the same name.
+		@param name Segment name, starting with a slash.
+		@return true on success.
+	*/
+	bool create(const char* name);
+
+	/**
+		Map an existing segment created by the other side.
+		@param name Segment name, starting with a slash.
+		@return true on success, false if missing or of another version.
+	*/
+	bool open(const char* name);
+
+	/** Remove the segment name, the mapping remains valid. */
+	void unlink();
+
+	/** Unmap the segment and remove its name if created here and still present. */
+	void close();
+
+	bool isOpen() const { return mSegment!=NULL; }
+
+	/**@name The rings, valid while open. */
+	//@{
+	BurstRing* uplink();			///< transceiver to core
+	BurstRing* downlink();			///< core to transceiver
+	//@}
+};
+
+
+#endif
+// vim: ts=4 sw=4
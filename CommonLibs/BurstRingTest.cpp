@@ -0,0 +1,131 @@
+/*
+* Copyright 2012 Free Software Foundation, Inc.
+*
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "BurstRing.h"
+#include "Threads.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+
+using namespace std;
+
+
+static const int gNumToSend = 100000;
+
+// The reader maps the segment a second time, as the transceiver would.
+BurstLink gCore;
+BurstLink gTRX;
+
+
+void *testReader(void *)
+{
+	BurstRing *ring = gTRX.downlink();
+	int expected = 0;
+	int timeouts = 0;
+	while (expected<gNumToSend) {
+		BurstRecord rec;
+		if (!ring->read(rec,100)) {
+			timeouts++;
+			continue;
+		}
+		if ((rec.FN!=(uint32_t)expected) || (rec.TN!=expected%8) ||
+			(rec.data[expected%BURST_RECORD_BITS]!=1)) {
+			COUT("out of order record " << rec.FN << " expected " << expected);
+			exit(1);
+		}
+		expected++;
+	}
+	COUT("read " << expected << " records, " << timeouts << " timeouts");
+	return NULL;
+}
+
+
+int main(int argc, char * argv[] )
+{
+	char name[64];
+	sprintf(name,"/BurstRingTest.%d",getpid());
+
+	if (!gCore.create(name) || !gTRX.open(name)) {
+		COUT("failed to map " << name);
+		return 1;
+	}
+	gCore.unlink();
+
+	// An empty ring times out.
+	BurstRecord rec;
+	if (gTRX.uplink()->read(rec,10)) {
+		COUT("read from an empty ring");
+		return 1;
+	}
+
+	Thread readerThread;
+	readerThread.start(testReader,NULL);
+
+	int full = 0;
+	for (int i=0; i<gNumToSend; i++) {
+		memset(&rec,0,sizeof(rec));
+		rec.FN = i;
+		rec.TN = i%8;
+		rec.data[i%BURST_RECORD_BITS] = 1;
+		while (!gCore.downlink()->write(rec)) {
+			full++;
+			usleep(100);
+		}
+	}
+
+	readerThread.join();
+	COUT("wrote " << gNumToSend << " records, ring full " << full << " times");
+
+	// A new segment under a stale name leaves the old mapping alone.
+	BurstLink stale, fresh, remap;
+	if (!stale.create(name) || !gTRX.open(name)) {
+		COUT("failed to map " << name);
+		return 1;
+	}
+	memset(&rec,0,sizeof(rec));
+	rec.FN = 1234;
+	stale.uplink()->write(rec);
+	if (!fresh.create(name) || !remap.open(name)) {
+		COUT("failed to replace " << name);
+		return 1;
+	}
+	if (!gTRX.uplink()->read(rec,10) || (rec.FN!=1234)) {
+		COUT("replacing " << name << " disturbed the stale segment");
+		return 1;
+	}
+	rec.FN = 5678;
+	fresh.downlink()->write(rec);
+	if (!remap.downlink()->read(rec,10) || (rec.FN!=5678)) {
+		COUT("replacement " << name << " not shared");
+		return 1;
+	}
+	COUT("replaced stale segment");
+}
+
+// vim: ts=4 sw=4
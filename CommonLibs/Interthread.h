@@ -232,6 +232,118 @@ template <class T> class InterthreadQueueWithWait {
 
 
 
+/**
+	Bounded lock-free pointer FIFO between exactly one producer thread
+	and one consumer thread.
+	Slots are allocated once at construction and the capacity is rounded
+	up to a power of two. Writes never block and fail when the ring is full,
+	so the producer decides what to do with the element. The consumer may
+	poll or block with a short spin followed by a futex wait.
+*/
+template <class T> class InterthreadRing {
+
+	protected:
+
+	T** mSlots;
+	unsigned mMask;
+	volatile unsigned mReadIndex;		///< next slot to read, advanced by the consumer
+	volatile unsigned mWriteIndex;		///< next slot to write, advanced by the producer
+	volatile unsigned mWaiting;		///< set while the consumer may sleep on mWriteIndex
+
+	/** Number of polls before a blocking read goes to sleep. */
+	enum { SpinCount = 200 };
+
+	public:
+
+	InterthreadRing(unsigned wSize = 64)
+		:mReadIndex(0),mWriteIndex(0),mWaiting(0)
+	{
+		unsigned size = 1;
+		while (size < wSize) size <<= 1;
+		mSlots = new T*[size];
+		mMask = size - 1;
+	}
+
+	~InterthreadRing()
+	{
+		clear();
+		delete[] mSlots;
+	}
+
+	/** Delete contents. Consumer side only. */
+	void clear()
+	{
+		T* val;
+		while ((val = readNoBlock()) != NULL) delete val;
+	}
+
+	size_t size() const
+		{ return mWriteIndex - mReadIndex; }
+
+	size_t capacity() const
+		{ return mMask + 1; }
+
+	/**
+		Non-blocking write. Producer side only.
+		@return False if the ring is full, in which case the caller keeps ownership.
+	*/
+	bool write(T* val)
+	{
+		unsigned index = mWriteIndex;
+		if (index - mReadIndex > mMask) return false;
+		mSlots[index & mMask] = val;
+		// Publish the slot before the index.
+		__sync_synchronize();
+		mWriteIndex = index + 1;
+		// Order the index store before checking for a sleeping consumer.
+		__sync_synchronize();
+		if (mWaiting) futexWake(&mWriteIndex);
+		return true;
+	}
+
+	/**
+		Non-blocking read. Consumer side only.
+		@return Pointer to object or NULL if the ring is empty.
+	*/
+	T* readNoBlock()
+	{
+		unsigned index = mReadIndex;
+		if (index == mWriteIndex) return NULL;
+		// Read the slot only after observing the index.
+		__sync_synchronize();
+		T* retVal = mSlots[index & mMask];
+		__sync_synchronize();
+		mReadIndex = index + 1;
+		return retVal;
+	}
+
+	/**
+		Blocking read with a timeout. Consumer side only.
+		@param timeout The read timeout in ms.
+		@return Pointer to object or NULL on timeout.
+	*/
+	T* read(unsigned timeout)
+	{
+		T* retVal;
+		for (unsigned i=0; i<SpinCount; i++) {
+			retVal = readNoBlock();
+			if (retVal) return retVal;
+		}
+		unsigned index = mReadIndex;
+		mWaiting = 1;
+		// Order the flag store before re-checking the write index.
+		__sync_synchronize();
+		if (mWriteIndex == index) futexWait(&mWriteIndex,index,timeout);
+		mWaiting = 0;
+		return readNoBlock();
+	}
+
+};
+
+
+
+
+
 /** Thread-safe map of pointers to class D, keyed by class K. */
 template <class K, class D > class InterthreadMap {
 
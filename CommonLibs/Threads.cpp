@@ -28,6 +28,10 @@
 
 
 #include "Threads.h"
+
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "Timeval.h"
 
 
@@ -103,6 +107,21 @@ void Signal::wait(Mutex& wMutex, unsigned timeout) const
 }
 
 
+void futexWait(volatile unsigned *word, unsigned val, unsigned timeout)
+{
+	struct timespec waitTime;
+	waitTime.tv_sec = timeout / 1000;
+	waitTime.tv_nsec = (timeout % 1000) * 1000000;
+	syscall(SYS_futex,word,FUTEX_WAIT_PRIVATE,val,&waitTime,NULL,0);
+}
+
+
+void futexWake(volatile unsigned *word)
+{
+	syscall(SYS_futex,word,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+}
+
+
 void Thread::start(void *(*task)(void*), void *arg)
 {
 	assert(mThread==((pthread_t)0));
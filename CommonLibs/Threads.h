@@ -136,6 +136,19 @@ class Signal {
 
 
 
+/**@name Futex wait and wake for lock-free structures that need to block. */
+//@{
+/**
+	Block while the word equals the expected value, up to the timeout in ms.
+	Spurious returns are possible.
+*/
+void futexWait(volatile unsigned *word, unsigned val, unsigned timeout);
+/** Wake all threads blocked on the word. */
+void futexWake(volatile unsigned *word);
+//@}
+
+
+
 #define START_THREAD(thread,function,argument) \
 	thread.start((void *(*)(void*))function, (void*)argument);
 
@@ -33,10 +33,12 @@
 #include "GSML1FEC.h"
 
 #include <Logger.h>
+#include <Globals.h>
 
 #include <string>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #undef WARNING
 
@@ -123,7 +125,8 @@ void TransceiverManager::clockHandler()
 ::ARFCNManager::ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTransceiver)
 	:mTransceiver(wTransceiver),
 	mDataSocket(wBasePort+100+1,wTRXAddress,wBasePort+1),
-	mControlSocket(wBasePort+100,wTRXAddress,wBasePort)
+	mControlSocket(wBasePort+100,wTRXAddress,wBasePort),
+	mTxFrame(NULL)
 {
 	// The default demux table is full of NULL pointers.
 	for (int i=0; i<8; i++) {
@@ -138,7 +141,73 @@ void TransceiverManager::clockHandler()
 
 void ::ARFCNManager::start()
 {
+	if (gConfig.defines("TRX.SharedMemory") && gConfig.getNum("TRX.SharedMemory")) {
+		openBurstLink();
+	}
+	if (!mBurstLink.isOpen() && gConfig.defines("TRX.Batch")) {
+		setFormat(gConfig.getNum("TRX.Batch"));
+	}
 	mRxThread.start((void*(*)(void*))ReceiveLoopAdapter,this);
+	if (mTxFrame) mTxFlushThread.start((void*(*)(void*))TransmitFlushAdapter,this);
+}
+
+
+bool ::ARFCNManager::openBurstLink()
+{
+	char name[64];
+	sprintf(name,"/OpenBTS.%d.%d",getpid(),mDataSocket.port());
+	if (!mBurstLink.create(name)) {
+		LOG(WARNING) << "cannot create shared memory " << name << ", bursts stay on UDP";
+		return false;
+	}
+	int status = sendCommand("SETSHM",name);
+	// The transceiver has mapped the segment or given up, so the name can go.
+	mBurstLink.unlink();
+	if (status!=0) {
+		LOG(NOTICE) << "SETSHM failed with status " << status << ", bursts stay on UDP";
+		mBurstLink.close();
+		return false;
+	}
+	LOG(INFO) << "bursts on shared memory " << name;
+	return true;
+}
+
+
+bool ::ARFCNManager::setFormat(unsigned batch)
+{
+	char paramBuf[MAX_UDP_LENGTH];
+	sprintf(paramBuf,"%d %u", BURST_FRAME_VERSION, batch);
+	int status = sendCommand("SETFORMAT",paramBuf);
+	if (status!=0) {
+		LOG(NOTICE) << "SETFORMAT failed with status " << status << ", sending single bursts";
+		return false;
+	}
+	mTxFrame = new BurstFrame(BurstFrame::HardPacked,batch);
+	return true;
+}
+
+
+void ::ARFCNManager::flushTxFrame()
+{
+	if (mTxFrame->empty()) return;
+	mDataSocket.write(mTxFrame->data(),mTxFrame->size());
+	mTxFrame->clear();
+}
+
+
+void ::ARFCNManager::driveTxFlush()
+{
+	// Sleep until the clock reaches the frame of the pending batch,
+	// or for one frame if nothing is pending.
+	mDataSocketLock.lock();
+	GSM::Time target = mTxFrame->empty() ? gBTS.clock().get()+1 : GSM::Time(mTxFrameFN);
+	mDataSocketLock.unlock();
+	gBTS.clock().wait(target);
+	// Encoders write each burst before the clock reaches its frame,
+	// so a batch whose frame has come is complete.
+	mDataSocketLock.lock();
+	if (!mTxFrame->empty() && FNDelta(gBTS.clock().FN(),mTxFrameFN)>=0) flushTxFrame();
+	mDataSocketLock.unlock();
 }
 
 
@@ -159,6 +228,8 @@ void ::ARFCNManager::installDecoder(GSM::L1Decoder *wL1d)
 		while (FN<maxModulus) {
 			// Don't overwrite existing entries.
 			assert(mDemuxTable[TN][FN]==NULL);
+			// The decoder is fully constructed before the receive thread can see it.
+			__sync_synchronize();
 			mDemuxTable[TN][FN] = wL1d;
 			FN += mapping.repeatLength();
 		}
@@ -172,6 +243,35 @@ void ::ARFCNManager::installDecoder(GSM::L1Decoder *wL1d)
 void ::ARFCNManager::writeHighSide(const GSM::TxBurst& burst)
 {
 	LOG(DEBUG) << "transmit at time " << gBTS.clock().get() << ": " << burst;
+	if (mBurstLink.isOpen()) {
+		BurstRecord record;
+		record.TN = burst.time().TN();
+		record.FN = burst.time().FN();
+		/// FIXME -- We hard-code gain to 0 dB for now.
+		record.power = 0;
+		record.timing = 0;
+		const char *dp = burst.begin();
+		for (unsigned i=0; i<gSlotLen; i++) {
+			record.data[i] = (*dp++) & 0x01;
+		}
+		mDataSocketLock.lock();
+		bool written = mBurstLink.downlink()->write(record);
+		mDataSocketLock.unlock();
+		if (!written) LOG(WARNING) << "transmit ring full, dropping burst at " << burst.time();
+		return;
+	}
+	if (mTxFrame) {
+		// Bursts of one frame go out together, sent by the first burst of the next
+		// or by the flush thread once the clock reaches the frame.
+		uint32_t FN = burst.time().FN();
+		mDataSocketLock.lock();
+		if (FN!=mTxFrameFN) flushTxFrame();
+		mTxFrame->addHard(burst.time().TN(),FN,0,burst.begin());
+		mTxFrameFN = FN;
+		if (mTxFrame->full()) flushTxFrame();
+		mDataSocketLock.unlock();
+		return;
+	}
 	// format the transmission request message
 	static const int bufferSize = gSlotLen+1+4+1;
 	char buffer[bufferSize];
@@ -203,10 +303,25 @@ void ::ARFCNManager::writeHighSide(const GSM::TxBurst& burst)
 
 void ::ARFCNManager::driveRx()
 {
+	if (mBurstLink.isOpen()) {
+		BurstRecord record;
+		if (mBurstLink.uplink()->read(record,1000)) receiveRecord(record);
+		return;
+	}
 	// read the message
 	char buffer[MAX_UDP_LENGTH];
 	int msgLen = mDataSocket.read(buffer);
 	if (msgLen<=0) SOCKET_ERROR;
+	if (BurstFrame::isFrame(buffer,msgLen)) {
+		BurstRecord records[BURST_FRAME_MAX];
+		int count = BurstFrame::parse(buffer,msgLen,records);
+		if (count<0) {
+			LOG(ERR) << "badly formatted frame on TRX->GSM interface";
+			return;
+		}
+		for (int n=0; n<count; n++) receiveRecord(records[n]);
+		return;
+	}
 	// decode
 	unsigned char *rp = (unsigned char*)buffer;
 	// timeslot number
@@ -226,10 +341,16 @@ void ::ARFCNManager::driveRx()
 	int timingError = *srp;
 	timingError = (timingError<<8) | (*rp++);
 	// soft symbols
-	float data[gSlotLen];
-	for (unsigned i=0; i<gSlotLen; i++) data[i] = (*rp++) / 256.0F;
+	for (unsigned i=0; i<gSlotLen; i++) mRxData[i] = (*rp++) / 256.0F;
 	// demux
-	receiveBurst(RxBurst(data,GSM::Time(FN,TN),timingError/256.0F,-RSSI));
+	receiveBurst(RxBurst(mRxData,GSM::Time(FN,TN),timingError/256.0F,-RSSI));
+}
+
+
+void ::ARFCNManager::receiveRecord(const BurstRecord& record)
+{
+	for (unsigned i=0; i<gSlotLen; i++) mRxData[i] = record.data[i] / 256.0F;
+	receiveBurst(RxBurst(mRxData,GSM::Time(record.FN,record.TN),record.timing/256.0F,-record.power));
 }
 
 
@@ -242,6 +363,15 @@ void* ReceiveLoopAdapter(::ARFCNManager* manager){
 }
 
 
+void* TransmitFlushAdapter(::ARFCNManager* manager){
+	while (true) {
+		manager->driveTxFlush();
+		pthread_testcancel();
+	}
+	return NULL;
+}
+
+
 
 
 
@@ -483,15 +613,13 @@ void ::ARFCNManager::receiveBurst(const RxBurst& inBurst)
 	uint32_t FN = inBurst.time().FN() % maxModulus;
 	unsigned TN = inBurst.time().TN();
 
-	mTableLock.lock();
+	// No lock, see installDecoder.
 	L1Decoder *proc = mDemuxTable[TN][FN];
 	if (proc==NULL) {
 		LOG(DEBUG) << "ARFNManager::receiveBurst in unconfigured TDMA position TN: " << TN << " FN: " << FN << ".";
-		mTableLock.unlock();
 		return;
 	}
 	proc->writeLowSide(inBurst);
-	mTableLock.unlock();
 }
 
 
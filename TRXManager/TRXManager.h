@@ -33,6 +33,8 @@
 
 #include "Threads.h"
 #include "Sockets.h"
+#include "BurstRing.h"
+#include "BurstFrame.h"
 #include "Interthread.h"
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
@@ -122,18 +124,29 @@ class ARFCNManager {
 
 	Mutex mDataSocketLock;			///< lock to prevent contentional for the socket
 	UDPSocket mDataSocket;			///< socket for data transfer
+	BurstLink mBurstLink;			///< shared memory burst transport, replaces mDataSocket if open
+	BurstFrame *mTxFrame;			///< batch of transmit bursts, NULL to send single bursts
+	uint32_t mTxFrameFN;			///< frame number of the bursts in mTxFrame
 	Mutex mControlLock;				///< lock to prevent overlapping transactions
 	UDPSocket mControlSocket;		///< socket for radio control
 
 	Thread mRxThread;				///< thread to receive data from rx
+	Thread mTxFlushThread;			///< thread to send batches whose frame has come, if batching
 
 	/**@name The demux table. */
 	//@{
-	Mutex mTableLock;
+	/**
+		Entries are only ever added, never changed or removed, so the receive
+		thread reads the table without locking and installers publish each
+		pointer with a single store.
+	*/
+	Mutex mTableLock;				///< serializes installDecoder
 	static const unsigned maxModulus=51*26*4;	///< maximum unified repeat period
-	GSM::L1Decoder* mDemuxTable[8][maxModulus];		///< the demultiplexing table for received bursts
+	GSM::L1Decoder* volatile mDemuxTable[8][maxModulus];		///< the demultiplexing table for received bursts
 	//@}
 
+	float mRxData[GSM::gSlotLen];		///< soft bits of the received burst, reused by the receive thread
+
 	unsigned mARFCN;						///< the current ARFCN
 
 
@@ -166,7 +179,7 @@ class ARFCNManager {
 	*/
 	bool tuneLoopback(int wARFCN);
 
-	/** Turn off the transceiver. */
+	/** Turn off the transceiver, which also drops its shared memory link, so call before start(). */
 	bool powerOff();
 
 	/** Turn on the transceiver. */
@@ -224,15 +237,40 @@ class ARFCNManager {
 
 	private:
 
+	/**
+		Offer the transceiver a shared memory segment for bursts.
+		@return true if accepted, otherwise bursts stay on the data socket.
+	*/
+	bool openBurstLink();
+
+	/**
+		Switch the data socket to batched, framed datagrams.
+		@param batch Bursts per datagram, 1 to BURST_FRAME_MAX.
+		@return true if accepted, otherwise single bursts are sent.
+	*/
+	bool setFormat(unsigned batch);
+
+	/** Send the batched transmit bursts, with mDataSocketLock held. */
+	void flushTxFrame();
+
+	/** Send a pending batch once the clock reaches its frame. */
+	void driveTxFlush();
+
 	/** Action for reception. */
 	void driveRx();
 
+	/** Decode a burst from shared memory or a framed datagram, then receive it. */
+	void receiveRecord(const BurstRecord&);
+
 	/** Demultiplex and process a received burst. */
 	void receiveBurst(const GSM::RxBurst&);
 
 	/** Receiver loop. */
 	friend void* ReceiveLoopAdapter(ARFCNManager*);
 
+	/** Transmit batch flush loop. */
+	friend void* TransmitFlushAdapter(ARFCNManager*);
+
 	/**
 		Send a command packet and get the response packet.
 		@param command The NULL-terminated command string to send.
@@ -272,6 +310,7 @@ class ARFCNManager {
 
 /** C interface for ARFCNManager threads. */
 void* ReceiveLoopAdapter(ARFCNManager*);
+void* TransmitFlushAdapter(ARFCNManager*);
 
 
 #endif
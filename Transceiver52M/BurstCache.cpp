@@ -0,0 +1,185 @@
+/*
+ * Modulated burst cache
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+#include <string.h>
+
+#include "BurstCache.h"
+
+/* Pack burst bits into 64-bit words, returns false if the burst is too long */
+static bool packKey(const BitVector &burst, uint64_t *key, int words)
+{
+	size_t i;
+
+	if (burst.size() > (size_t) words * 64)
+		return false;
+
+	memset(key, 0, words * sizeof(uint64_t));
+
+	for (i = 0; i < burst.size(); i++) {
+		if (burst.bit(i))
+			key[i / 64] |= (uint64_t) 1 << (i % 64);
+	}
+
+	return true;
+}
+
+/* FNV-1a over the packed words and guard length */
+static uint32_t hashKey(const uint64_t *key, int words, int guard)
+{
+	uint32_t hash = 2166136261u;
+	const unsigned char *bytes = (const unsigned char *) key;
+
+	for (size_t i = 0; i < words * sizeof(uint64_t); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	hash ^= guard;
+	hash *= 16777619u;
+
+	return hash;
+}
+
+BurstCache::BurstCache(int wSize)
+	: mBypass(NULL), mSize(wSize), mUsed(0), mHits(0), mMisses(0)
+{
+	int i;
+	uint32_t buckets = 1;
+
+	while (buckets < 2 * (uint32_t) mSize)
+		buckets <<= 1;
+
+	mMask = buckets - 1;
+	mBuckets = new Entry *[buckets];
+	for (i = 0; i < (int) buckets; i++)
+		mBuckets[i] = NULL;
+
+	mLRU.prev = mLRU.next = &mLRU;
+
+	/* All entries start on the LRU list as empty slots */
+	mEntries = new Entry[mSize];
+	for (i = 0; i < mSize; i++) {
+		mEntries[i].vec = NULL;
+		mEntries[i].chain = NULL;
+		pushLRU(&mEntries[i]);
+	}
+}
+
+BurstCache::~BurstCache()
+{
+	for (int i = 0; i < mSize; i++)
+		delete mEntries[i].vec;
+
+	delete[] mEntries;
+	delete[] mBuckets;
+	delete mBypass;
+}
+
+void BurstCache::unlinkLRU(Entry *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+}
+
+void BurstCache::pushLRU(Entry *entry)
+{
+	entry->next = mLRU.next;
+	entry->prev = &mLRU;
+	mLRU.next->prev = entry;
+	mLRU.next = entry;
+}
+
+void BurstCache::unlinkBucket(Entry *entry)
+{
+	Entry **link = &mBuckets[entry->hash & mMask];
+
+	while (*link) {
+		if (*link == entry) {
+			*link = entry->chain;
+			break;
+		}
+		link = &(*link)->chain;
+	}
+
+	entry->chain = NULL;
+}
+
+BurstCache::Entry *BurstCache::lookup(const uint64_t *key, int guard,
+				      uint32_t hash)
+{
+	Entry *entry = mBuckets[hash & mMask];
+
+	while (entry) {
+		if ((entry->hash == hash) && (entry->guard == guard) &&
+		    !memcmp(entry->key, key, sizeof(entry->key)))
+			return entry;
+		entry = entry->chain;
+	}
+
+	return NULL;
+}
+
+const signalVector *BurstCache::modulate(const BitVector &burst,
+					 const signalVector &pulse,
+					 int guard, int sps)
+{
+	uint64_t key[KEY_WORDS];
+
+	if (!packKey(burst, key, KEY_WORDS)) {
+		mMisses++;
+		delete mBypass;
+		mBypass = modulateBurst(burst, pulse, guard, sps);
+		return mBypass;
+	}
+
+	uint32_t hash = hashKey(key, KEY_WORDS, guard);
+	Entry *entry = lookup(key, guard, hash);
+
+	if (entry) {
+		mHits++;
+		unlinkLRU(entry);
+		pushLRU(entry);
+		return entry->vec;
+	}
+
+	mMisses++;
+
+	/* Recycle the least recently used entry */
+	entry = mLRU.prev;
+	unlinkLRU(entry);
+
+	if (entry->vec) {
+		unlinkBucket(entry);
+		delete entry->vec;
+	} else {
+		mUsed++;
+	}
+
+	memcpy(entry->key, key, sizeof(entry->key));
+	entry->guard = guard;
+	entry->hash = hash;
+	entry->vec = modulateBurst(burst, pulse, guard, sps);
+
+	entry->chain = mBuckets[hash & mMask];
+	mBuckets[hash & mMask] = entry;
+	pushLRU(entry);
+
+	return entry->vec;
+}
@@ -0,0 +1,91 @@
+/*
+ * Modulated burst cache
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+#ifndef _BURSTCACHE_H_
+#define _BURSTCACHE_H_
+
+#include <stdint.h>
+
+#include "sigProcLib.h"
+
+/* Number of cached bursts, covers a 51-multiframe of distinct C0 bursts */
+#define BURST_CACHE_LEN		256
+
+/* Longest burst in bits that can be cached */
+#define BURST_CACHE_BITS	192
+
+/*
+ * LRU cache of modulated bursts keyed by burst bits and guard length
+ *
+ * Entries and hash buckets are allocated once. Only a miss calls into the
+ * modulator. The cache assumes a fixed pulse shape and oversampling factor
+ * and is not thread safe, so each transceiver keeps its own.
+ */
+class BurstCache {
+public:
+	BurstCache(int wSize = BURST_CACHE_LEN);
+	~BurstCache();
+
+	/** Modulate a burst or return the cached result
+	    @param burst burst bits
+	    @param pulse GSM shaping pulse
+	    @param guard guard period length in symbols
+	    @param sps samples per symbol
+	    @return modulated burst owned by the cache, valid until the next call
+	 */
+	const signalVector *modulate(const BitVector &burst,
+				     const signalVector &pulse,
+				     int guard, int sps);
+
+	unsigned hits() const { return mHits; }
+	unsigned misses() const { return mMisses; }
+	int size() const { return mUsed; }
+
+private:
+	enum { KEY_WORDS = BURST_CACHE_BITS / 64 };
+
+	struct Entry {
+		uint64_t key[KEY_WORDS];
+		int guard;
+		uint32_t hash;
+		signalVector *vec;
+		Entry *chain;
+		Entry *prev;
+		Entry *next;
+	};
+
+	signalVector *mBypass;		///< last burst too long to cache
+	Entry *mEntries;
+	Entry **mBuckets;
+	Entry mLRU;
+	uint32_t mMask;
+	int mSize;
+	int mUsed;
+
+	unsigned mHits;
+	unsigned mMisses;
+
+	Entry *lookup(const uint64_t *key, int guard, uint32_t hash);
+	void unlinkBucket(Entry *entry);
+	void unlinkLRU(Entry *entry);
+	void pushLRU(Entry *entry);
+};
+
+#endif /* _BURSTCACHE_H_ */
@@ -81,12 +81,10 @@ int Channelizer::rotate(struct cxvec *in, struct cxvec **out)
 	}
 
 	/* 
-	 * Interleave convolution output into FFT
-	 * Deinterleave back into partition output buffers
+	 * Strided FFT across the partition output buffers in place, or
+	 * direct evaluation of active bins when few channels are active
 	 */
-	cxvec_interlv(partOutputs, fftBuffer, mChanM);
-	cxvec_fft(fftHandle, fftBuffer, fftBuffer);
-	cxvec_deinterlv_fw(fftBuffer, partOutputs, mChanM);
+	transform();
 
 	/* 
 	 * Downsample FFT output from channel rate multiple to GSM symbol rate
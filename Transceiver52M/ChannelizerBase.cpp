@@ -37,8 +37,6 @@ void ChannelizerBase::resetPartitions()
 		cxvec_reset(partInputs[i]);
 		cxvec_reset(partOutputs[i]);
 	}
-
-	cxvec_reset(fftBuffer);
 }
 
 /* 
@@ -143,14 +141,122 @@ void ChannelizerBase::releaseFilters()
 	free(partitions);
 }
 
+/*
+ * Select between the full FFT and direct evaluation of active bins only.
+ * Direct evaluation costs K * M complex multiplies per sample for K active
+ * channels against roughly M * log2(M) for the FFT, so the pruned
+ * transform is used while K stays below log2(M).
+ */
+void ChannelizerBase::updateMode()
+{
+	int i;
+	bool sparse;
+
+	mActiveCount = 0;
+	for (i = 0; i < mChanM; i++) {
+		if (mActive[i])
+			mActiveList[mActiveCount++] = i;
+	}
+
+	sparse = mActiveCount < log2((float) mChanM);
+	if (sparse != mSparse) {
+		LOG(INFO) << "Using " << (sparse ? "sparse" : "full")
+			  << " transform for " << mActiveCount
+			  << " of " << mChanM << " channels";
+	}
+
+	mSparse = sparse;
+}
+
+/*
+ * Direct DFT of the active bins at each sample index across partitions.
+ * On receive, partitions are transformed into the active output bins and
+ * inactive bins are left undefined. On transmit, only active input bins
+ * contribute to the partitions, matching the FFT of zeroed inactive bins.
+ */
+void ChannelizerBase::sparseTransform()
+{
+	int i, k, n, t;
+	float re, im;
+	cmplx *w, *x;
+	cmplx *base = fftPartitions[0]->data;
+
+	for (t = 0; t < chunkLen; t++) {
+		if (mType == RX_CHANNELIZER) {
+			for (n = 0; n < mChanM; n++)
+				mSparseIn[n] = base[n * mFFTStride + t];
+
+			for (i = 0; i < mActiveCount; i++) {
+				k = mActiveList[i];
+				w = &mTwiddles[k * mChanM];
+				re = im = 0.0f;
+
+				for (n = 0; n < mChanM; n++) {
+					x = &mSparseIn[n];
+					re += x->real * w[n].real - x->imag * w[n].imag;
+					im += x->real * w[n].imag + x->imag * w[n].real;
+				}
+
+				base[k * mFFTStride + t].real = re;
+				base[k * mFFTStride + t].imag = im;
+			}
+		} else {
+			for (i = 0; i < mActiveCount; i++)
+				mSparseIn[i] = base[mActiveList[i] * mFFTStride + t];
+
+			for (n = 0; n < mChanM; n++) {
+				re = im = 0.0f;
+
+				for (i = 0; i < mActiveCount; i++) {
+					x = &mSparseIn[i];
+					w = &mTwiddles[mActiveList[i] * mChanM + n];
+					re += x->real * w->real - x->imag * w->imag;
+					im += x->real * w->imag + x->imag * w->real;
+				}
+
+				base[n * mFFTStride + t].real = re;
+				base[n * mFFTStride + t].imag = im;
+			}
+		}
+	}
+}
+
+void ChannelizerBase::transform()
+{
+	int updates = mUpdates;
+
+	if (updates != mApplied) {
+		__sync_synchronize();
+		mApplied = updates;
+		updateMode();
+	}
+
+	if (mSparse)
+		sparseTransform();
+	else
+		fft_batch_execute(fftHandle);
+}
+
 bool ChannelizerBase::activateChan(int num)
 {
-	return mResampler->activateChan(num);
+	if (!mResampler->activateChan(num))
+		return false;
+
+	mActive[num] = true;
+	__sync_fetch_and_add(&mUpdates, 1);
+
+	return true;
 }
 
 bool ChannelizerBase::deactivateChan(int num)
 {
-	return mResampler->deactivateChan(num);
+	if (!mResampler->deactivateChan(num))
+		return false;
+
+	mActive[num] = false;
+	__sync_fetch_and_add(&mUpdates, 1);
+
+	return true;
 }
 
 /* 
@@ -160,6 +266,9 @@ bool ChannelizerBase::init(struct cxvec **protoFilterBase)
 {
 	int i;
 
+	/* Select convolution kernels for this processor */
+	convolve_init();
+
 	/*
 	 * Filterbank coefficients, fft plan, history, and output sample
 	 * rate conversion blocks
@@ -169,17 +278,6 @@ bool ChannelizerBase::init(struct cxvec **protoFilterBase)
 		return false;
 	}
 
-	fftBuffer = cxvec_alloc(chunkLen * mChanM, 0, NULL, 0);
-	if (!fftBuffer) {
-		LOG(ERR) << "Memory allocation error";
-		return false;
-	}
-
-	fftHandle = init_fft(0, mChanM);
-	if (!fftHandle) {
-		LOG(ERR) << "Failed to initialize FFT";
-	}
-
 	mResampler = new Resampler(mP, mQ, mResampLen, mChanM);
 	if (!mResampler->init(NULL)) {
 		LOG(ERR) << "Failed to initialize resampling filter";
@@ -201,22 +299,77 @@ bool ChannelizerBase::init(struct cxvec **protoFilterBase)
 	 *
 	 * Output partition feeds into downsampler and convolves from index
 	 * zero at tap zero with an output length equal to a high rate chunk.
+	 *
+	 * The partitions passing through the FFT (outputs on receive, inputs
+	 * on transmit) are carved out of a single contiguous buffer so that
+	 * the strided batch transform runs across partitions in place.
 	 */
+	int inLen = chunkLen + mPartitionLen;
+	int outLen = chunkLen + mResampLen;
+	int fftStride = (mType == RX_CHANNELIZER) ? outLen : inLen;
+	mFFTStride = fftStride;
+
 	partInputs = (struct cxvec **) malloc(sizeof(struct cxvec *) * mChanM);
 	partOutputs = (struct cxvec **) malloc(sizeof(struct cxvec *) * mChanM);
+	fftBuffer = cxvec_alloc(fftStride * mChanM, 0, NULL, CXVEC_FLG_MEM_ALIGN);
 
-	if (!partInputs | !partOutputs) {
+	if (!partInputs | !partOutputs | !fftBuffer) {
 		LOG(ERR) << "Memory allocation error";
 		return false;
 	}
 
 	for (i = 0; i < mChanM; i++) {
-		partInputs[i] = cxvec_alloc(chunkLen + mPartitionLen,
-					    mPartitionLen, NULL, 0);
-		partOutputs[i] = cxvec_alloc(chunkLen + mResampLen,
-					     mResampLen, NULL, 0);
+		cmplx *fftPart = &fftBuffer->buf[i * fftStride];
+
+		if (mType == RX_CHANNELIZER) {
+			partInputs[i] = cxvec_alloc(inLen, mPartitionLen,
+						    NULL, 0);
+			partOutputs[i] = cxvec_alloc(outLen, mResampLen,
+						     fftPart, 0);
+		} else {
+			partInputs[i] = cxvec_alloc(inLen, mPartitionLen,
+						    fftPart, 0);
+			partOutputs[i] = cxvec_alloc(outLen, mResampLen,
+						     NULL, 0);
+		}
 	}
 
+	if (mType == RX_CHANNELIZER)
+		fftPartitions = partOutputs;
+	else
+		fftPartitions = partInputs;
+
+	fftHandle = init_fft_batch(0, mChanM, chunkLen,
+				   fftPartitions[0]->data, fftStride, 1);
+	if (!fftHandle) {
+		LOG(ERR) << "Failed to initialize FFT";
+		return false;
+	}
+
+	/* Forward DFT twiddles for the sparse transform, indexed [bin][partition] */
+	mActive = (volatile bool *) malloc(sizeof(bool) * mChanM);
+	mActiveList = (int *) malloc(sizeof(int) * mChanM);
+	mTwiddles = (cmplx *) malloc(sizeof(cmplx) * mChanM * mChanM);
+	mSparseIn = (cmplx *) malloc(sizeof(cmplx) * mChanM);
+	if (!mActive || !mActiveList || !mTwiddles || !mSparseIn) {
+		LOG(ERR) << "Memory allocation error";
+		return false;
+	}
+
+	for (i = 0; i < mChanM * mChanM; i++) {
+		double phase = -2.0 * M_PI * ((i / mChanM) * (i % mChanM) % mChanM) / mChanM;
+		mTwiddles[i].real = cos(phase);
+		mTwiddles[i].imag = sin(phase);
+	}
+
+	for (i = 0; i < mChanM; i++)
+		mActive[i] = false;
+
+	mSparse = false;
+	updateMode();
+
+	resetPartitions();
+
 	return true;
 }
 
@@ -231,7 +384,10 @@ bool ChannelizerBase::init(struct cxvec **protoFilterBase)
 ChannelizerBase::ChannelizerBase(int wChanM, int wPartitionLen, int wResampLen,
 				 int wP, int wQ, int wMul, chanType type) 
 	: mChanM(wChanM), mPartitionLen(wPartitionLen), mResampLen(wResampLen),
-	  mP(wP), mQ(wQ), mMul(wMul)
+	  mP(wP), mQ(wQ), mMul(wMul), mType(type),
+	  mActive(NULL), mUpdates(0), mApplied(0),
+	  mActiveList(NULL), mActiveCount(0), mSparse(false),
+	  mTwiddles(NULL), mSparseIn(NULL)
 {
 	if (type == TX_SYNTHESIS)
 		chunkLen = mP * mMul;
@@ -244,10 +400,10 @@ ChannelizerBase::~ChannelizerBase()
 	int i;
 
 	releaseFilters();
-	cxvec_free(fftBuffer);
 	free_fft(fftHandle);
 
 	for (i = 0; i < mChanM; i++) {
+		fftPartitions[i]->buf = NULL;
 		cxvec_free(partInputs[i]);
 		cxvec_free(partOutputs[i]);
 		cxvec_free(history[i]);
@@ -256,4 +412,10 @@ ChannelizerBase::~ChannelizerBase()
 	free(partInputs);
 	free(partOutputs);
 	free(history);
+	cxvec_free(fftBuffer);
+
+	free((void *) mActive);
+	free(mActiveList);
+	free(mTwiddles);
+	free(mSparseIn);
 }
@@ -40,11 +40,31 @@ protected:
 	struct cxvec **partInputs;
 	struct cxvec **partOutputs;
 	struct cxvec **history;
+
+	/* Contiguous storage backing the partitions that are transformed */
 	struct cxvec *fftBuffer;
+	struct cxvec **fftPartitions;
 
 	/* Pointer to opaque FFT instance */
 	struct fft_hdl *fftHandle;
 
+	/*
+	 * Active channel tracking and sparse transform state. The control
+	 * thread only writes mActive and bumps mUpdates. The thread that
+	 * rotates the filterbank rebuilds the active list from mActive at
+	 * the start of its next chunk, so the list, count and mode never
+	 * change during a transform.
+	 */
+	volatile bool *mActive;
+	volatile int mUpdates;
+	int mApplied;
+	int *mActiveList;
+	int mActiveCount;
+	int mFFTStride;
+	bool mSparse;
+	cmplx *mTwiddles;
+	cmplx *mSparseIn;
+
 	/* Output sample rate converter */
 	Resampler *mResampler;
 	int mResampLen;
@@ -53,6 +73,12 @@ protected:
 	bool initFilters(struct cxvec **protoFilter);
 	void releaseFilters();
 	void resetPartitions();
+	void updateMode();
+
+	/* Transform across partitions, full FFT or active bins only,
+	   after applying any pending channel changes */
+	void transform();
+	void sparseTransform();
 
 	/* Direction */
 	enum chanType {
@@ -60,6 +86,8 @@ protected:
 		TX_SYNTHESIS
 	};
 
+	chanType mType;
+
 	ChannelizerBase(int wChanM, int wPartitionLen, int wResampLen,
 			int wP, int wQ, int wMul, chanType type);
 	~ChannelizerBase();
@@ -22,28 +22,37 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "DriveLoop.h"
+#include "WorkerPool.h"
 #include <Logger.h>
 
 DriveLoop::DriveLoop(int wBasePort, const char *TRXAddress,
 		     int wChanM, int wC0, int wSamplesPerSymbol,
                      GSM::Time wTransmitLatency,
-                     RadioInterface *wRadioInterface)
-	:mClockSocket(wBasePort, TRXAddress, wBasePort + 100), mC0(wC0)
+                     RadioInterface *wRadioInterface,
+                     DriveLoop *wClockSource)
+	:mC0(wC0)
 {
   mChanM = wChanM;
-  mRadioDriveLoopThread = NULL;
+  mReceiveThread = NULL;
+  mTransmitThread = NULL;
+  mWorkerPool = NULL;
+  mReceiveCPU = -1;
+  mTransmitCPU = -1;
+  mTransmitSlack = 0;
+  mDeadlineMisses = 0;
   mSamplesPerSymbol = wSamplesPerSymbol;
   mRadioInterface = wRadioInterface;
 
-  mStartTime = (random() % gHyperframe, 0);
-
-  mTransmitDeadlineClock = mStartTime;
-  mLatencyUpdateTime = mStartTime;
+  // a device following another clock has no clock socket of its own
+  mClockSource = wClockSource;
+  mClockSocket = NULL;
+  if (!mClockSource)
+    mClockSocket = new UDPSocket(wBasePort, TRXAddress, wBasePort + 100);
   mTransmitLatency = wTransmitLatency;
-  mLastClockUpdateTime = mStartTime;
-
-  mRadioInterface->getClock()->set(mStartTime);
+  mStartTime = (random() % gHyperframe, 0);
+  syncClock(mStartTime);
 
   // generate pulse and setup up signal processing library
   gsmPulse = generateGSMPulse(2, mSamplesPerSymbol);
@@ -69,7 +78,7 @@ DriveLoop::DriveLoop(int wBasePort, const char *TRXAddress,
 
     for (int n = 0; n < mChanM; n++) {
       fillerModulus[n][i] = 26;
-      mChanType[n][i] = NONE;
+      setTimeslot(n, i, NONE);
     }
   }
 
@@ -81,22 +90,75 @@ DriveLoop::~DriveLoop()
   if (mOn) {
     mOn = false;
 
-    if (mRadioDriveLoopThread)
-      delete mRadioDriveLoopThread;
+    delete mReceiveThread;
+    delete mTransmitThread;
   }
 
+  delete mClockSocket;
   delete gsmPulse;
   sigProcLibDestroy();
 }
 
+void DriveLoop::syncClock(const GSM::Time &wTime)
+{
+  ScopedLock lock(mClockLock);
+
+  mStartTime = wTime;
+  mTransmitDeadlineClock = mStartTime;
+  mLatencyUpdateTime = mStartTime;
+  mLastClockUpdateTime = mStartTime;
+
+  mRadioInterface->getClock()->set(mStartTime);
+}
+
 void DriveLoop::start()
 {
   if (mOn)
     return;
 
+  // the radio is started, devices after the primary count whole
+  // alignment periods from its start
+  if (mClockSource) {
+    if (!mClockSource->on())
+      LOG(ALERT) << "Device started before the primary device, clocks will not match";
+    long long periods = startPeriods() - mClockSource->startPeriods();
+    long long cycle = gHyperframe / ALIGN_FRAMES;
+    int frames = (int) (((periods % cycle) + cycle) % cycle) * ALIGN_FRAMES;
+    syncClock(mClockSource->getStartTime() + frames);
+  }
+
   mOn = true;
-  mRadioDriveLoopThread = new Thread(32768);
-  mRadioDriveLoopThread->start((void * (*)(void*))RadioDriveLoopAdapter, (void*) this);
+  mReceiveThread = new Thread(32768);
+  mReceiveThread->start((void * (*)(void*))RadioReceiveLoopAdapter, (void*) this);
+  mTransmitThread = new Thread(32768);
+  mTransmitThread->start((void * (*)(void*))RadioTransmitLoopAdapter, (void*) this);
+}
+
+long long DriveLoop::startPeriods()
+{
+  TIMESTAMP period = (TIMESTAMP) (mRadioInterface->getSampleRate() *
+                                  ALIGN_PERIOD + 0.5);
+
+  return mRadioInterface->startTimestamp() / period;
+}
+
+/*
+ * Refresh the filler table entry for the burst time. Bursts of matching
+ * length are copied in place to avoid reallocating on every timeslot.
+ */
+void DriveLoop::updateFiller(int chan, const signalVector &burst,
+                             const GSM::Time &time)
+{
+  int TN = time.TN();
+  int modFN = time.FN() % fillerModulus[chan][TN];
+  signalVector *filler = fillerTable[chan][modFN][TN];
+
+  if (filler->size() == burst.size()) {
+    burst.copyTo(*filler);
+  } else {
+    delete filler;
+    fillerTable[chan][modFN][TN] = new signalVector(burst);
+  }
 }
 
 void DriveLoop::pushRadioVector(GSM::Time &nowTime)
@@ -111,39 +173,33 @@ void DriveLoop::pushRadioVector(GSM::Time &nowTime)
       // Even if the burst is stale, put it in the fillter table.
       // (It might be an idle pattern.)
       LOG(NOTICE) << "dumping STALE burst in TRX->USRP interface";
-      if (i == mC0) {
-        const GSM::Time& nextTime = staleBurst->getTime();
-        int TN = nextTime.TN();
-        int modFN = nextTime.FN() % fillerModulus[i][TN];
-        delete fillerTable[i][modFN][TN];
-        fillerTable[i][modFN][TN] = staleBurst;
-      }
+      if (i == mC0)
+        updateFiller(i, *staleBurst, staleBurst->getTime());
+      staleBurst->release();
     }
 
     int TN = nowTime.TN();
     int modFN = nowTime.FN() % fillerModulus[i][nowTime.TN()];
 
     mTxBursts[i] = fillerTable[i][modFN][TN];
-    mIsFiller[i] = true;
+    mTxVectors[i] = NULL;
     mIsZero[i] = (mChanType[i][TN] == NONE);
 
     // if queue contains data at the desired timestamp, stick it into FIFO
-    if (next = (radioVector*) mTransmitPriorityQueue[i].getCurrentBurst(nowTime)) {
+    if (next = mTransmitPriorityQueue[i].getCurrentBurst(nowTime)) {
       LOG(DEBUG) << "transmitFIFO: wrote burst " << next << " at time: " << nowTime;
-      if (i == mC0) {
-        delete fillerTable[i][modFN][TN];
-        fillerTable[i][modFN][TN] = new signalVector(*(next));
-        mIsFiller[i] = false;
-      } 
+      if (i == mC0)
+        updateFiller(i, *next, nowTime);
       mTxBursts[i] = next;
+      mTxVectors[i] = next;
     }
   }
 
   mRadioInterface->driveTransmitRadio(mTxBursts, mIsZero);
 
   for (i = 0; i < mChanM; i++) {
-    if (!mIsFiller[i])
-      delete mTxBursts[i];
+    if (mTxVectors[i])
+      mTxVectors[i]->release();
   }
 }
 
@@ -171,12 +227,10 @@ void DriveLoop::setModulus(int channel, int timeslot)
   }
 }
 
-DriveLoop::CorrType DriveLoop::expectedCorrType(int channel, GSM::Time currTime)
+DriveLoop::CorrType DriveLoop::comboCorrType(ChannelCombination comb,
+                                             unsigned burstFN)
 {
-  unsigned burstTN = currTime.TN();
-  unsigned burstFN = currTime.FN();
-
-  switch (mChanType[channel][burstTN]) {
+  switch (comb) {
   case NONE:
     return OFF;
     break;
@@ -232,15 +286,40 @@ DriveLoop::CorrType DriveLoop::expectedCorrType(int channel, GSM::Time currTime)
     break;
   }
 }
+
+/*
+ * Expected burst types only depend on the frame number modulo 2 or 51, so a
+ * table over the 102 frame cycle replaces the per-burst evaluation. The
+ * radio is told which slots to drop before they are copied out.
+ */
+void DriveLoop::setTimeslot(int m, int timeslot, ChannelCombination comb)
+{
+  bool active[RX_SCHEDULE_FRAMES];
+
+  mChanType[m][timeslot] = comb;
+
+  for (int fn = 0; fn < RX_SCHEDULE_FRAMES; fn++) {
+    CorrType type = comboCorrType(comb, fn);
+    mRxSchedule[m][timeslot][fn] = type;
+    active[fn] = (type != OFF) && (type != IDLE);
+  }
+
+  mRadioInterface->setSlotSchedule(m, timeslot, active);
+}
  
 void DriveLoop::driveReceiveFIFO() 
 {
-  SoftVector *rxBurst = NULL;
-  int RSSI;
-  int TOA;  // in 1/256 of a symbol
-  GSM::Time burstTime;
-
   mRadioInterface->driveReceiveRadio();
+
+  // Hand the new bursts off to the demodulation workers
+  if (mWorkerPool)
+    mWorkerPool->notify();
+}
+
+/* Signed distance from one clock to another in timeslots */
+static int timeslotDelta(const GSM::Time &to, const GSM::Time &from)
+{
+  return (to - from) * 8 + (int) to.TN() - (int) from.TN();
 }
 
 /*
@@ -252,42 +331,113 @@ void DriveLoop::driveReceiveFIFO()
  *  pushed into the FIFO right NOW.  If transmit queue does
  *  not have a burst, stick in filler data.
  */
-void DriveLoop::driveTransmitFIFO() 
+bool DriveLoop::driveTransmitFIFO() 
 {
-  int i;
+  bool pushed = false;
 
   RadioClock *radioClock = (mRadioInterface->getClock());
-  while (radioClock->get() + mTransmitLatency > mTransmitDeadlineClock) {
+  int latency = timeslotDelta(mTransmitLatency, GSM::Time(0));
+  GSM::Time now;
+
+  while ((now = radioClock->get()) + mTransmitLatency > mTransmitDeadlineClock) {
+    // a burst is first eligible with one timeslot less than the full
+    // latency of slack, any less means this thread fell behind, none
+    // means it is late
+    int slack = timeslotDelta(mTransmitDeadlineClock, now);
+    if (slack <= 0)
+      mDeadlineMisses++;
+    mDeadlineStats.add(latency - 1 - slack);
+
     pushRadioVector(mTransmitDeadlineClock);
+    mClockLock.lock();
     mTransmitDeadlineClock.incTN();
+    mClockLock.unlock();
+    pushed = true;
   }
 
-  // FIXME -- This should not be a hard spin.
-  // But any delay here causes us to throw omni_thread_fatal.
-  //else radioClock->wait();
+  return pushed;
+}
+
+/*
+ * The receive thread advances the radio clock as samples arrive, so the
+ * transmit thread blocks on clock updates instead of spinning. With a slack
+ * margin, it sleeps until the clock is predicted to leave only that much
+ * lead on the next burst and then pushes everything due in one pass,
+ * trading transmit lead for fewer wakeups.
+ */
+void DriveLoop::waitTransmit()
+{
+  RadioClock *radioClock = mRadioInterface->getClock();
+  struct timespec wake;
+  long period;
+
+  GSM::Time now = radioClock->get(wake, period);
+  if (now + mTransmitLatency > mTransmitDeadlineClock)
+    return;
+
+  int ticks = timeslotDelta(mTransmitDeadlineClock, now) - mTransmitSlack;
+  if ((mTransmitSlack > 0) && (ticks > 0)) {
+    long long ns = wake.tv_nsec + (long long) ticks * period;
+    wake.tv_sec += ns / 1000000000LL;
+    wake.tv_nsec = ns % 1000000000LL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+  }
+
+  // returns at once if the clock moved while sleeping
+  radioClock->wait(now);
 }
 
 void DriveLoop::writeClockInterface()
 {
   char command[50];
+  ScopedLock lock(mClockLock);
+
+  // the core follows a single clock, that of the primary device, whose
+  // lock serializes the indications from all devices
+  if (mClockSource) {
+    int drift = timeslotDelta(mTransmitDeadlineClock,
+                              mClockSource->getDeadlineClock());
+    if (abs(drift) > 8)
+      LOG(WARNING) << "Device clock is " << drift
+                   << " timeslots from the primary device";
+
+    mClockSource->writeClockInterface();
+    mLastClockUpdateTime = mTransmitDeadlineClock;
+    return;
+  }
+
   // FIXME -- This should be adaptive.
   sprintf(command,"IND CLOCK %llu",
           (unsigned long long) (mTransmitDeadlineClock.FN() + 2));
 
   LOG(INFO) << "ClockInterface: sending " << command;
 
-  mClockSocket.write(command,strlen(command)+1);
+  mClockSocket->write(command,strlen(command)+1);
 
   mLastClockUpdateTime = mTransmitDeadlineClock;
 }
 
-void *RadioDriveLoopAdapter(DriveLoop *drive)
+void *RadioReceiveLoopAdapter(DriveLoop *drive)
 {
   drive->setPriority();
+  setThreadAffinity(drive->mReceiveCPU);
 
   while (drive->on()) {
     drive->driveReceiveFIFO();
+    pthread_testcancel();
+  }
+
+  return NULL;
+}
+
+void *RadioTransmitLoopAdapter(DriveLoop *drive)
+{
+  drive->setPriority();
+  setThreadAffinity(drive->mTransmitCPU);
+
+  while (drive->on()) {
     drive->driveTransmitFIFO();
+    drive->waitTransmit();
     pthread_testcancel();
   }
 
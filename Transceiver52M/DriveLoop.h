@@ -43,6 +43,12 @@
 /** Define this to be the slot number to be logged. */
 //#define TRANSMIT_LOGGING 1
 
+/** Devices with a shared time start on multiples of 13 frames, 60 ms, a whole number of samples at every rate */
+#define ALIGN_FRAMES		13
+#define ALIGN_PERIOD		0.06
+
+class WorkerPool;
+
 /** The Transceiver class, responsible for physical layer of basestation */
 class DriveLoop {
   
@@ -52,14 +58,24 @@ private:
   GSM::Time mLatencyUpdateTime;   ///< last time latency was updated
   GSM::Time mLastClockUpdateTime; ///< last time clock update was sent up to core
 
-  UDPSocket mClockSocket;	  ///< socket for writing clock updates to GSM core
+  UDPSocket *mClockSocket;	  ///< socket for writing clock updates to GSM core, NULL when following another clock
 
   VectorQueue  mTransmitPriorityQueue[CHAN_MAX];   ///< priority queue of transmit bursts received from GSM core
 
-  Thread *mRadioDriveLoopThread;  ///< thread to push/pull bursts into transmit/receive FIFO
+  Thread *mReceiveThread;         ///< thread to pull and channelize bursts into the receive FIFO's
+  Thread *mTransmitThread;        ///< thread to push and synthesize bursts from the transmit queues
+  WorkerPool *mWorkerPool;        ///< demodulation workers woken after each received chunk
+  int mReceiveCPU;                ///< CPU affinity of the receive thread, negative if unpinned
+  int mTransmitCPU;               ///< CPU affinity of the transmit thread, negative if unpinned
+  int mTransmitSlack;             ///< paced transmit lead in timeslots, zero to wake on every clock update
 
   GSM::Time mTransmitDeadlineClock;       ///< deadline for pushing bursts into transmit FIFO 
   GSM::Time mStartTime;                   ///< random start time of the radio clock
+  DriveLoop *mClockSource;                ///< drive loop of the primary device, NULL on the primary
+  Mutex mClockLock;                       ///< guards the deadline and update clocks and the clock socket across devices
+
+  LatencyHistogram mDeadlineStats;        ///< timeslots each burst was pushed after its earliest push time
+  volatile unsigned mDeadlineMisses;      ///< bursts pushed at or after their transmit time
 
   RadioInterface *mRadioInterface;	  ///< associated radioInterface object
   double txFullScale;                     ///< full scale input to radio
@@ -73,9 +89,18 @@ private:
   void unModulateVector(signalVector wVector); 
 #endif
 
+  /** Restart the radio and deadline clocks at a new time */
+  void syncClock(const GSM::Time &wTime);
+
+  /** Alignment periods of device time before the first sample of the radio */
+  long long startPeriods();
+
   /** Push modulated burst into transmit FIFO corresponding to a particular timestamp */
   void pushRadioVector(GSM::Time &nowTime);
 
+  /** Copy a transmitted burst into the filler table */
+  void updateFiller(int chan, const signalVector &burst, const GSM::Time &time);
+
   /** Pull and demodulate a burst from the receive FIFO */ 
   SoftVector *pullRadioVector(GSM::Time &wTime, int &RSSI, int &timingOffset);
    
@@ -91,7 +116,7 @@ private:
   int mC0;
 
   signalVector *mTxBursts[CHAN_MAX];
-  bool         mIsFiller[CHAN_MAX];
+  radioVector  *mTxVectors[CHAN_MAX];           ///< queued bursts to release after transmit, NULL for filler
   bool         mIsZero[CHAN_MAX];
 
 public:
@@ -102,11 +127,19 @@ public:
       @param wSamplesPerSymbol number of samples per GSM symbol
       @param wTransmitLatency initial setting of transmit latency
       @param radioInterface associated radioInterface object
+      @param wClockSource drive loop of the primary device to follow, NULL
+             on the primary. A following drive loop opens no clock socket,
+             its base port and address are unused. The devices must share a
+             time, see RadioDevice::alignTimes. The radio clock starts from
+             the primary's start time, advanced by the sample time between
+             the two device starts, and clock indications are sent through
+             the primary.
   */
   DriveLoop(int wBasePort, const char *TRXAddress,
 	    int wChanM, int wC0, int wSamplesPerSymbol,
 	    GSM::Time wTransmitLatency,
-	    RadioInterface *wRadioInterface);
+	    RadioInterface *wRadioInterface,
+	    DriveLoop *wClockSource = NULL);
    
   /** Destructor */
   ~DriveLoop();
@@ -116,6 +149,23 @@ public:
 
   VectorQueue *priorityQueue(int m) { return &mTransmitPriorityQueue[m]; }
 
+  /** attach the demodulation worker pool, must be called before start */
+  void setWorkerPool(WorkerPool *wPool) { mWorkerPool = wPool; }
+
+  /** set receive and transmit thread CPU affinities, negative to disable */
+  void setAffinity(int wReceiveCPU, int wTransmitCPU)
+  {
+    mReceiveCPU = wReceiveCPU;
+    mTransmitCPU = wTransmitCPU;
+  }
+
+  /**
+    pace the transmit thread instead of waking on every clock update
+    @param wSlack timeslots of lead left on a burst when the thread wakes,
+                  zero or at least the transmit latency to disable
+  */
+  void setTransmitSlack(int wSlack) { mTransmitSlack = wSlack; }
+
   /** Codes for burst types of received bursts*/
   typedef enum {
     OFF,               ///< timeslot is off
@@ -142,16 +192,22 @@ public:
   void setModulus(int channel, int timeslot);
 
   /** return the expected burst type for the specified timestamp */
-  CorrType expectedCorrType(int channel, GSM::Time currTime);
-
-  void setTimeslot(int m, int timeslot, ChannelCombination comb)
+  CorrType expectedCorrType(int channel, GSM::Time currTime)
   {
-    mChanType[m][timeslot] = comb;
+    return (CorrType) mRxSchedule[channel][currTime.TN()]
+                                 [currTime.FN() % RX_SCHEDULE_FRAMES];
   }
 
+  /** Set the channel combination of a timeslot and rebuild its receive schedule */
+  void setTimeslot(int m, int timeslot, ChannelCombination comb);
+
   GSM::Time getStartTime() { return mStartTime; }
-  GSM::Time getLastClockUpdate() { return mLastClockUpdateTime; }
-  GSM::Time getDeadlineClock() { return mTransmitDeadlineClock; }
+  GSM::Time getLastClockUpdate() { ScopedLock lock(mClockLock); return mLastClockUpdateTime; }
+  GSM::Time getDeadlineClock() { ScopedLock lock(mClockLock); return mTransmitDeadlineClock; }
+
+  /** transmit deadline probe, written by the transmit thread */
+  const LatencyHistogram &deadlineStats() const { return mDeadlineStats; }
+  unsigned deadlineMisses() const { return mDeadlineMisses; }
 
   /** send messages over the clock socket */
   void writeClockInterface(void);
@@ -159,14 +215,24 @@ public:
 private:
 
   ChannelCombination mChanType[CHAN_MAX][8];     ///< channel types for all timeslots
+  unsigned char mRxSchedule[CHAN_MAX][8][RX_SCHEDULE_FRAMES]; ///< expected burst types by frame number modulo the schedule
+
+  /** Burst type a channel combination expects in a frame */
+  static CorrType comboCorrType(ChannelCombination comb, unsigned burstFN);
 
 protected:
 
   /** drive reception and demodulation of GSM bursts */ 
   void driveReceiveFIFO();
 
-  /** drive transmission of GSM bursts */
-  void driveTransmitFIFO();
+  /**
+    drive transmission of GSM bursts
+    @return true if any bursts were pushed to the radio
+  */
+  bool driveTransmitFIFO();
+
+  /** block the transmit thread until more bursts are due */
+  void waitTransmit();
 
   /** drive handling of control messages from GSM core */
   void driveControl();
@@ -177,7 +243,9 @@ protected:
   */
   bool driveTransmitPriorityQueue();
 
-  friend void *RadioDriveLoopAdapter(DriveLoop *);
+  friend void *RadioReceiveLoopAdapter(DriveLoop *);
+
+  friend void *RadioTransmitLoopAdapter(DriveLoop *);
 
   void reset();
 
@@ -189,7 +257,10 @@ protected:
 
 };
 
-/** FIFO thread loop */
-void *RadioDriveLoopAdapter(DriveLoop *);
+/** receive and channelizer thread loop */
+void *RadioReceiveLoopAdapter(DriveLoop *);
+
+/** transmit and synthesis thread loop */
+void *RadioTransmitLoopAdapter(DriveLoop *);
 
 #endif /* _DRIVELOOP_H_ */
@@ -23,17 +23,10 @@
 */
 
 
-/*
-	Compilation Flags
-
-	SWLOOPBACK	compile for software loopback testing
-*/ 
-
-
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
-#include "Threads.h"
+#include <errno.h>
 #include "DummyLoad.h"
 
 #include <Logger.h>
@@ -42,40 +35,45 @@
 using namespace std;
 
 
-
-int DummyLoad::loadBurst(short *wDummyBurst, int len) {
-  dummyBurst = wDummyBurst;
-  dummyBurstSz = len;
-}
-
-
-DummyLoad::DummyLoad (double _desiredSampleRate) 
+DummyLoad::DummyLoad (double _desiredSampleRate, double offset) 
+  : speed(1.0), samplesRead(0), samplesWritten(0),
+    replayBuf(NULL), replayLen(0), readLen(0)
 {
-  LOG(INFO) << "creating USRP device...";
+  LOG(INFO) << "creating dummy device...";
   sampleRate = _desiredSampleRate;
+  rxOffset = (TIMESTAMP) (offset * sampleRate);
+  lastReadStamp = 0;
 }
 
-void DummyLoad::updateTime(void) {
-    gettimeofday(&currTime,NULL);
-    double timeElapsed = (currTime.tv_sec - startTime.tv_sec)*1.0e6 + 
-      (currTime.tv_usec - startTime.tv_usec);
-    currstamp = (TIMESTAMP) floor(timeElapsed/(1.0e6/sampleRate));
+DummyLoad::~DummyLoad()
+{
+  delete[] replayBuf;
 }
 
-bool DummyLoad::make(bool wSkipRx) 
+void DummyLoad::loadSamples(const float *wSamples, int len)
 {
+  delete[] replayBuf;
+  replayBuf = new float[2 * len];
+  memcpy(replayBuf, wSamples, 2 * len * sizeof(float));
+  replayLen = len;
+}
 
+bool DummyLoad::open()
+{
   samplesRead = 0;
   samplesWritten = 0;
+
+  for (int i = 0; i < DUMMY_READ_LOG_LEN; i++)
+    readLog[i].stamp = 0;
+
   return true;
 }
 
 bool DummyLoad::start() 
 {
-  LOG(INFO) << "starting USRP...";
-  underrun = false;
-  gettimeofday(&startTime,NULL);
-  dummyBurstCursor = 0;
+  LOG(INFO) << "starting dummy device...";
+  lastReadStamp = initialReadTimestamp();
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
   return true;
 }
 
@@ -84,56 +82,97 @@ bool DummyLoad::stop()
   return true;
 }
 
+void DummyLoad::waitTime(TIMESTAMP timestamp)
+{
+  if (speed <= 0.0)
+    return;
+
+  double elapsed = (timestamp - initialReadTimestamp()) / (sampleRate * speed);
+
+  struct timespec deadline = startTime;
+  deadline.tv_sec += (time_t) elapsed;
+  deadline.tv_nsec += (long) ((elapsed - floor(elapsed)) * 1.0e9);
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
 
-// NOTE: Assumes sequential reads
-int DummyLoad::readSamples(short *buf, int len, bool *overrun, 
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                         &deadline, NULL) == EINTR);
+}
+
+// NOTE: Assumes sequential reads of constant length
+int DummyLoad::readSamples(float *buf, int len, bool *overrun, 
 			    TIMESTAMP timestamp,
 			    bool *wUnderrun,
 			    unsigned *RSSI) 
 {
-  updateTime();
-  underrunLock.lock();
-  *wUnderrun = underrun;
-  underrunLock.unlock();
-  if (currstamp+len < timestamp) {
-	usleep(100); 
-	return 0;
-  } 
-  else if (currstamp < timestamp) {
-	usleep(100);
-	return 0;
+  int i, n;
+  unsigned long long idx;
+
+  waitTime(timestamp + len);
+
+  if (!replayLen) {
+    memset(buf, 0, 2 * len * sizeof(float));
+  } else {
+    idx = (timestamp - initialReadTimestamp() + rxOffset) % replayLen;
+    for (i = 0; i < len; i += n) {
+      n = replayLen - idx;
+      if (n > len - i)
+        n = len - i;
+
+      memcpy(&buf[2 * i], &replayBuf[2 * idx], 2 * n * sizeof(float));
+      idx = (idx + n) % replayLen;
+    }
   }
-  else if (timestamp+len < currstamp) {
-	memcpy(buf,dummyBurst+dummyBurstCursor*2,sizeof(short)*2*(dummyBurstSz-dummyBurstCursor));
-	int retVal = dummyBurstSz-dummyBurstCursor;
-	dummyBurstCursor = 0;
-	return retVal;
-  }
-  else if (timestamp + len > currstamp) {
-	int amount = timestamp + len - currstamp;
-	if (amount < dummyBurstSz-dummyBurstCursor) {
-	        memcpy(buf,dummyBurst+dummyBurstCursor*2,sizeof(short)*2*amount);
-        	dummyBurstCursor += amount;
-        	return amount;
-	}
-	else {
-        	memcpy(buf,dummyBurst+dummyBurstCursor*2,sizeof(short)*2*(dummyBurstSz-dummyBurstCursor));
-        	int retVal = dummyBurstSz-dummyBurstCursor;
-        	dummyBurstCursor = 0;
-        	return retVal;
-        }
+
+  // Record the read time before publishing the timestamp
+  if (!readLen)
+    readLen = len;
+  if (len == readLen) {
+    ReadLog *entry = &readLog[((timestamp - initialReadTimestamp()) / len) %
+                              DUMMY_READ_LOG_LEN];
+    clock_gettime(CLOCK_MONOTONIC, &entry->time);
+    __sync_synchronize();
+    entry->stamp = timestamp;
   }
-  return 0;
+
+  lastReadStamp = timestamp + len;
+  samplesRead += len;
+
+  *overrun = false;
+
+  return len;
 }
 
-int DummyLoad::writeSamples(short *buf, int len, bool *wUnderrun, 
+bool DummyLoad::readTime(TIMESTAMP timestamp, struct timespec *time)
+{
+  if (!readLen || (timestamp < initialReadTimestamp()))
+    return false;
+
+  TIMESTAMP n = (timestamp - initialReadTimestamp()) / readLen;
+  TIMESTAMP stamp = initialReadTimestamp() + n * readLen;
+  ReadLog *entry = &readLog[n % DUMMY_READ_LOG_LEN];
+
+  if (entry->stamp != stamp)
+    return false;
+
+  __sync_synchronize();
+  *time = entry->time;
+  __sync_synchronize();
+
+  return entry->stamp == stamp;
+}
+
+int DummyLoad::writeSamples(float *buf, int len, bool *wUnderrun, 
 			     unsigned long long timestamp,
 			     bool isControl) 
 {
-  updateTime();
-  underrunLock.lock();
-  underrun |= (currstamp+len < timestamp); 
-  underrunLock.unlock();
+  // Transmit bursts arriving after the receive clock are late
+  if (timestamp + len < lastReadStamp)
+    *wUnderrun = true;
+  samplesWritten += len;
+
   return len;
 }
 
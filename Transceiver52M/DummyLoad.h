@@ -23,6 +23,9 @@
 */
 
 
+#ifndef _DUMMYLOAD_H_
+#define _DUMMYLOAD_H_
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -30,73 +33,112 @@
 #include "radioDevice.h"
 
 
-#include <sys/time.h>
+#include <time.h>
 #include <math.h>
 #include <string>
 #include <iostream>
 
+/** Number of device reads remembered for latency measurements */
+#define DUMMY_READ_LOG_LEN	8192
 
-/** A class to handle a USRP rev 4, with a two RFX900 daughterboards */
+/**
+	A radio device without hardware. Receive samples are replayed from a
+	looped buffer of recorded or synthetic I/Q and transmit samples are
+	counted and discarded. The sample clock is paced against the wall clock
+	at a selectable speed, or runs as fast as it is read.
+*/
 class DummyLoad: public RadioDevice {
 
 private:
 
   double sampleRate; 	///< the desired sampling rate
-  unsigned long long samplesRead;	///< number of samples read from USRP
-  unsigned long long samplesWritten;	///< number of samples sent to USRP
+  double speed;		///< sample clock rate relative to real time, zero if unpaced
+  unsigned long long samplesRead;	///< number of samples read from device
+  unsigned long long samplesWritten;	///< number of samples sent to device
+
+  TIMESTAMP rxOffset;			///< receive timestamp offset in samples
+
+  struct timespec startTime;
 
-  Mutex underrunLock;
+  volatile TIMESTAMP lastReadStamp;	///< end timestamp of the most recent read
 
-  struct timeval startTime, currTime; 
+  float *replayBuf;			///< interleaved I/Q receive samples
+  int replayLen;			///< length of the replay buffer in samples
 
-  TIMESTAMP currstamp;
-  short *dummyBurst;
-  int dummyBurstSz;
-  int dummyBurstCursor;
-  bool underrun;
+  /** Wall clock time of recent reads, indexed by read number */
+  struct ReadLog {
+    volatile TIMESTAMP stamp;
+    struct timespec time;
+  } readLog[DUMMY_READ_LOG_LEN];
+  int readLen;				///< length of each read in samples
 
-  void updateTime(void);
+  /** Block until the sample clock reaches a timestamp */
+  void waitTime(TIMESTAMP timestamp);
 
  public:
 
   /** Object constructor */
-  DummyLoad (double _desiredSampleRate);
+  DummyLoad(double _desiredSampleRate, double offset = 0.0);
+
+  ~DummyLoad();
+
+  /**
+	Load the samples replayed on the receive side.
+	@param wSamples interleaved I/Q samples, copied
+	@param len number of samples
+  */
+  void loadSamples(const float *wSamples, int len);
+
+  /** Set the sample clock rate relative to real time, zero runs unpaced */
+  void setSpeed(double wSpeed) { speed = wSpeed; }
 
-  int loadBurst(short *wDummyBurst, int len);
+  /**
+	Find when the samples at a timestamp were returned to the reader.
+	@param timestamp receive timestamp of interest
+	@param time wall clock time (CLOCK_MONOTONIC) of the read
+	@return false if the read was not recent
+  */
+  bool readTime(TIMESTAMP timestamp, struct timespec *time);
 
-  /** Instantiate the USRP */
-  bool make(bool skipRx = false); 
+  /** Initialize the device */
+  bool open();
 
-  /** Start the USRP */
+  /** Start the device */
   bool start();
 
-  /** Stop the USRP */
+  /** Stop the device */
   bool stop();
 
+  /** Get the bus type */
+  enum busType getBus() { return NET; }
+
+  /** Enable thread priority */
+  void setPriority() {}
+
   /**
-	Read samples from the USRP.
+	Read samples from the device.
 	@param buf preallocated buf to contain read result
 	@param len number of samples desired
 	@param overrun Set if read buffer has been overrun, e.g. data not being read fast enough
 	@param timestamp The timestamp of the first samples to be read
-	@param underrun Set if USRP does not have data to transmit, e.g. data not being sent fast enough
+	@param underrun Set if device does not have data to transmit, e.g. data not being sent fast enough
 	@param RSSI The received signal strength of the read result
 	@return The number of samples actually read
   */
-  int  readSamples(short *buf, int len, bool *overrun, 
+  int  readSamples(float *buf, int len, bool *overrun, 
 		   TIMESTAMP timestamp = 0xffffffff,
 		   bool *underrun = NULL,
 		   unsigned *RSSI = NULL);
   /**
-        Write samples to the USRP.
+        Write samples to the device.
         @param buf Contains the data to be written.
         @param len number of samples to write.
-        @param underrun Set if USRP does not have data to transmit, e.g. data not being sent fast enough
+        @param underrun Set if device does not have data to transmit, e.g. data not being sent fast enough
         @param timestamp The timestamp of the first sample of the data buffer.
         @param isControl Set if data is a control packet, e.g. a ping command
         @return The number of samples actually written
   */
-  int  writeSamples(short *buf, int len, bool *underrun, 
+  int  writeSamples(float *buf, int len, bool *underrun, 
 		    TIMESTAMP timestamp = 0xffffffff,
 		    bool isControl = false);
  
@@ -121,6 +163,15 @@ private:
   /** returns the full-scale receive amplitude **/
   double fullScaleOutputValue() {return 9450.0;}
 
+  /** Gain controls have no effect */
+  double setRxGain(double dB) { return dB; }
+  double getRxGain(void) { return 0.0; }
+  double maxRxGain(void) { return 0.0; }
+  double minRxGain(void) { return 0.0; }
+  double setTxGain(double dB) { return dB; }
+  double maxTxGain(void) { return 0.0; }
+  double minTxGain(void) { return 0.0; }
+
   /** Return internal status values */
   inline double getTxFreq() { return 0;}
   inline double getRxFreq() { return 0;}
@@ -130,3 +181,4 @@ private:
 
 };
 
+#endif /* _DUMMYLOAD_H_ */
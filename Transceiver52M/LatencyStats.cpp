@@ -0,0 +1,104 @@
+/*
+ * Transceiver latency statistics
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+#include <stdio.h>
+
+#include "LatencyStats.h"
+
+/* Minimum reference interval before the tick rate is trusted */
+#define CALIBRATE_NS		10000000.0
+
+static double monotonicNs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1.0e9 + ts.tv_nsec;
+}
+
+/*
+ * Reference point taken at load time. Statistics are read long after
+ * startup, so the tick rate is measured over the whole run instead of
+ * stalling startup with a calibration loop.
+ */
+static struct LatencyReference {
+	LatencyReference() : ticks(latencyTicks()), ns(monotonicNs()) { }
+	uint64_t ticks;
+	double ns;
+} latencyRef;
+
+double latencyTickNs()
+{
+	double ns = monotonicNs() - latencyRef.ns;
+	uint64_t ticks = latencyTicks() - latencyRef.ticks;
+
+	if ((ns < CALIBRATE_NS) || !ticks)
+		return 1.0;
+
+	return ns / (double) ticks;
+}
+
+LatencyHistogram::LatencyHistogram()
+	: mCount(0), mMax(0)
+{
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+		mBuckets[i] = 0;
+}
+
+uint64_t LatencyHistogram::percentile(float frac) const
+{
+	uint64_t snap[LATENCY_BUCKETS];
+	uint64_t total = 0, sum = 0, target;
+	int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		snap[i] = mBuckets[i];
+		total += snap[i];
+	}
+
+	if (!total)
+		return 0;
+
+	target = (uint64_t) (frac * total);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0; i < LATENCY_BUCKETS - 1; i++) {
+		sum += snap[i];
+		if (sum >= target)
+			break;
+	}
+
+	/* Bucket i holds values below 2^i, clipped to the largest seen */
+	uint64_t bound = ((uint64_t) 1 << i) - 1;
+	uint64_t max = mMax;
+
+	return bound < max ? bound : max;
+}
+
+int LatencyHistogram::format(char *buf, size_t len,
+			     const char *name, double scale) const
+{
+	return snprintf(buf, len, " %s %llu %.1f %.1f %.1f", name,
+			(unsigned long long) count(),
+			percentile(0.50f) * scale,
+			percentile(0.99f) * scale,
+			max() * scale);
+}
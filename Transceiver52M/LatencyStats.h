@@ -0,0 +1,96 @@
+/*
+ * Transceiver latency statistics
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+#ifndef _LATENCYSTATS_H_
+#define _LATENCYSTATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/* Log2 buckets, the last one collects everything above 2^46 */
+#define LATENCY_BUCKETS		48
+
+/* Probe timestamp, time stamp counter ticks or monotonic nanoseconds */
+static inline uint64_t latencyTicks()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* Nanoseconds per probe tick, calibrated against the monotonic clock */
+double latencyTickNs();
+
+/*
+ * Log2 histogram of probe durations or queue depths
+ *
+ * Each histogram has exactly one writer thread and is updated without
+ * locks or atomic operations. Readers on other threads take a snapshot
+ * that may miss samples in flight, which is acceptable for statistics
+ * and never stalls the radio threads.
+ */
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	/** Record a sample, writer thread only */
+	void add(uint64_t val)
+	{
+		int bucket = val ? 64 - __builtin_clzll(val) : 0;
+
+		if (bucket >= LATENCY_BUCKETS)
+			bucket = LATENCY_BUCKETS - 1;
+
+		mBuckets[bucket]++;
+		mCount++;
+		if (val > mMax)
+			mMax = val;
+	}
+
+	/** Record the ticks elapsed since a probe timestamp */
+	void addSince(uint64_t start) { add(latencyTicks() - start); }
+
+	uint64_t count() const { return mCount; }
+	uint64_t max() const { return mMax; }
+
+	/** Upper bucket bound below which a fraction of samples fall */
+	uint64_t percentile(float frac) const;
+
+	/** Print " name count p50 p99 max" with values multiplied by scale
+	    @return number of characters written, as with snprintf
+	 */
+	int format(char *buf, size_t len, const char *name, double scale) const;
+
+private:
+	volatile uint64_t mBuckets[LATENCY_BUCKETS];
+	volatile uint64_t mCount;
+	volatile uint64_t mMax;
+};
+
+#endif /* _LATENCYSTATS_H_ */
@@ -224,12 +224,12 @@ bool Resampler::deactivateChan(int num)
 		return false;
 	}
 
-	if (chanActive[num]) {
-		LOG(ERR) << "Channel already activated";
+	if (!chanActive[num]) {
+		LOG(ERR) << "Channel not active";
 		return false;
 	}
 
-	chanActive[num] = true;
+	chanActive[num] = false;
 
 	return true;
 }
@@ -238,6 +238,9 @@ bool Resampler::init(struct cxvec **protoFilter)
 {
 	int i, rc;
 
+	/* Select convolution kernels for this processor */
+	convolve_init();
+
 	/* Filterbank internals */
 	rc = initFilters(protoFilter);
 	if (rc < 0) {
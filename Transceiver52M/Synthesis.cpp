@@ -28,7 +28,7 @@
 #include "Synthesis.h"
 
 /* Check vector length validity */
-static bool checkVectorLen(struct cxvec **in, struct cxvec *out,
+static bool checkVectorLen(struct cxvec **in, int outLen,
 			   int p, int q, int mul)
 {
 	if (in[0]->len % (q * mul)) {
@@ -37,8 +37,8 @@ static bool checkVectorLen(struct cxvec **in, struct cxvec *out,
 		return false;
 	}
 
-	if (out->len % (p * mul)) {
-		LOG(ERR) << "Invalid output length " << out->len
+	if (outLen % (p * mul)) {
+		LOG(ERR) << "Invalid output length " << outLen
 			 <<  " is not multiple of " << p * mul;
 		return false;
 	}
@@ -52,12 +52,12 @@ static bool checkVectorLen(struct cxvec **in, struct cxvec *out,
  * "harris, fred, Multirate Signal Processing, Upper Saddle River, NJ,
  *     Prentice Hall, 2006."
  */
-int Synthesis::rotate(struct cxvec **in, struct cxvec *out)
+bool Synthesis::filter(struct cxvec **in, int outLen)
 {
-	int i, rc;
+	int i;
 
-	if (!checkVectorLen(in, out, mP, mQ, mMul)) {
-		return -1;
+	if (!checkVectorLen(in, outLen, mP, mQ, mMul)) {
+		return false;
 	}
 
 	/*
@@ -67,12 +67,10 @@ int Synthesis::rotate(struct cxvec **in, struct cxvec *out)
 	mResampler->rotate(in, partInputs);
 
 	/* 
-	 * Interleave resampled input into FFT
-	 * Deinterleave back into filterbank partition input buffers
+	 * Strided FFT across the filterbank partition input buffers in place,
+	 * or direct evaluation from active bins when few channels are active
 	 */
-	cxvec_interlv(partInputs, fftBuffer, mChanM);
-	cxvec_fft(fftHandle, fftBuffer, fftBuffer);
-	cxvec_deinterlv_fw(fftBuffer, partInputs, mChanM);
+	transform();
 
 	/* 
 	 * Convolve through filterbank while applying and saving sample history 
@@ -88,6 +86,14 @@ int Synthesis::rotate(struct cxvec **in, struct cxvec *out)
 		       mPartitionLen * sizeof(cmplx));
 	}
 
+	return true;
+}
+
+int Synthesis::rotate(struct cxvec **in, struct cxvec *out)
+{
+	if (!filter(in, out->len))
+		return -1;
+
 	/* 
 	 * Interleave into output vector
 	 */
@@ -96,6 +102,19 @@ int Synthesis::rotate(struct cxvec **in, struct cxvec *out)
 	return out->len;
 }
 
+int Synthesis::rotate(struct cxvec **in, short *out, int len, float scale)
+{
+	if (!filter(in, len))
+		return -1;
+
+	/* 
+	 * Interleave and convert to 16-bit I/Q in a single pass
+	 */
+	cxvec_interlv_sc16(partOutputs, out, mChanM, scale);
+
+	return len;
+}
+
 Synthesis::Synthesis(int wChanM, int wPartitionLen, int wResampLen,
 		     int wP, int wQ, int wMul) 
 	: ChannelizerBase(wChanM, wPartitionLen, wResampLen,
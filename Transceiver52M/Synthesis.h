@@ -43,6 +43,19 @@ public:
 	    @return number of samples outputted
 	 */
 	int rotate(struct cxvec **in, struct cxvec *out);
+
+	/** Rotate "output commutator" with 16-bit I/Q output
+	    @param in set of 'M' input vectors 
+	    @param out interleaved I/Q output buffer
+	    @param len output length in complex samples
+	    @param scale gain applied before rounding to 16-bits
+	    @return number of samples outputted
+	 */
+	int rotate(struct cxvec **in, short *out, int len, float scale);
+
+private:
+	/* Drive samples through filterbank into the partition outputs */
+	bool filter(struct cxvec **in, int outLen);
 };
 
 #endif /* _SYNTHESIS_H_ */
@@ -38,6 +38,18 @@
 
 #define USB_LATENCY_INTRVL		(10,0)
 
+/* Channel tracking, frames without a detected burst before an estimate expires */
+#define CHAN_MAX_AGE			50
+
+/* Weight of each new channel estimate in the running average */
+#define CHAN_AVG_WEIGHT			0.25F
+
+/* Relative innovation of a new estimate that restarts tracking, about -3 dB */
+#define CHAN_RESET_INNOV		0.5F
+
+/* Relative drift from the DFE design channel that triggers a redesign, about -13 dB */
+#define DFE_REDESIGN_DRIFT		0.05F
+
 #if USE_UHD
 #  define USB_LATENCY_MIN		(6,7)
 #else
@@ -52,16 +64,19 @@ Transceiver::Transceiver(int wBasePort,
 			 int wChannel, bool wPrimary)
 	:mDataSocket(wBasePort+2,TRXAddress,wBasePort+102),
 	 mControlSocket(wBasePort+1,TRXAddress,wBasePort+101),
+	 mUplink(NULL), mDownlink(NULL), mRxFrame(NULL),
 	 mDriveLoop(wDriveLoop), mTransmitPriorityQueue(NULL),
-	 mChannel(wChannel), mPrimary(wPrimary)
+	 mChannel(wChannel), mDemodWorkspace(wSamplesPerSymbol),
+	 mRxBits(gSlotLen), mChanEstimate(6*wSamplesPerSymbol),
+	 mRACHBatch(NULL), mPrimary(wPrimary)
 {
-  mFIFOServiceLoopThread = NULL;
   mControlServiceLoopThread = NULL;
   mTransmitPriorityQueueServiceLoopThread = NULL;
 
   mSamplesPerSymbol = wSamplesPerSymbol;
   mRadioInterface = wRadioInterface;
   mMaxExpectedDelay = 0;
+  mEqualizer = EQ_DFE;
 
   // generate pulse and setup up signal processing library
   gsmPulse = generateGSMPulse(2,mSamplesPerSymbol);
@@ -78,6 +93,7 @@ Transceiver::Transceiver(int wBasePort,
     channelResponse[i] = NULL;
     DFEForward[i] = NULL;
     DFEFeedback[i] = NULL;
+    DFEChannel[i] = NULL;
     channelEstimateTime[i] = mDriveLoop->getStartTime();
   }
 
@@ -94,14 +110,21 @@ Transceiver::Transceiver(int wBasePort,
   mPower = -10;
   mEnergyThreshold = 5.0; // based on empirical data
   prevFalseDetectionTime = mDriveLoop->getStartTime();
+  mLastGated = RX_GATED_NONE;
 }
 
 Transceiver::~Transceiver()
 {
+  for (size_t i = 0; i < mPendingRACH.size(); i++)
+    mPendingRACH[i].burst->release();
+
+  for (int i = 0; i < 8; i++)
+    resetChannel(i);
+
   delete gsmPulse;
+  delete mRxFrame;
   mTransmitPriorityQueue->clear();
 
-  delete mFIFOServiceLoopThread;
   delete mControlServiceLoopThread;
   delete mTransmitPriorityQueueServiceLoopThread;
 }
@@ -111,15 +134,25 @@ void Transceiver::addRadioVector(BitVector &burst,
 				 int RSSI,
 				 GSM::Time &wTime)
 {
-  // modulate and stick into queue 
-  signalVector* modBurst = modulateBurst(burst,*gsmPulse,
-					 8 + (wTime.TN() % 4 == 0),
-					 mSamplesPerSymbol);
-  scaleVector(*modBurst,txFullScale * pow(10,-RSSI/10));
-  radioVector *newVec = new radioVector(*modBurst,wTime);
-  mTransmitPriorityQueue->write(newVec);
+  if (mTransmitPriorityQueue->full()) {
+    LOG(NOTICE) << "Transmit queue overflow, dropping burst at " << wTime;
+    return;
+  }
 
-  delete modBurst;
+  // modulate, or reuse a previous modulation of the same bits, and stick into queue 
+  // only cache misses run the modulator, so only those are timed
+  unsigned misses = mBurstCache.misses();
+  uint64_t start = latencyTicks();
+  const signalVector *modBurst = mBurstCache.modulate(burst,*gsmPulse,
+						      8 + (wTime.TN() % 4 == 0),
+						      mSamplesPerSymbol);
+  if (mBurstCache.misses() != misses)
+    mModStats.addSince(start);
+
+  radioVector *newVec = mTransmitPriorityQueue->get(modBurst->size(),wTime);
+  modBurst->copyTo(*newVec);
+  scaleVector(*newVec,txFullScale * pow(10,-RSSI/10));
+  mTransmitPriorityQueue->write(newVec);
 }
 
 #ifdef TRANSMIT_LOGGING
@@ -145,15 +178,12 @@ void Transceiver::unModulateVector(signalVector wVector)
 }
 #endif
  
-SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
-				      int &RSSI,
-				      int &timingOffset)
+bool Transceiver::pullRadioVector(radioVector *rxBurst,
+				  GSM::Time &wTime,
+				  int &RSSI,
+				  int &timingOffset)
 {
-  bool needDFE = (mMaxExpectedDelay > 1);
-
-  radioVector *rxBurst = (radioVector *) mReceiveFIFO->read();
-
-  if (!rxBurst) return NULL;
+  bool needEqualizer = (mMaxExpectedDelay > 1);
 
   LOG(DEBUG) << "receiveFIFO: read radio vector at time: " << rxBurst->getTime() << ", new size: " << mReceiveFIFO->size();
 
@@ -162,8 +192,8 @@ SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
   DriveLoop::CorrType corrType = mDriveLoop->expectedCorrType(mChannel, rxBurst->getTime());
 
   if ((corrType == DriveLoop::OFF) || (corrType == DriveLoop::IDLE)) {
-    delete rxBurst;
-    return NULL;
+    rxBurst->release();
+    return false;
   }
  
   // check to see if received burst has sufficient 
@@ -172,18 +202,11 @@ SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
   float TOA = 0.0;
   float avgPwr = 0.0;
 
-  if (!energyDetect(*vectorBurst,20*mSamplesPerSymbol,mEnergyThreshold,&avgPwr)) {
+  if (!energyDetect(*vectorBurst,RX_ENERGY_WINDOW*mSamplesPerSymbol,mEnergyThreshold,&avgPwr)) {
      LOG(DEBUG) << "Estimated Energy: " << sqrt(avgPwr) << ", at time " << rxBurst->getTime();
-     double framesElapsed = rxBurst->getTime()-prevFalseDetectionTime;
-     if (framesElapsed > 50) {  // if we haven't had any false detections for a while, lower threshold
-	mEnergyThreshold -= 10.0/10.0;
-        if (mEnergyThreshold < 0.0)
-          mEnergyThreshold = 0.0;
-
-        prevFalseDetectionTime = rxBurst->getTime();
-     }
-     delete rxBurst;
-     return NULL;
+     updateNoiseThreshold(rxBurst->getTime());
+     rxBurst->release();
+     return false;
   }
   LOG(DEBUG) << "Estimated Energy: " << sqrt(avgPwr) << ", at time " << rxBurst->getTime();
 
@@ -192,20 +215,15 @@ SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
   if (corrType == DriveLoop::TSC) {
     LOG(DEBUG) << "looking for TSC at time: " << rxBurst->getTime();
 
-    signalVector *channelResp;
+    // an estimate that has not been updated for a while is stale
     double framesElapsed = rxBurst->getTime()-channelEstimateTime[timeslot];
-    bool estimateChannel = false;
-    if ((framesElapsed > 50) || (channelResponse[timeslot]==NULL)) {
-	if (channelResponse[timeslot]) delete channelResponse[timeslot];
-        if (DFEForward[timeslot]) delete DFEForward[timeslot];
-        if (DFEFeedback[timeslot]) delete DFEFeedback[timeslot];
-        channelResponse[timeslot] = NULL;
-        DFEForward[timeslot] = NULL;
-        DFEFeedback[timeslot] = NULL;
-	estimateChannel = true;
-    }
-    if (!needDFE) estimateChannel = false;
+    if (channelResponse[timeslot] && (framesElapsed > CHAN_MAX_AGE))
+      resetChannel(timeslot);
+
     float chanOffset;
+    signalVector *channelResp = NULL;
+    if (needEqualizer)
+      channelResp = &mChanEstimate;
     success = analyzeTrafficBurst(*vectorBurst,
 				  mTSC,
 				  3.0,
@@ -213,23 +231,19 @@ SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
 				  &amplitude,
 				  &TOA,
 				  mMaxExpectedDelay, 
-				  estimateChannel,
-				  &channelResp,
-				  &chanOffset);
+				  channelResp,
+				  &chanOffset,
+				  mDemodWorkspace);
     if (success) {
       LOG(DEBUG) << "FOUND TSC!!!!!! " << amplitude << " " << TOA;
       mEnergyThreshold -= 1.0F/10.0F;
       if (mEnergyThreshold < 0.0) mEnergyThreshold = 0.0;
       SNRestimate[timeslot] = amplitude.norm2()/(mEnergyThreshold*mEnergyThreshold+1.0); // this is not highly accurate
-      if (estimateChannel) {
+      if (needEqualizer) {
          LOG(DEBUG) << "estimating channel...";
-         channelResponse[timeslot] = channelResp;
-       	 chanRespOffset[timeslot] = chanOffset;
          chanRespAmplitude[timeslot] = amplitude;
 	 scaleVector(*channelResp, complex(1.0,0.0)/amplitude);
-         designDFE(*channelResp, SNRestimate[timeslot], 7, &DFEForward[timeslot], &DFEFeedback[timeslot]);
-         channelEstimateTime[timeslot] = rxBurst->getTime();  
-         LOG(DEBUG) << "SNR: " << SNRestimate[timeslot] << ", DFE forward: " << *DFEForward[timeslot] << ", DFE backward: " << *DFEFeedback[timeslot];
+         updateChannel(timeslot, *channelResp, chanOffset, rxBurst->getTime());
       }
     }
     else {
@@ -237,46 +251,60 @@ SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
       LOG(DEBUG) << "wTime: " << rxBurst->getTime() << ", pTime: " << prevFalseDetectionTime << ", fElapsed: " << framesElapsed;
       mEnergyThreshold += 10.0F/10.0F*exp(-framesElapsed);
       prevFalseDetectionTime = rxBurst->getTime();
-      channelResponse[timeslot] = NULL;
     }
   }
   else {
-    // RACH burst
+    // RACH burst, hold on to it if the batch has room
+    if (mRACHBatch) {
+      PendingRACH pending;
+      pending.index = mRACHBatch->add(*vectorBurst);
+      if (pending.index >= 0) {
+        pending.burst = rxBurst;
+        mPendingRACH.push_back(pending);
+        return false;
+      }
+    }
+
     success = detectRACHBurst(*vectorBurst,
-			      5.0,  // detection threshold
+			      RACH_DETECT_THRESHOLD,
 			      mSamplesPerSymbol,
 			      &amplitude,
-			      &TOA);
-    if (success) {
+			      &TOA,
+			      mDemodWorkspace);
+    if (success)
       LOG(DEBUG) << "FOUND RACH!!!!!! " << amplitude << " " << TOA;
-      mEnergyThreshold -= (1.0F/10.0F);
-      if (mEnergyThreshold < 0.0) mEnergyThreshold = 0.0;
-      channelResponse[timeslot] = NULL; 
-    }
-    else {
-      double framesElapsed = rxBurst->getTime()-prevFalseDetectionTime;
-      mEnergyThreshold += (1.0F/10.0F)*exp(-framesElapsed);
-      prevFalseDetectionTime = rxBurst->getTime();
-    }
+    updateRACHThreshold(success, rxBurst->getTime());
   }
   LOG(DEBUG) << "energy Threshold = " << mEnergyThreshold; 
 
   // demodulate burst
-  SoftVector *burst = NULL;
   if ((rxBurst) && (success)) {
-    if ((corrType == DriveLoop::RACH) || (!needDFE)) {
-      burst = demodulateBurst(*vectorBurst,
-			      *gsmPulse,
-			      mSamplesPerSymbol,
-			      amplitude,TOA);
+    if ((corrType == DriveLoop::RACH) || (!needEqualizer)) {
+      demodulateBurst(*vectorBurst,
+		      *gsmPulse,
+		      mSamplesPerSymbol,
+		      amplitude,TOA,
+		      mRxBits,
+		      mDemodWorkspace);
+    }
+    else if (mEqualizer == EQ_MLSE) {
+      scaleVector(*vectorBurst,complex(1.0,0.0)/amplitude);
+      mlseEqualizeBurst(*vectorBurst,
+			TOA-chanRespOffset[timeslot],
+			mSamplesPerSymbol,
+			*channelResponse[timeslot],
+			mRxBits,
+			mDemodWorkspace);
     }
     else { // TSC
       scaleVector(*vectorBurst,complex(1.0,0.0)/amplitude);
-      burst = equalizeBurst(*vectorBurst,
-			    TOA-chanRespOffset[timeslot],
-			    mSamplesPerSymbol,
-			    *DFEForward[timeslot],
-			    *DFEFeedback[timeslot]);
+      equalizeBurst(*vectorBurst,
+		    TOA-chanRespOffset[timeslot],
+		    mSamplesPerSymbol,
+		    *DFEForward[timeslot],
+		    *DFEFeedback[timeslot],
+		    mRxBits,
+		    mDemodWorkspace);
     }
     wTime = rxBurst->getTime();
     RSSI = (int) floor(20.0*log10(rxFullScale/amplitude.abs()));
@@ -286,47 +314,330 @@ SoftVector *Transceiver::pullRadioVector(GSM::Time &wTime,
 
   //if (burst) LOG(DEBUG) << "burst: " << *burst << '\n';
 
-  delete rxBurst;
+  rxBurst->release();
 
-  return burst;
+  return success;
 }
 
-void Transceiver::pullFIFO()
+void Transceiver::resetChannel(int timeslot)
 {
-  SoftVector *rxBurst = NULL;
-  int RSSI;
-  int TOA;  // in 1/256 of a symbol
-  GSM::Time burstTime;
+  delete channelResponse[timeslot];
+  delete DFEForward[timeslot];
+  delete DFEFeedback[timeslot];
+  delete DFEChannel[timeslot];
+  channelResponse[timeslot] = NULL;
+  DFEForward[timeslot] = NULL;
+  DFEFeedback[timeslot] = NULL;
+  DFEChannel[timeslot] = NULL;
+}
 
-  rxBurst = pullRadioVector(burstTime,RSSI,TOA);
+/* Energy of the difference of two channels relative to the reference */
+static float channelDistance(const signalVector &a, const signalVector &ref)
+{
+  float diff = 0.0, energy = 0.0;
+
+  for (size_t i = 0; i < ref.size(); i++) {
+    diff += (a[i] - ref[i]).norm2();
+    energy += ref[i].norm2();
+  }
 
-  if (rxBurst) {
-    LOG(DEBUG) << "burst parameters: "
-               << " time: " << burstTime
-               << " RSSI: " << RSSI
-               << " TOA: "  << TOA
-               << " bits: " << *rxBurst;
+  return (energy > 0.0) ? diff/energy : 1.0;
+}
+
+/*
+ * Exponentially weighted average of the per-burst channel estimates. A new
+ * estimate restarts the average if its offset changed or it is far from
+ * the running estimate, e.g. after a handover onto the timeslot. The DFE is
+ * only redesigned once the average has drifted from the channel it was
+ * designed for, so steady traffic costs a few multiplies per burst.
+ */
+void Transceiver::updateChannel(int timeslot, const signalVector &estimate,
+                                float offset, const GSM::Time &wTime)
+{
+  signalVector *chan = channelResponse[timeslot];
+
+  bool restart = !chan || (chan->size() != estimate.size()) ||
+                 (offset != chanRespOffset[timeslot]) ||
+                 (channelDistance(estimate, *chan) > CHAN_RESET_INNOV);
+
+  if (restart) {
+    resetChannel(timeslot);
+    chan = channelResponse[timeslot] = new signalVector(estimate);
+    chanRespOffset[timeslot] = offset;
+  }
+  else {
+    for (size_t i = 0; i < chan->size(); i++)
+      (*chan)[i] += (estimate[i] - (*chan)[i]) * CHAN_AVG_WEIGHT;
+  }
+
+  channelEstimateTime[timeslot] = wTime;
+
+  if (mEqualizer != EQ_DFE) {
+    LOG(DEBUG) << "SNR: " << SNRestimate[timeslot] << ", channel: " << *chan;
+    return;
+  }
+
+  if (DFEChannel[timeslot] &&
+      (channelDistance(*chan, *DFEChannel[timeslot]) < DFE_REDESIGN_DRIFT))
+    return;
 
-    char burstString[gSlotLen+10];
-    burstString[0] = burstTime.TN();
-    for (int i = 0; i < 4; i++) {
-            burstString[1+i] = (burstTime.FN() >> ((3-i)*8)) & 0x0ff;
+  delete DFEForward[timeslot];
+  delete DFEFeedback[timeslot];
+  designDFE(*chan, SNRestimate[timeslot], 7, &DFEForward[timeslot], &DFEFeedback[timeslot]);
+  LOG(DEBUG) << "SNR: " << SNRestimate[timeslot] << ", DFE forward: " << *DFEForward[timeslot] << ", DFE backward: " << *DFEFeedback[timeslot];
+
+  if (!DFEChannel[timeslot])
+    DFEChannel[timeslot] = new signalVector(chan->size());
+  chan->copyTo(*DFEChannel[timeslot]);
+}
+
+void Transceiver::updateRACHThreshold(bool detected, const GSM::Time &wTime)
+{
+  if (detected) {
+    mEnergyThreshold -= (1.0F/10.0F);
+    if (mEnergyThreshold < 0.0) mEnergyThreshold = 0.0;
+    resetChannel(wTime.TN());
+  }
+  else {
+    double framesElapsed = wTime-prevFalseDetectionTime;
+    mEnergyThreshold += (1.0F/10.0F)*exp(-framesElapsed);
+    prevFalseDetectionTime = wTime;
+  }
+}
+
+void Transceiver::completeRACH()
+{
+  for (size_t i = 0; i < mPendingRACH.size(); i++) {
+    radioVector *rxBurst = mPendingRACH[i].burst;
+    const RACHResult &result = mRACHBatch->result(mPendingRACH[i].index);
+    GSM::Time burstTime = rxBurst->getTime();
+
+    if (result.detected)
+      LOG(DEBUG) << "FOUND RACH!!!!!! " << result.amplitude << " " << result.TOA;
+    updateRACHThreshold(result.detected, burstTime);
+
+    if (result.detected && mOn) {
+      demodulateBurst(*rxBurst,
+		      *gsmPulse,
+		      mSamplesPerSymbol,
+		      result.amplitude,result.TOA,
+		      mRxBits,
+		      mDemodWorkspace);
+      int RSSI = (int) floor(20.0*log10(rxFullScale/result.amplitude.abs()));
+      int timingOffset = (int) round(result.TOA*256.0/mSamplesPerSymbol);
+      writeBurst(burstTime, RSSI, timingOffset);
     }
 
-    burstString[5] = RSSI;
-    burstString[6] = (TOA >> 8) & 0x0ff;
-    burstString[7] = TOA & 0x0ff;
-    SoftVector::iterator burstItr = rxBurst->begin();
+    rxBurst->release();
+  }
+
+  mPendingRACH.clear();
+  flushBursts();
+}
 
-    for (unsigned int i = 0; i < gSlotLen; i++) {
-            burstString[8+i] =(char) round((*burstItr++)*255.0);
+void Transceiver::setRACHBatch(RACHBatch *batch)
+{
+  mRACHBatch = batch;
+  mPendingRACH.reserve(batch ? batch->capacity() : 0);
+}
+
+void Transceiver::writeBurst(const GSM::Time &burstTime, int RSSI, int TOA)
+{
+  LOG(DEBUG) << "burst parameters: "
+             << " time: " << burstTime
+             << " RSSI: " << RSSI
+             << " TOA: "  << TOA
+             << " bits: " << mRxBits;
+
+  if (mUplink) {
+    ScopedLock lock(mUplinkLock);
+    BurstRing *ring = mUplink;
+    if (ring) {
+      BurstRecord record;
+      record.TN = burstTime.TN();
+      record.FN = burstTime.FN();
+      record.power = RSSI;
+      record.timing = TOA;
+      for (unsigned int i = 0; i < gSlotLen; i++)
+        record.data[i] = (uint8_t) round(mRxBits[i]*255.0);
+
+      if (!ring->write(record))
+        LOG(NOTICE) << "Receive ring overflow, dropping burst at " << burstTime;
+      return;
     }
+  }
 
-    burstString[gSlotLen+9] = '\0';
-    delete rxBurst;
+  // batches are sent when full or when the receive FIFO drains
+  BurstFrame *frame = mRxFrame;
+  if (frame) {
+    frame->addSoft(burstTime.TN(), burstTime.FN(), RSSI, TOA, mRxBits.begin());
+    if (frame->full())
+      flushBursts();
+    return;
+  }
+
+  char burstString[gSlotLen+10];
+  burstString[0] = burstTime.TN();
+  for (int i = 0; i < 4; i++) {
+          burstString[1+i] = (burstTime.FN() >> ((3-i)*8)) & 0x0ff;
+  }
+
+  burstString[5] = RSSI;
+  burstString[6] = (TOA >> 8) & 0x0ff;
+  burstString[7] = TOA & 0x0ff;
+  SoftVector::iterator burstItr = mRxBits.begin();
 
-    mDataSocket.write(burstString,gSlotLen+10);
+  for (unsigned int i = 0; i < gSlotLen; i++) {
+          burstString[8+i] =(char) round((*burstItr++)*255.0);
   }
+
+  burstString[gSlotLen+9] = '\0';
+
+  mDataSocket.write(burstString,gSlotLen+10);
+}
+
+void Transceiver::flushBursts()
+{
+  BurstFrame *frame = mRxFrame;
+
+  if (!frame || frame->empty())
+    return;
+
+  mDataSocket.write(frame->data(), frame->size());
+  frame->clear();
+}
+
+bool Transceiver::openBurstLink(const char *name)
+{
+  ScopedLock uplinkLock(mUplinkLock);
+  ScopedLock downlinkLock(mDownlinkLock);
+
+  // a restarted GSM core offers a new segment, drop the old one first
+  closeBurstLink();
+  if (!mBurstLink.open(name))
+    return false;
+
+  mUplink = mBurstLink.uplink();
+  mDownlink = mBurstLink.downlink();
+
+  // wake the transmit queue thread from its blocking read on the data socket
+  struct sockaddr_in addr;
+  if (resolveAddress(&addr, "127.0.0.1", mDataSocket.port()))
+    mControlSocket.send((struct sockaddr *) &addr, "", 1);
+
+  return true;
+}
+
+void Transceiver::powerOn()
+{
+  if (!mPrimary || mOn)
+    return;
+
+  // Prepare for thread start
+  mPower = -20;
+  mRadioInterface->start();
+  mDriveLoop->start();
+
+  mDriveLoop->writeClockInterface();
+  generateRACHSequence(*gsmPulse,mSamplesPerSymbol);
+
+  // Start radio interface threads.
+  mOn = true;
+  mTransmitPriorityQueueServiceLoopThread = new Thread(32768);
+  mTransmitPriorityQueueServiceLoopThread->start((void * (*)(void*))TransmitPriorityQueueServiceLoopAdapter,(void*) this);
+}
+
+void Transceiver::powerOff()
+{
+  if (!mPrimary || !mOn)
+    return;
+
+  mOn = false;
+
+  // wake the transmit queue thread from its blocking read on the data socket
+  struct sockaddr_in addr;
+  if (resolveAddress(&addr, "127.0.0.1", mDataSocket.port()))
+    mControlSocket.send((struct sockaddr *) &addr, "", 1);
+
+  mTransmitPriorityQueueServiceLoopThread->join();
+  delete mTransmitPriorityQueueServiceLoopThread;
+  mTransmitPriorityQueueServiceLoopThread = NULL;
+}
+
+void Transceiver::closeBurstLink()
+{
+  ScopedLock uplinkLock(mUplinkLock);
+  ScopedLock downlinkLock(mDownlinkLock);
+
+  mUplink = NULL;
+  mDownlink = NULL;
+  mBurstLink.close();
+}
+
+void Transceiver::updateNoiseThreshold(const GSM::Time &wTime)
+{
+  double framesElapsed = wTime-prevFalseDetectionTime;
+  if (framesElapsed > 50) {  // if we haven't had any false detections for a while, lower threshold
+    mEnergyThreshold -= 10.0/10.0;
+    if (mEnergyThreshold < 0.0)
+      mEnergyThreshold = 0.0;
+
+    prevFalseDetectionTime = wTime;
+  }
+}
+
+/*
+ * Silent bursts are dropped by the radio before they reach the FIFO. The
+ * most recent one still lowers the threshold as if it had been detected
+ * here, so the noise floor keeps being tracked on an idle channel.
+ */
+void Transceiver::updateEnergyGate()
+{
+  unsigned gated = mRadioInterface->lastGated(mChannel);
+
+  if (gated != mLastGated) {
+    mLastGated = gated;
+    updateNoiseThreshold(GSM::Time(gated / 8, gated % 8));
+  }
+
+  mRadioInterface->setEnergyGate(mChannel, mEnergyThreshold * mEnergyThreshold);
+}
+
+bool Transceiver::pullFIFO(unsigned timeout)
+{
+  int RSSI;
+  int TOA;  // in 1/256 of a symbol
+  GSM::Time burstTime;
+
+  radioVector *radioBurst;
+  if (timeout)
+    radioBurst = mReceiveFIFO->read(timeout);
+  else
+    radioBurst = mReceiveFIFO->readNoBlock();
+
+  // the FIFO drained, catch up with the radio's energy gate
+  if (!radioBurst) {
+    flushBursts();
+    updateEnergyGate();
+    return false;
+  }
+
+  // Keep draining while powered off so the FIFO does not overflow
+  if (!mOn) {
+    radioBurst->release();
+    return true;
+  }
+
+  mFIFOStats.add(mReceiveFIFO->size());
+
+  uint64_t start = latencyTicks();
+  bool detected = pullRadioVector(radioBurst,burstTime,RSSI,TOA);
+  mDemodStats.addSince(start);
+
+  if (detected)
+    writeBurst(burstTime, RSSI, TOA);
+
+  return true;
 }
 
 void Transceiver::start()
@@ -337,9 +648,6 @@ void Transceiver::start()
 
   if (!mPrimary) {
     mOn = true;
-    mFIFOServiceLoopThread = new Thread(32768);
-    mFIFOServiceLoopThread->start((void * (*)(void*))FIFOServiceLoopAdapter,(void*) this);
- 
     mTransmitPriorityQueueServiceLoopThread = new Thread(32768);
     mTransmitPriorityQueueServiceLoopThread->start((void * (*)(void*))TransmitPriorityQueueServiceLoopAdapter,(void*) this);
   }
@@ -357,10 +665,43 @@ void Transceiver::reset()
 }
 
   
+/* Append one histogram to a partially filled response */
+static void appendStats(char *buf, size_t len, const char *name,
+                        const LatencyHistogram &hist, double scale)
+{
+  size_t used = strlen(buf);
+
+  if (used < len)
+    hist.format(buf + used, len - used, name, scale);
+}
+
+void Transceiver::formatStats(char *buf, size_t len)
+{
+  double usec = latencyTickNs() * 1.0e-3;
+
+  snprintf(buf, len, "RSP STATS 0");
+
+  // shared radio threads, probe ticks in microseconds
+  appendStats(buf, len, "chan", mRadioInterface->channelizerStats(), usec);
+  appendStats(buf, len, "synth", mRadioInterface->synthesisStats(), usec);
+
+  // transmit lag in timeslots and late bursts
+  appendStats(buf, len, "txlag", mDriveLoop->deadlineStats(), 1.0);
+  size_t used = strlen(buf);
+  if (used < len)
+    snprintf(buf + used, len - used, " late %u", mDriveLoop->deadlineMisses());
+
+  // this transceiver, receive FIFO depth in bursts
+  appendStats(buf, len, "demod", mDemodStats, usec);
+  appendStats(buf, len, "mod", mModStats, usec);
+  appendStats(buf, len, "rxfifo", mFIFOStats, 1.0);
+}
+
 void Transceiver::driveControl()
 {
 
   int MAX_PACKET_LENGTH = 100;
+  int MAX_RESPONSE_LENGTH = 512;
 
   // check control socket
   char buffer[MAX_PACKET_LENGTH];
@@ -384,7 +725,7 @@ void Transceiver::driveControl()
 
   char cmdcheck[4];
   char command[MAX_PACKET_LENGTH];
-  char response[MAX_PACKET_LENGTH];
+  char response[MAX_RESPONSE_LENGTH];
 
   sscanf(buffer,"%3s %s",cmdcheck,command);
 
@@ -397,7 +738,10 @@ void Transceiver::driveControl()
   LOG(INFO) << "command is " << buffer;
 
   if (strcmp(command,"POWEROFF")==0) {
-    // turn off transmitter/demod
+    // turn off transmitter/demod, the GSM core offers shared memory again if it wants it
+    closeBurstLink();
+    for (size_t i = 0; i < mSecondaries.size(); i++)
+      mSecondaries[i]->powerOff();
     sprintf(response,"RSP POWEROFF 0"); 
   }
   else if (strcmp(command,"POWERON")==0) {
@@ -406,23 +750,10 @@ void Transceiver::driveControl()
       sprintf(response,"RSP POWERON 1");
     else {
       sprintf(response,"RSP POWERON 0");
-      if (mPrimary && !mOn) {
-        // Prepare for thread start
-        mPower = -20;
-        mRadioInterface->start();
-        mDriveLoop->start();
-
-        mDriveLoop->writeClockInterface();
-        generateRACHSequence(*gsmPulse,mSamplesPerSymbol);
-
-        // Start radio interface threads.
-        mOn = true;
-        mFIFOServiceLoopThread = new Thread(32768);
-        mFIFOServiceLoopThread->start((void * (*)(void*))FIFOServiceLoopAdapter,(void*) this);
-
-        mTransmitPriorityQueueServiceLoopThread = new Thread(32768);
-        mTransmitPriorityQueueServiceLoopThread->start((void * (*)(void*))TransmitPriorityQueueServiceLoopAdapter,(void*) this);
-      }
+      // the other devices follow the C0 clock, start them after it
+      powerOn();
+      for (size_t i = 0; i < mSecondaries.size(); i++)
+        mSecondaries[i]->powerOn();
     }
   }
   else if (strcmp(command,"SETMAXDLY")==0) {
@@ -436,6 +767,8 @@ void Transceiver::driveControl()
     //set expected maximum time-of-arrival
     int newGain;
     sscanf(buffer,"%3s %s %d",cmdcheck,command,&newGain);
+    for (size_t i = 0; i < mSecondaries.size(); i++)
+      mSecondaries[i]->mRadioInterface->setRxGain(newGain);
     if (mPrimary)
       newGain = mRadioInterface->setRxGain(newGain);
     sprintf(response,"RSP SETRXGAIN 0 %d",newGain);
@@ -459,6 +792,10 @@ void Transceiver::driveControl()
       mPower = dbPwr;
       if (mPrimary)
         mRadioInterface->setPowerAttenuation(dbPwr);
+      for (size_t i = 0; i < mSecondaries.size(); i++) {
+        mSecondaries[i]->mPower = dbPwr;
+        mSecondaries[i]->mRadioInterface->setPowerAttenuation(dbPwr);
+      }
       sprintf(response,"RSP SETPOWER 0 %d",dbPwr);
     }
   }
@@ -510,6 +847,38 @@ void Transceiver::driveControl()
       sprintf(response,"RSP SETTSC 0 %d",TSC);
     }
   }
+  else if (strcmp(command,"CACHESTATS")==0) {
+    // report modulated burst cache hits, misses, and entries in use
+    sprintf(response,"RSP CACHESTATS 0 %u %u %d",
+            mBurstCache.hits(),mBurstCache.misses(),mBurstCache.size());
+  }
+  else if (strcmp(command,"STATS")==0) {
+    // report probe histograms as sample count, median, 99th percentile and maximum
+    formatStats(response,MAX_RESPONSE_LENGTH);
+  }
+  else if (strcmp(command,"SETSHM")==0) {
+    // carry bursts on the shared memory rings of the GSM core instead of the data socket
+    char name[MAX_PACKET_LENGTH];
+    sscanf(buffer,"%3s %s %s",cmdcheck,command,name);
+    if (openBurstLink(name)) {
+      LOG(NOTICE) << "Bursts on shared memory " << name;
+      sprintf(response,"RSP SETSHM 0");
+    }
+    else
+      sprintf(response,"RSP SETSHM 1");
+  }
+  else if (strcmp(command,"SETFORMAT")==0) {
+    // batch demodulated bursts into framed datagrams, framed transmit bursts are always accepted
+    int version, batch;
+    sscanf(buffer,"%3s %s %d %d",cmdcheck,command,&version,&batch);
+    if ((version != BURST_FRAME_VERSION) || (batch < 1) ||
+        (batch > BURST_FRAME_MAX) || mRxFrame)
+      sprintf(response,"RSP SETFORMAT 1 %d",version);
+    else {
+      mRxFrame = new BurstFrame(BurstFrame::SoftInt8, batch);
+      sprintf(response,"RSP SETFORMAT 0 %d",version);
+    }
+  }
   else if (strcmp(command,"SETSLOT")==0) {
     // set TSC 
     int  corrCode;
@@ -535,31 +904,60 @@ void Transceiver::driveControl()
 
 bool Transceiver::driveTransmitPriorityQueue() 
 {
-  char buffer[gSlotLen+50];
+  char buffer[MAX_UDP_LENGTH];
+  BurstRecord records[BURST_FRAME_MAX];
+  int count = 1;
+  static BitVector newBurst(gSlotLen);
 
   if (!mOn)
     return true;
 
-  try { 
-    size_t msgLen = mDataSocket.read(buffer);
-    if (msgLen!=gSlotLen+1+4+1) {
+  if (mDownlink) {
+    // time out to notice shutdown or a replaced link
+    ScopedLock lock(mDownlinkLock);
+    BurstRing *ring = mDownlink;
+    if (!ring || !ring->read(records[0], 100))
+      return true;
+  }
+  else {
+    size_t msgLen;
+
+    try { 
+      msgLen = mDataSocket.read(buffer);
+
+      // switched off or to shared memory while blocked on the socket
+      if (!mOn || mDownlink)
+        return true;
+    } catch (...) {
+      if (!mOn) {
+        /* Shutdown condition. End the thread. */
+        return true;
+      }
+
+      LOG(ALERT) << "Caught UHD socket exception";
+      return false;
+    }
+
+    if (BurstFrame::isFrame(buffer, msgLen)) {
+      count = BurstFrame::parse(buffer, msgLen, records);
+      if (count < 0) {
+        LOG(ERR) << "badly formatted frame on GSM->TRX interface";
+        return false;
+      }
+    }
+    else if (msgLen!=gSlotLen+1+4+1) {
       LOG(ERR) << "badly formatted packet on GSM->TRX interface";
       return false;
     }
-  } catch (...) {
-    if (!mOn) {
-      /* Shutdown condition. End the thread. */
-      return true;
+    else {
+      records[0].TN = buffer[0];
+      records[0].FN = 0;
+      for (int i = 0; i < 4; i++)
+        records[0].FN = (records[0].FN << 8) | (0x0ff & buffer[i+1]);
+      records[0].power = buffer[5];
+      memcpy(records[0].data, buffer+6, gSlotLen);
     }
-
-    LOG(ALERT) << "Caught UHD socket exception";
-    return false;
   }
-
-  int timeSlot = (int) buffer[0];
-  uint64_t frameNum = 0;
-  for (int i = 0; i < 4; i++)
-    frameNum = (frameNum << 8) | (0x0ff & buffer[i+1]);
   
   // periodically update GSM core clock
   LOG(DEBUG) << "mTransmitDeadlineClock " << mDriveLoop->getDeadlineClock()
@@ -568,33 +966,22 @@ bool Transceiver::driveTransmitPriorityQueue()
     mDriveLoop->writeClockInterface();
   }
 
-  LOG(DEBUG) << "rcvd. burst at: " << GSM::Time(frameNum,timeSlot);
-  
-  int RSSI = (int) buffer[5];
-  static BitVector newBurst(gSlotLen);
-  BitVector::iterator itr = newBurst.begin();
-  char *bufferItr = buffer+6;
-  while (itr < newBurst.end()) 
-    *itr++ = *bufferItr++;
-  
-  GSM::Time currTime = GSM::Time(frameNum,timeSlot);
-  
-  addRadioVector(newBurst,RSSI,currTime);
-  
-  LOG(DEBUG) "added burst - time: " << currTime << ", RSSI: " << RSSI; // << ", data: " << newBurst; 
+  for (int n = 0; n < count; n++) {
+    GSM::Time currTime = GSM::Time(records[n].FN,records[n].TN);
+    int RSSI = records[n].power;
 
-  return true;
+    LOG(DEBUG) << "rcvd. burst at: " << currTime;
 
+    BitVector::iterator itr = newBurst.begin();
+    for (unsigned i = 0; i < gSlotLen; i++)
+      *itr++ = records[n].data[i];
 
-}
+    addRadioVector(newBurst,RSSI,currTime);
 
-void *FIFOServiceLoopAdapter(Transceiver *transceiver)
-{
-  while (transceiver->on()) {
-    transceiver->pullFIFO();
-    pthread_testcancel();
+    LOG(DEBUG) "added burst - time: " << currTime << ", RSSI: " << RSSI; // << ", data: " << newBurst; 
   }
-  return NULL;
+
+  return true;
 }
 
 void *ControlServiceLoopAdapter(Transceiver *transceiver)
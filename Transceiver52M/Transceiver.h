@@ -30,30 +30,50 @@
 */
 
 #include "DriveLoop.h"
+#include "BurstCache.h"
 #include "radioInterface.h"
 #include "Interthread.h"
 #include "GSMCommon.h"
 #include "Sockets.h"
+#include "BurstRing.h"
+#include "BurstFrame.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <vector>
+
+/** Post-correlator peak-to-mean threshold of RACH detection */
+#define RACH_DETECT_THRESHOLD		5.0
 
 /** Define this to be the slot number to be logged. */
 //#define TRANSMIT_LOGGING 1
 
 /** The Transceiver class, responsible for physical layer of basestation */
 class Transceiver {
-  
+
+public:
+  /** Receive equalizer used when a delay spread is expected */
+  enum EqualizerType {
+    EQ_DFE,                            ///< decision feedback equalizer
+    EQ_MLSE                            ///< maximum likelihood sequence estimator
+  };
+
 private:
   DriveLoop *mDriveLoop;
 
   UDPSocket mDataSocket;	  ///< socket for writing to/reading from GSM core
   UDPSocket mControlSocket;	  ///< socket for writing/reading control commands from GSM core
 
+  BurstLink mBurstLink;                   ///< shared memory burst transport offered by the GSM core
+  BurstRing *volatile mUplink;            ///< ring of demodulated bursts to the GSM core, NULL on UDP
+  BurstRing *volatile mDownlink;          ///< ring of transmit bursts from the GSM core, NULL on UDP
+  Mutex mUplinkLock;                      ///< held while writing mUplink or replacing the link
+  Mutex mDownlinkLock;                    ///< held while reading mDownlink or replacing the link
+  BurstFrame *volatile mRxFrame;          ///< batch of demodulated bursts for the data socket, NULL for single bursts
+
   VectorQueue  *mTransmitPriorityQueue;   ///< priority queue of transmit bursts received from GSM core
   VectorFIFO*  mReceiveFIFO;      ///< radioInterface FIFO of receive bursts 
 
-  Thread *mFIFOServiceLoopThread;  ///< thread to push/pull bursts into transmit/receive FIFO
   Thread *mControlServiceLoopThread;       ///< thread to process control messages from GSM core
   Thread *mTransmitPriorityQueueServiceLoopThread;///< thread to process transmit bursts from GSM core
 
@@ -76,17 +96,90 @@ private:
   /** Push modulated burst into transmit FIFO corresponding to a particular timestamp */
   void pushRadioVector(GSM::Time &nowTime);
 
-  /** Pull and demodulate a burst from the receive FIFO */ 
-  SoftVector *pullRadioVector(GSM::Time &wTime,
-			   int &RSSI,
-			   int &timingOffset);
+  /** Demodulate a burst pulled from the receive FIFO into mRxBits, takes ownership of the burst
+      @return true if a burst was demodulated
+  */
+  bool pullRadioVector(radioVector *rxBurst,
+		       GSM::Time &wTime,
+		       int &RSSI,
+		       int &timingOffset);
    
   /** send messages over the clock socket */
   void writeClockInterface(void);
 
-  void pullFIFO(void);                 ///< blocking call on receive FIFO 
+  /**
+    Pull and demodulate one burst from the receive FIFO
+    @param timeout block for up to timeout ms, zero to poll
+    @return true if a burst was read
+  */
+  bool pullFIFO(unsigned timeout = 0);
+
+  /** Lower the energy threshold if no burst has exceeded it for a while */
+  void updateNoiseThreshold(const GSM::Time &wTime);
+
+  /** Track bursts gated by the radio and pass it the current energy threshold */
+  void updateEnergyGate();
+
+  /** Write the demodulated bits in mRxBits to the GSM core */
+  void writeBurst(const GSM::Time &wTime, int RSSI, int timingOffset);
+
+  /** Send any batched bursts to the GSM core */
+  void flushBursts();
+
+  /** Discard the channel estimate and equalizer of a timeslot */
+  void resetChannel(int timeslot);
+
+  /**
+    Track the channel of a timeslot with a new estimate from a detected burst
+    @param timeslot timeslot of the burst
+    @param estimate channel estimate normalized to the burst amplitude
+    @param offset channel response offset of the estimate
+    @param wTime time of the burst
+  */
+  void updateChannel(int timeslot, const signalVector &estimate,
+                     float offset, const GSM::Time &wTime);
+
+  /** Adjust the energy threshold after a RACH detection attempt */
+  void updateRACHThreshold(bool detected, const GSM::Time &wTime);
+
+  /** Finish and release all bursts deferred to the RACH batch after detection */
+  void completeRACH();
+
+  /** Move bursts to the shared memory segment of the GSM core, replacing any earlier one
+      @return true if the segment was mapped, otherwise bursts are on the data socket
+  */
+  bool openBurstLink(const char *name);
+
+  /** Unmap the shared memory segment and move bursts back to the data socket */
+  void closeBurstLink();
+
+  /** Format the STATS control response from the radio and transceiver probes */
+  void formatStats(char *buf, size_t len);
+
+  /** Start the radio, its drive loop and the transmit queue thread of a primary transceiver */
+  void powerOn();
+
+  /** Stop the transmit queue thread of a primary transceiver, the radio keeps running */
+  void powerOff();
+
+  /** RACH burst waiting on a batched detection */
+  struct PendingRACH {
+    radioVector *burst;
+    int index;
+  };
 
   signalVector *gsmPulse;              ///< the GSM shaping pulse for modulation
+  BurstCache mBurstCache;              ///< recently modulated transmit bursts
+  DemodWorkspace mDemodWorkspace;      ///< receive demodulation scratch buffers
+  SoftVector mRxBits;                  ///< soft bits of the last demodulated burst
+  signalVector mChanEstimate;          ///< channel estimate of the last detected burst
+  RACHBatch *mRACHBatch;               ///< shared batched RACH detector, or NULL to detect in place
+  std::vector<PendingRACH> mPendingRACH; ///< bursts queued on the RACH batch
+  std::vector<Transceiver *> mSecondaries; ///< primary transceivers of the other devices, controlled through C0
+
+  LatencyHistogram mDemodStats;        ///< pullRadioVector ticks, receive worker thread
+  LatencyHistogram mModStats;          ///< modulator ticks on burst cache misses, transmit queue thread
+  LatencyHistogram mFIFOStats;         ///< receive FIFO depth after each read, receive worker thread
 
   int mSamplesPerSymbol;               ///< number of samples per GSM symbol
 
@@ -99,13 +192,16 @@ private:
   int mPower;                          ///< the transmit power in dB
   double mEnergyThreshold;             ///< threshold to determine if received data is potentially a GSM burst
   GSM::Time prevFalseDetectionTime;    ///< last timestamp of a false energy detection
+  unsigned mLastGated;                 ///< last gated burst time seen from the radio
   unsigned mMaxExpectedDelay;            ///< maximum expected time-of-arrival offset in GSM symbols
+  EqualizerType mEqualizer;            ///< equalizer for expected delay spreads
 
   GSM::Time    channelEstimateTime[8]; ///< last timestamp of each timeslot's channel estimate
   signalVector *channelResponse[8];    ///< most recent channel estimate of all timeslots
   float        SNRestimate[8];         ///< most recent SNR estimate of all timeslots
   signalVector *DFEForward[8];         ///< most recent DFE feedforward filter of all timeslots
   signalVector *DFEFeedback[8];        ///< most recent DFE feedback filter of all timeslots
+  signalVector *DFEChannel[8];         ///< channel estimate that each timeslot's DFE was designed for
   float        chanRespOffset[8];      ///< most recent timing offset, e.g. TOA, of all timeslots
   complex      chanRespAmplitude[8];   ///< most recent channel amplitude of all timeslots
 
@@ -135,6 +231,16 @@ public:
   /** shutdown (teardown threads) the Transceiver */
   void shutdown();
 
+  /** select the receive equalizer, must be set before the transceiver starts */
+  void setEqualizer(EqualizerType type) { mEqualizer = type; }
+
+  /**
+    attach the primary transceiver of another device to this C0 transceiver.
+    The GSM core only powers and sets up C0, so POWERON, POWEROFF, SETRXGAIN
+    and SETPOWER are applied to the other devices from here, after C0.
+  */
+  void addSecondary(Transceiver *wTrx) { mSecondaries.push_back(wTrx); }
+
 protected:
 
   /** drive reception and demodulation of GSM bursts */ 
@@ -152,7 +258,7 @@ protected:
   */
   bool driveTransmitPriorityQueue();
 
-  friend void *FIFOServiceLoopAdapter(Transceiver *);
+  friend class WorkerPool;
 
   friend void *ControlServiceLoopAdapter(Transceiver *);
 
@@ -169,13 +275,13 @@ protected:
   /** return the drive loop pointer */
   DriveLoop *getDriveLoop() { return mDriveLoop; }
   
+  /** Defer RACH detection to a batch shared with the worker's other transceivers */
+  void setRACHBatch(RACHBatch *batch);
+
   /** set priority on current thread */
   void setPriority() { mRadioInterface->setPriority(); }
 };
 
-/** FIFO thread loop */
-void *FIFOServiceLoopAdapter(Transceiver *);
-
 /** control message handler thread loop */
 void *ControlServiceLoopAdapter(Transceiver *);
 
@@ -134,7 +134,8 @@ private:
 */
 class uhd_device : public RadioDevice {
 public:
-	uhd_device(double rate, double offset, double ampl, bool skip_rx);
+	uhd_device(double rate, double offset, double ampl, bool skip_rx,
+		   const std::string &args);
 	~uhd_device();
 
 	bool open();
@@ -150,13 +151,16 @@ public:
 	int writeSamples(float *buf, int len, bool *underrun, 
 			 TIMESTAMP timestamp, bool isControl);
 
+	int writeSamples(short *buf, int len, bool *underrun, 
+			 TIMESTAMP timestamp, bool isControl);
+
 	bool updateAlignment(TIMESTAMP timestamp);
 
 	bool setTxFreq(double wFreq);
 	bool setRxFreq(double wFreq);
 
-	inline TIMESTAMP initialWriteTimestamp() { return 0; }
-	inline TIMESTAMP initialReadTimestamp() { return 0; }
+	inline TIMESTAMP initialWriteTimestamp() { return start_ts; }
+	inline TIMESTAMP initialReadTimestamp() { return start_ts; }
 
 	inline double fullScaleInputValue() { return 1.0f * tx_ampl; }
 	inline double fullScaleOutputValue() { return 9450.0f; }
@@ -183,6 +187,18 @@ public:
 	bool recv_async_msg();
 	bool running() { return started; }
 
+	/** Wait for the next PPS edge
+	    @return false if no edge arrives within the timeout in seconds
+	*/
+	bool wait_pps(double timeout);
+
+	/** Zero the device time on the next PPS edge and keep it, starting
+	    the stream on a multiple of period seconds instead
+	*/
+	void set_time_next_pps(double period);
+
+	void set_ref_clk(bool ext_clk);
+
 	enum err_code {
 		ERROR_TIMING = -1,
 		ERROR_UNRECOVERABLE = -2,
@@ -205,6 +221,7 @@ private:
 	bool started;
 	bool aligned;
 	bool skip_rx;
+	std::string dev_args;
 
 	double rx_offset; 
 	size_t rx_pkt_cnt;
@@ -214,12 +231,16 @@ private:
 	TIMESTAMP ts_offset;
 	smpl_buf *rx_smpl_buf;
 
+	double start_period;
+	TIMESTAMP start_ts;
+
 	void init_gains();
-	void set_ref_clk(bool ext_clk);
 	double set_rates(double rate);
 	bool parse_dev_type();
 	bool flush_recv(size_t num_pkts);
 	int check_rx_md_err(uhd::rx_metadata_t &md, ssize_t num_smpls);
+	int send(void *buf, int len, bool *underrun, TIMESTAMP timestamp,
+		 bool isControl, const uhd::io_type_t &io_type);
 
 	std::string str_code(uhd::rx_metadata_t metadata);
 	std::string str_code(uhd::async_metadata_t metadata);
@@ -257,16 +278,18 @@ void uhd_msg_handler(uhd::msg::type_t type, const std::string &msg)
 	}
 }
 
-uhd_device::uhd_device(double rate, double offset, double ampl, bool skip_rx)
+uhd_device::uhd_device(double rate, double offset, double ampl, bool skip_rx,
+		       const std::string &args)
 	: desired_smpl_rt(rate), actual_smpl_rt(0), tx_ampl(ampl),
 	  tx_gain(0.0), tx_gain_min(0.0), tx_gain_max(0.0),
 	  rx_gain(0.0), rx_gain_min(0.0), rx_gain_max(0.0),
 	  tx_freq(0.0), rx_freq(0.0), tx_spp(0), rx_spp(0),
 	  started(false), aligned(false), rx_offset(offset), rx_pkt_cnt(0),
 	  drop_cnt(0), prev_ts(0,0), ts_offset(0), rx_smpl_buf(NULL),
-	  async_event_thrd(NULL)
+	  start_period(0.0), start_ts(0), async_event_thrd(NULL)
 {
 	this->skip_rx = skip_rx;
+	this->dev_args = args;
 }
 
 uhd_device::~uhd_device()
@@ -418,11 +441,11 @@ bool uhd_device::open()
 	// Register msg handler
 	uhd::msg::register_handler(&uhd_msg_handler);
 
-	// Find UHD devices
-	uhd::device_addr_t args("");
+	// Find UHD devices, optionally narrowed down by the device arguments
+	uhd::device_addr_t args(dev_args);
 	uhd::device_addrs_t dev_addrs = uhd::device::find(args);
 	if (dev_addrs.size() == 0) {
-		LOG(ALERT) << "No UHD devices found";
+		LOG(ALERT) << "No UHD devices found with arguments \"" << dev_args << "\"";
 		return false;
 	}
 
@@ -507,14 +530,45 @@ void uhd_device::restart(uhd::time_spec_t ts)
 
 	flush_recv(50);
 
-	usrp_dev->set_time_now(ts);
 	aligned = false;
-
 	cmd = uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS;
-	cmd.stream_now = true;
+
+	// Time set on a PPS edge is shared with other devices, so keep it and
+	// start on a period boundary at least one period away
+	if (start_period > 0.0) {
+		TIMESTAMP period = (TIMESTAMP) (start_period * actual_smpl_rt + 0.5);
+		TIMESTAMP now = convert_time(usrp_dev->get_time_now(),
+					     actual_smpl_rt);
+		start_ts = (now / period + 2) * period;
+		cmd.stream_now = false;
+		cmd.time_spec = convert_time(start_ts, actual_smpl_rt);
+	} else {
+		usrp_dev->set_time_now(ts);
+		cmd.stream_now = true;
+	}
+
 	usrp_dev->issue_stream_cmd(cmd);
 }
 
+bool uhd_device::wait_pps(double timeout)
+{
+	uhd::time_spec_t last = usrp_dev->get_time_last_pps();
+
+	for (double waited = 0.0; waited < timeout; waited += 0.01) {
+		usleep(10000);
+		if (usrp_dev->get_time_last_pps() != last)
+			return true;
+	}
+
+	return false;
+}
+
+void uhd_device::set_time_next_pps(double period)
+{
+	usrp_dev->set_time_next_pps(uhd::time_spec_t(0.0));
+	start_period = period;
+}
+
 bool uhd_device::start()
 {
 	LOG(INFO) << "Starting USRP...";
@@ -684,6 +738,21 @@ int uhd_device::readSamples(float *buf, int len, bool *overrun,
 
 int uhd_device::writeSamples(float *buf, int len, bool *underrun,
 			unsigned long long timestamp,bool isControl)
+{
+	return send(buf, len, underrun, timestamp, isControl,
+		    uhd::io_type_t::COMPLEX_FLOAT32);
+}
+
+int uhd_device::writeSamples(short *buf, int len, bool *underrun,
+			unsigned long long timestamp,bool isControl)
+{
+	return send(buf, len, underrun, timestamp, isControl,
+		    uhd::io_type_t::COMPLEX_INT16);
+}
+
+int uhd_device::send(void *buf, int len, bool *underrun,
+		     unsigned long long timestamp, bool isControl,
+		     const uhd::io_type_t &io_type)
 {
 	uhd::tx_metadata_t metadata;
 	metadata.has_time_spec = true;
@@ -719,7 +788,7 @@ int uhd_device::writeSamples(float *buf, int len, bool *underrun,
 	size_t num_smpls = usrp_dev->get_device()->send(buf,
 					len,
 					metadata,
-					uhd::io_type_t::COMPLEX_FLOAT32,
+					io_type,
 					uhd::device::SEND_MODE_FULL_BUFF);
 
 	if (num_smpls != (unsigned) len) {
@@ -985,7 +1054,33 @@ std::string smpl_buf::str_code(ssize_t code)
 }
 
 RadioDevice *RadioDevice::make(double smpl_rt, double offset,
-			       double ampl, bool skip_rx)
+			       double ampl, bool skip_rx,
+			       const std::string &args)
+{
+	return new uhd_device(smpl_rt, offset, ampl, skip_rx, args);
+}
+
+bool RadioDevice::alignTimes(RadioDevice **devs, int num, double period)
 {
-	return new uhd_device(smpl_rt, offset, ampl, skip_rx);
+	int i;
+	uhd_device *first = (uhd_device *) devs[0];
+
+	for (i = 0; i < num; i++)
+		((uhd_device *) devs[i])->set_ref_clk(true);
+
+	// Set every device just after one edge, so they all take the next
+	if (!first->wait_pps(2.0)) {
+		LOG(ALERT) << "UHD: No PPS edge on the first device";
+		return false;
+	}
+
+	for (i = 0; i < num; i++)
+		((uhd_device *) devs[i])->set_time_next_pps(period);
+
+	if (!first->wait_pps(2.0)) {
+		LOG(ALERT) << "UHD: Lost PPS while setting device times";
+		return false;
+	}
+
+	return true;
 }
@@ -560,3 +560,9 @@ RadioDevice *RadioDevice::make(double desiredSampleRate, bool skipRx)
 {
 	return new USRPDevice(desiredSampleRate, skipRx);
 }
+
+bool RadioDevice::alignTimes(RadioDevice **devs, int num, double period)
+{
+	// no PPS input
+	return false;
+}
@@ -0,0 +1,250 @@
+/*
+ * Per-channel receive worker pool
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <Logger.h>
+
+#include "WorkerPool.h"
+#include "Transceiver.h"
+
+/* Doorbell timeout in milliseconds, bounds shutdown latency */
+#define DOORBELL_TIMEOUT		10
+
+/* RACH batch length in bursts per attached transceiver, one frame */
+#define RACH_BATCH_LEN			8
+
+bool setThreadAffinity(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return true;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+		LOG(ERR) << "Failed to set thread affinity to CPU " << cpu;
+		return false;
+	}
+
+	return true;
+}
+
+WorkerPool::WorkerPool(int wNumWorkers)
+	: mOn(false), mDoorbellSeq(0)
+{
+	int i;
+
+	if (wNumWorkers < 1)
+		wNumWorkers = 1;
+
+	mNumWorkers = wNumWorkers;
+	mWorkers = new Worker[mNumWorkers];
+
+	for (i = 0; i < mNumWorkers; i++) {
+		mWorkers[i].pool = this;
+		mWorkers[i].thread = NULL;
+		mWorkers[i].rach = NULL;
+		mWorkers[i].cpu = -1;
+		mWorkers[i].index = i;
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	stop();
+	delete[] mWorkers;
+}
+
+bool WorkerPool::attach(Transceiver *trx)
+{
+	int i, min = 0;
+
+	if (mOn) {
+		LOG(ERR) << "Cannot attach transceiver to running worker pool";
+		return false;
+	}
+
+	for (i = 1; i < mNumWorkers; i++) {
+		if (mWorkers[i].trx.size() < mWorkers[min].trx.size())
+			min = i;
+	}
+
+	mWorkers[min].trx.push_back(trx);
+
+	return true;
+}
+
+void WorkerPool::setAffinity(int worker, int cpu)
+{
+	if ((worker < 0) || (worker >= mNumWorkers)) {
+		LOG(ERR) << "Invalid worker selection " << worker;
+		return;
+	}
+
+	mWorkers[worker].cpu = cpu;
+}
+
+bool WorkerPool::start()
+{
+	int i;
+	size_t n;
+
+	if (mOn)
+		return false;
+
+	/* FFT planning is not thread safe, so batches are set up here */
+	for (i = 0; i < mNumWorkers; i++) {
+		Worker *worker = &mWorkers[i];
+		if (!worker->trx.size())
+			continue;
+
+		worker->rach = new RACHBatch(RACH_BATCH_LEN * worker->trx.size(),
+					     worker->trx[0]->mSamplesPerSymbol);
+		for (n = 0; n < worker->trx.size(); n++)
+			worker->trx[n]->setRACHBatch(worker->rach);
+	}
+
+	mOn = true;
+
+	for (i = 0; i < mNumWorkers; i++) {
+		mWorkers[i].thread = new Thread(32768);
+		mWorkers[i].thread->start((void * (*)(void*)) WorkerPoolAdapter,
+					  (void *) &mWorkers[i]);
+	}
+
+	return true;
+}
+
+void WorkerPool::stop()
+{
+	int i;
+	size_t n;
+
+	if (!mOn)
+		return;
+
+	mOn = false;
+	notify();
+
+	for (i = 0; i < mNumWorkers; i++) {
+		mWorkers[i].thread->join();
+		delete mWorkers[i].thread;
+		mWorkers[i].thread = NULL;
+
+		if (!mWorkers[i].rach)
+			continue;
+
+		/* Flush bursts deferred before the worker exited */
+		detectRACH(&mWorkers[i]);
+		for (n = 0; n < mWorkers[i].trx.size(); n++)
+			mWorkers[i].trx[n]->setRACHBatch(NULL);
+
+		delete mWorkers[i].rach;
+		mWorkers[i].rach = NULL;
+	}
+}
+
+void WorkerPool::notify()
+{
+	mDoorbellLock.lock();
+	mDoorbellSeq++;
+	mDoorbell.broadcast();
+	mDoorbellLock.unlock();
+}
+
+/*
+ * Sleep unless the doorbell was rung after the caller sampled the
+ * sequence number, so a notification between the last drain and the
+ * wait is never lost.
+ */
+void WorkerPool::wait(unsigned seq)
+{
+	mDoorbellLock.lock();
+	if (seq == mDoorbellSeq)
+		mDoorbell.wait(mDoorbellLock, DOORBELL_TIMEOUT);
+	mDoorbellLock.unlock();
+}
+
+void WorkerPool::detectRACH(Worker *worker)
+{
+	size_t i;
+
+	if (!worker->rach || !worker->rach->size())
+		return;
+
+	worker->rach->detect(RACH_DETECT_THRESHOLD);
+
+	for (i = 0; i < worker->trx.size(); i++)
+		worker->trx[i]->completeRACH();
+
+	worker->rach->clear();
+}
+
+void WorkerPool::serviceWorker(Worker *worker)
+{
+	size_t i;
+	bool busy;
+	unsigned seq;
+
+	setThreadAffinity(worker->cpu);
+
+	if (worker->trx.size())
+		worker->trx[0]->setPriority();
+
+	/* A single channel waits on its own FIFO without the doorbell */
+	if (worker->trx.size() == 1) {
+		while (mOn) {
+			if (worker->trx[0]->pullFIFO(DOORBELL_TIMEOUT)) {
+				while (worker->trx[0]->pullFIFO());
+			}
+
+			detectRACH(worker);
+			pthread_testcancel();
+		}
+		return;
+	}
+
+	while (mOn) {
+		seq = mDoorbellSeq;
+		busy = false;
+
+		for (i = 0; i < worker->trx.size(); i++) {
+			while (worker->trx[i]->pullFIFO())
+				busy = true;
+		}
+
+		detectRACH(worker);
+
+		if (!busy)
+			wait(seq);
+
+		pthread_testcancel();
+	}
+}
+
+void *WorkerPoolAdapter(WorkerPool::Worker *worker)
+{
+	worker->pool->serviceWorker(worker);
+	return NULL;
+}
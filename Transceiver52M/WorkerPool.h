@@ -0,0 +1,102 @@
+/*
+ * Per-channel receive worker pool
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+#include <vector>
+
+#include "Threads.h"
+
+class Transceiver;
+class RACHBatch;
+
+/*
+ * Fixed pool of demodulation threads
+ *
+ * Each attached transceiver is statically assigned to a single worker so
+ * that its receive FIFO keeps exactly one consumer. A worker with a single
+ * channel blocks on that FIFO directly. Otherwise, workers drain all of
+ * their channels and sleep on a shared doorbell that the receive stage
+ * rings after each channelized chunk.
+ *
+ * RACH bursts are deferred to a batch shared by the channels of a worker.
+ * Once the receive FIFO's are drained, all pending RACH bursts are
+ * correlated together in the frequency domain.
+ */
+class WorkerPool {
+public:
+	/** Constructor
+	    @param wNumWorkers number of worker threads
+	*/
+	WorkerPool(int wNumWorkers);
+	~WorkerPool();
+
+	/** Assign a transceiver to the least loaded worker */
+	bool attach(Transceiver *trx);
+
+	/** Pin a worker thread to a CPU, negative values disable pinning */
+	void setAffinity(int worker, int cpu);
+
+	/** Start and stop all worker threads */
+	bool start();
+	void stop();
+
+	/** Wake workers after new bursts have been written */
+	void notify();
+
+	int size() { return mNumWorkers; }
+
+private:
+	struct Worker {
+		WorkerPool *pool;
+		Thread *thread;
+		std::vector<Transceiver *> trx;
+		RACHBatch *rach;
+		int cpu;
+		int index;
+	};
+
+	Worker *mWorkers;
+	int mNumWorkers;
+	volatile bool mOn;
+
+	Mutex mDoorbellLock;
+	Signal mDoorbell;
+	volatile unsigned mDoorbellSeq;
+
+	void wait(unsigned seq);
+
+	/** Detect the deferred RACH bursts of one worker and complete them */
+	void detectRACH(Worker *worker);
+
+	/** Drain the receive FIFO's of one worker until shutdown */
+	void serviceWorker(Worker *worker);
+
+	friend void *WorkerPoolAdapter(Worker *);
+};
+
+/** Worker thread loop */
+void *WorkerPoolAdapter(WorkerPool::Worker *);
+
+/** Pin the calling thread to a CPU */
+bool setThreadAffinity(int cpu);
+
+#endif /* _WORKERPOOL_H_ */
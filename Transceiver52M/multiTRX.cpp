@@ -18,14 +18,23 @@
 
 #include <time.h>
 #include <signal.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <GSMCommon.h>
 #include <Logger.h>
 #include <Configuration.h>
 
 #include "Transceiver.h"
+#include "WorkerPool.h"
 #include "radioDevice.h"
 
+/* Radio devices that one process can drive */
+#define MAX_DEVICES		4
+
 ConfigurationTable gConfig("/etc/OpenBTS/OpenBTS.db");
 
 volatile bool gbShutdown = false;
@@ -55,63 +64,200 @@ static int setupSignals()
 	return 0;
 }
 
+/* One radio device with its own channelizer, drive loop and threads */
+struct Device {
+	int numARFCN;
+	int chanM;
+	int chanMap[CHAN_MAX];
+	RadioDevice *usrp;
+	RadioInterface *radio;
+	DriveLoop *drive;
+};
+
+/*
+ * Open a device and create its radio interface and drive loop. Devices
+ * after the first follow the first device's clock, so all transceivers
+ * share one GSM time, and carry no C0 filler.
+ */
+static bool createDevice(Device *dev, int num, const std::string &args,
+			 DriveLoop *clockSource)
+{
+	/*
+	 * Select the number of channels according to the number of ARFCNs's
+	 * and generate ARFCN-to-channelizer path mappings. The channelizer
+	 * aliases and extracts 'M' equally spaced channels to baseband. The
+	 * number of ARFCN's must be less than the number of channels in the
+	 * channelizer.
+	 */
+	switch (dev->numARFCN) {
+	case 1:
+		dev->chanM = 1;
+		break;
+	case 2:
+	case 3:
+		dev->chanM = 5;
+		break;
+	default:
+		dev->chanM = 10;
+	}
+	genChanMap(dev->numARFCN, dev->chanM, dev->chanMap);
+
+	/* Find a timing offset based on the channelizer configuration */
+	double rxOffset = getRadioOffset(dev->chanM);
+	if (rxOffset == 0.0f) {
+		LOG(ALERT) << "Rx sample offset not found, using offset of 0.0s";
+		LOG(ALERT) << "Rx burst timing may not be accurate"; 
+	}
+
+	LOG(NOTICE) << "Opening device " << num << " for "
+		    << dev->numARFCN << " ARFCN's";
+
+	double deviceRate = dev->chanM * CHAN_RATE;
+	dev->usrp = RadioDevice::make(deviceRate, rxOffset,
+				      DEVICE_TX_AMPL / dev->numARFCN,
+				      false, args);
+	if (!dev->usrp->open()) {
+		LOG(ALERT) << "Failed to open device " << num;
+		return false;
+	}
+
+	dev->radio = new RadioInterface(dev->usrp, dev->chanM, 3,
+					SAMPSPERSYM, 0, false);
+	if (gConfig.defines("TRX.TxSC16") && gConfig.getNum("TRX.TxSC16")) {
+		LOG(NOTICE) << "Using 16-bit transmit samples";
+		dev->radio->setShortTx(true);
+	}
+
+	/* Only the primary device sends clock indications on its own port */
+	if (!clockSource) {
+		dev->drive = new DriveLoop(5700, "127.0.0.1", dev->chanM,
+					   dev->chanMap[0], SAMPSPERSYM,
+					   GSM::Time(3,0), dev->radio);
+	} else {
+		dev->drive = new DriveLoop(0, NULL, dev->chanM, -1,
+					   SAMPSPERSYM, GSM::Time(3,0),
+					   dev->radio, clockSource);
+	}
+
+	if (gConfig.defines("TRX.TransmitSlack"))
+		dev->drive->setTransmitSlack(gConfig.getNum("TRX.TransmitSlack"));
+
+	return true;
+}
+
 /*
- * Generate the channel-transceiver ordering. Attempt to match the RAD1
- * ordering where the active channels are centered in the overall device
- * bandwidth. C0 is always has the lowest ARFCN with increasing subsequent
- * channels. When an even number of channels is selected, the carriers will
- * be offset from the RF center by -200 kHz, or half ARFCN spacing.
+ * Create the demodulation worker pool and apply CPU affinities to the
+ * pipeline stages. By default, one worker is created per ARFCN limited by
+ * the number of CPU's that remain after the receive and transmit threads
+ * of every device.
  */
-static void genChanMap(int numARFCN, int chanM, int *chans)
+static WorkerPool *createWorkers(int numARFCN, Device *devs, int numDevices)
 {
-	int i, n;
+	int i, numWorkers, rxCPU, txCPU;
+	std::vector<unsigned> rxCPUs, txCPUs;
+
+	if (gConfig.defines("TRX.Workers")) {
+		numWorkers = gConfig.getNum("TRX.Workers");
+	} else {
+		numWorkers = sysconf(_SC_NPROCESSORS_ONLN) - 2 * numDevices;
+		if (numWorkers > numARFCN)
+			numWorkers = numARFCN;
+	}
+
+	if (numWorkers < 1)
+		numWorkers = 1;
+
+	LOG(NOTICE) << "Creating " << numWorkers << " demodulation workers";
+	WorkerPool *pool = new WorkerPool(numWorkers);
+
+	if (gConfig.defines("TRX.Affinity.Workers")) {
+		std::vector<unsigned> cpus = gConfig.getVector("TRX.Affinity.Workers");
+		for (i = 0; i < (int) cpus.size(); i++)
+			pool->setAffinity(i, cpus[i]);
+	}
+
+	if (gConfig.defines("TRX.Affinity.Receive"))
+		rxCPUs = gConfig.getVector("TRX.Affinity.Receive");
+	if (gConfig.defines("TRX.Affinity.Transmit"))
+		txCPUs = gConfig.getVector("TRX.Affinity.Transmit");
 
-	chans[0] = numARFCN / 2; 
+	for (i = 0; i < numDevices; i++) {
+		rxCPU = i < (int) rxCPUs.size() ? (int) rxCPUs[i] : -1;
+		txCPU = i < (int) txCPUs.size() ? (int) txCPUs[i] : -1;
 
-	for (i = 1, n = 1; i < numARFCN; i++) {
-		if (!chans[i - 1])
-			chans[i] = chanM - 1;
-		else
-			chans[i] = chans[i - 1] - 1;
+		devs[i].drive->setAffinity(rxCPU, txCPU);
+		devs[i].drive->setWorkerPool(pool);
 	}
+
+	return pool;
 }
 
-static void createTrx(Transceiver **trx, int *map, int num,
-		      RadioInterface *radio, DriveLoop *drive)
+/*
+ * Create the transceivers of a device. Numbering and ports continue from
+ * the previous device, and the first transceiver on each device controls
+ * its radio.
+ */
+static void createTrx(Transceiver **trx, int first, Device *dev,
+		      WorkerPool *pool)
 {
 	int i;
 	bool primary = true;
+	Transceiver::EqualizerType eq = Transceiver::EQ_DFE;
 
-	for (i = 0; i < num; i++) {
-		LOG(NOTICE) << "Creating TRX" << i
-			    << " attached on channel " << map[i];
+	if (gConfig.defines("TRX.Equalizer") &&
+	    (gConfig.getStr("TRX.Equalizer") == "MLSE")) {
+		LOG(NOTICE) << "Using MLSE receive equalizer";
+		eq = Transceiver::EQ_MLSE;
+	}
 
-		radio->activateChan(map[i]);
-		trx[i] = new Transceiver(5700 + 2 * i, "127.0.0.1",
-					 SAMPSPERSYM, radio, drive,
-					 map[i], primary);
-		trx[i]->start();
+	for (i = 0; i < dev->numARFCN; i++) {
+		LOG(NOTICE) << "Creating TRX" << first + i
+			    << " attached on channel " << dev->chanMap[i];
+
+		dev->radio->activateChan(dev->chanMap[i]);
+		trx[i] = new Transceiver(5700 + 2 * (first + i), "127.0.0.1",
+					 SAMPSPERSYM, dev->radio, dev->drive,
+					 dev->chanMap[i], primary);
+		trx[i]->setEqualizer(eq);
+		pool->attach(trx[i]);
 		primary = false;
 	}
 }
 
 int main(int argc, char *argv[])
 {
-	int i, chanM, numARFCN = 1;
-	int chanMap[CHAN_MAX];
-	RadioDevice *usrp;
-	RadioInterface* radio;
-	DriveLoop *drive;
-	Transceiver *trx[CHAN_MAX];
+	int i, numARFCN = 1, numDevices;
+	std::vector<std::string> devArgs;
+	Device devs[MAX_DEVICES];
+	WorkerPool *pool;
+	Transceiver *trx[MAX_DEVICES * CHAN_MAX];
 
 	gLogInit("transceiver", gConfig.getStr("Log.Level").c_str(), LOG_LOCAL7);
 
-	if (argc > 1) {
+	/* One device per argument string, or the first device found */
+	if (gConfig.defines("TRX.Devices")) {
+		std::istringstream list(gConfig.getStr("TRX.Devices"));
+		std::string args;
+		while (list >> args)
+			devArgs.push_back(args);
+	}
+	if (devArgs.empty())
+		devArgs.push_back("");
+
+	numDevices = devArgs.size();
+	if (numDevices > MAX_DEVICES) {
+		LOG(ALERT) << numDevices << " devices not supported with current build";
+		exit(-1);
+	}
+
+	if (argc > 1)
 		numARFCN = atoi(argv[1]);
-		if (numARFCN > (CHAN_MAX - 1)) {
-			LOG(ALERT) << numARFCN << " channels not supported with current build";
-			exit(-1);
-		}
+
+	if ((numARFCN < numDevices) ||
+	    (numARFCN > numDevices * (CHAN_MAX - 1))) {
+		LOG(ALERT) << numARFCN << " channels not supported with "
+			   << numDevices << " devices and current build";
+		exit(-1);
 	}
 
 	srandom(time(NULL));
@@ -121,46 +267,53 @@ int main(int argc, char *argv[])
 		exit(-1);
 	}
 
-	/*
-	 * Select the number of channels according to the number of ARFCNs's
-	 * and generate ARFCN-to-channelizer path mappings. The channelizer
-	 * aliases and extracts 'M' equally spaced channels to baseband. The
-	 * number of ARFCN's must be less than the number of channels in the
-	 * channelizer.
-	 */
-	switch (numARFCN) {
-	case 1:
-		chanM = 1;
-		break;
-	case 2:
-	case 3:
-		chanM = 5;
-		break;
-	default:
-		chanM = 10;
-	}
-	genChanMap(numARFCN, chanM, chanMap);
+	/* Spread ARFCN's evenly with the remainder on the first devices */
+	for (i = 0; i < numDevices; i++) {
+		devs[i].numARFCN = numARFCN / numDevices +
+				   (i < numARFCN % numDevices);
 
-	/* Find a timing offset based on the channelizer configuration */
-	double rxOffset = getRadioOffset(chanM);
-	if (rxOffset == 0.0f) {
-		LOG(ALERT) << "Rx sample offset not found, using offset of 0.0s";
-		LOG(ALERT) << "Rx burst timing may not be accurate"; 
+		if (!createDevice(&devs[i], i, devArgs[i],
+				  i ? devs[0].drive : NULL)) {
+			LOG(ALERT) << "Failed to create device, exiting...";
+			return EXIT_FAILURE;
+		}
 	}
 
-	double deviceRate = chanM * CHAN_RATE;
-	usrp = RadioDevice::make(deviceRate, rxOffset, DEVICE_TX_AMPL / numARFCN);
-	if (!usrp->open()) {
-		LOG(ALERT) << "Failed to open device, exiting...";
-		return EXIT_FAILURE;
+	/*
+	 * Sample timestamps of separate devices only agree when their times
+	 * are set on the same edge of a shared PPS signal
+	 */
+	if (numDevices > 1) {
+		RadioDevice *usrps[MAX_DEVICES];
+		for (i = 0; i < numDevices; i++)
+			usrps[i] = devs[i].usrp;
+
+		if (!gConfig.defines("TRX.Devices.PPS") ||
+		    !gConfig.getNum("TRX.Devices.PPS")) {
+			LOG(ALERT) << "Several devices need a shared PPS signal, "
+				   << "set TRX.Devices.PPS, exiting...";
+			return EXIT_FAILURE;
+		}
+		if (!RadioDevice::alignTimes(usrps, numDevices, ALIGN_PERIOD)) {
+			LOG(ALERT) << "Failed to align device times, exiting...";
+			return EXIT_FAILURE;
+		}
 	}
 
-	radio = new RadioInterface(usrp, chanM, 3, SAMPSPERSYM, 0, false);
-	drive = new DriveLoop(5700, "127.0.0.1", chanM, chanMap[0],
-			      SAMPSPERSYM, GSM::Time(3,0), radio);
-
 	/* Create, attach, and activate all transceivers */
-	createTrx(trx, chanMap, numARFCN, radio, drive);
+	pool = createWorkers(numARFCN, devs, numDevices);
+	for (i = 0, numARFCN = 0; i < numDevices; i++) {
+		createTrx(&trx[numARFCN], numARFCN, &devs[i], pool);
+
+		/* The GSM core only powers on C0, which starts the others */
+		if (i)
+			trx[0]->addSecondary(trx[numARFCN]);
+		numARFCN += devs[i].numARFCN;
+	}
+
+	for (i = 0; i < numARFCN; i++)
+		trx[i]->start();
+	pool->start();
 
 	while (!gbShutdown) { 
 		sleep(1);
@@ -170,6 +323,7 @@ int main(int argc, char *argv[])
 	for (i = 0; i < numARFCN; i++) {
 		trx[i]->shutdown();
 	}
+	pool->stop();
 
 	/*
 	 * Allow time for threads to end before we start freeing objects
@@ -180,7 +334,12 @@ int main(int argc, char *argv[])
 		delete trx[i];
 	}
 
-	delete drive;
-	delete radio;
-	delete usrp;
+	delete pool;
+
+	/* Secondary drive loops forward to the primary, delete them first */
+	for (i = numDevices - 1; i >= 0; i--) {
+		delete devs[i].drive;
+		delete devs[i].radio;
+		delete devs[i].usrp;
+	}
 }
@@ -21,18 +21,45 @@
 
 #include "radioClock.h"
 
+static long elapsedNs(const struct timespec &from, const struct timespec &to)
+{
+	return (to.tv_sec - from.tv_sec) * 1000000000L +
+	       (to.tv_nsec - from.tv_nsec);
+}
+
+RadioClock::RadioClock()
+	: mTicks(0), mPeriod(RADIO_CLOCK_TN_NS)
+{
+	clock_gettime(CLOCK_MONOTONIC, &mStamp);
+	mAnchor = mStamp;
+}
+
 void RadioClock::set(const GSM::Time& wTime)
 {
 	mLock.lock();
 	mClock = wTime;
+	clock_gettime(CLOCK_MONOTONIC, &mStamp);
+	mAnchor = mStamp;
+	mTicks = 0;
 	updateSignal.signal();
 	mLock.unlock();
 }
 
+/*
+ * Timeslots arrive in clusters of a receive chunk, so the period is
+ * averaged over a window of updates rather than taken from neighbours.
+ * The device clock, or the DummyLoad speed, sets the rate.
+ */
 void RadioClock::incTN()
 {
 	mLock.lock();
 	mClock.incTN();
+	clock_gettime(CLOCK_MONOTONIC, &mStamp);
+	if (++mTicks == RADIO_CLOCK_WINDOW) {
+		mPeriod = elapsedNs(mAnchor, mStamp) / RADIO_CLOCK_WINDOW;
+		mAnchor = mStamp;
+		mTicks = 0;
+	}
 	updateSignal.signal();
 	mLock.unlock();
 }
@@ -46,9 +73,21 @@ GSM::Time RadioClock::get()
 	return retVal;
 }
 
-void RadioClock::wait()
+GSM::Time RadioClock::get(struct timespec &stamp, long &period)
+{
+	mLock.lock();
+	GSM::Time retVal = mClock;
+	stamp = mStamp;
+	period = mPeriod;
+	mLock.unlock();
+
+	return retVal;
+}
+
+void RadioClock::wait(const GSM::Time& last)
 {
 	mLock.lock();
-	updateSignal.wait(mLock,1);
+	if (mClock == last)
+		updateSignal.wait(mLock,1);
 	mLock.unlock();
 }
@@ -22,19 +22,40 @@
 #ifndef RADIOCLOCK_H
 #define RADIOCLOCK_H
 
+#include <time.h>
+
 #include "GSMCommon.h"
 
+/* Nominal timeslot period and number of updates between period estimates */
+#define RADIO_CLOCK_TN_NS	576923
+#define RADIO_CLOCK_WINDOW	1024
+
 class RadioClock {
 public:
+	RadioClock();
+
 	void set(const GSM::Time& wTime);
 	void incTN();
 	GSM::Time get();
-	void wait();
+
+	/** Return the clock with the monotonic time of its last update
+	    and the measured timeslot period in nanoseconds */
+	GSM::Time get(struct timespec &stamp, long &period);
+
+	/** Block until the clock moves away from a previously read value.
+	    Returns immediately if it already has, otherwise up to 1 ms.
+	 */
+	void wait(const GSM::Time& last);
 
 private:
 	GSM::Time mClock;
 	Mutex mLock;
 	Signal updateSignal;
+
+	struct timespec mStamp;   ///< monotonic time of the last update
+	struct timespec mAnchor;  ///< start of the current period window
+	unsigned mTicks;          ///< updates since the window started
+	long mPeriod;             ///< measured timeslot period in ns
 };
 
 #endif /* RADIOCLOCK_H */
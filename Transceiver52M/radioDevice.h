@@ -16,6 +16,8 @@
 #define __RADIO_DEVICE_H__
 
 
+#include <string>
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -30,9 +32,19 @@ class RadioDevice {
   /* Available transport bus types */
   enum busType { USB, NET };
 
+  /** Create a device, args select one of several attached devices, e.g. "serial=..." */
   static RadioDevice *make(double desiredSampleRate,
 			   double offset, double ampl = 0.5,
-			   bool skipRx = false);
+			   bool skipRx = false,
+			   const std::string &args = "");
+
+  /**
+	Zero the sample clocks of several devices on the same edge of a shared
+	PPS signal. Each device then starts streaming on a multiple of period
+	seconds of that time, so the devices agree on sample timestamps.
+	@return false if no PPS edge arrives
+  */
+  static bool alignTimes(RadioDevice **devs, int num, double period);
 
   virtual ~RadioDevice() {};
 
@@ -77,6 +89,20 @@ class RadioDevice {
   virtual int writeSamples(float *buf, int len, bool *underrun, 
 		    TIMESTAMP timestamp,
 		    bool isControl=false)=0;
+
+  /**
+        Write interleaved 16-bit I/Q samples to the radio, full scale of 32767.
+        Devices that do not accept 16-bit samples return a negative value.
+        @param buf Contains the data to be written.
+        @param len number of samples to write.
+        @param underrun Set if radio does not have data to transmit, e.g. data not being sent fast enough
+        @param timestamp The timestamp of the first sample of the data buffer.
+        @param isControl Set if data is a control packet, e.g. a ping command
+        @return The number of samples actually written
+  */
+  virtual int writeSamples(short *buf, int len, bool *underrun,
+		    TIMESTAMP timestamp,
+		    bool isControl=false) { return -1; }
  
   /** Update the alignment between the read and write timestamps */
   virtual bool updateAlignment(TIMESTAMP timestamp)=0;
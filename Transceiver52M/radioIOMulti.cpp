@@ -18,6 +18,8 @@
  * See the COPYING file in the main directory for details.
  */
 
+#include <limits.h>
+
 #include <Synthesis.h>
 #include <Channelizer.h>
 #include <radioInterface.h>
@@ -40,36 +42,28 @@
 #define INBUFLEN		(INCHUNK * 4)
 #define OUTBUFLEN		(OUTCHUNK * 4)
 
-static struct cxvec *highRateTxBuf;
-static struct cxvec *highRateRxBuf;
-
-static struct cxvec *lowRateTxBufs[CHAN_MAX];
-static struct cxvec *lowRateRxBufs[CHAN_MAX];
-
-static Channelizer *chan;
-static Synthesis *synth;
-
 /* Initialize I/O specific objects */
 bool RadioInterface::init()
 {
 	int i;
 
-	chan = new Channelizer(mChanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
+	mChannelizer = new Channelizer(mChanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
 			       RESAMP_INRATE, RESAMP_OUTRATE, CHUNKMUL);
-	if (!chan->init(NULL)) {
+	if (!mChannelizer->init(NULL)) {
 		LOG(ALERT) << "Rx channelizer failed to initialize";
 		return false;
 	}
 
-	synth = new Synthesis(mChanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
+	mSynthesis = new Synthesis(mChanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
 			      RESAMP_OUTRATE, RESAMP_INRATE, CHUNKMUL);
-	if (!synth->init(NULL)) {
+	if (!mSynthesis->init(NULL)) {
 		LOG(ALERT) << "Tx channelizer failed to initialize";
 		return false;
 	}
 
-	highRateTxBuf = cxvec_alloc(OUTBUFLEN * mChanM, 0, NULL, 0);
-	highRateRxBuf = cxvec_alloc(OUTBUFLEN * mChanM, 0, NULL, 0);
+	mHighRateTxBuf = cxvec_alloc(OUTBUFLEN * mChanM, 0, NULL, 0);
+	mHighRateRxBuf = cxvec_alloc(OUTBUFLEN * mChanM, 0, NULL, 0);
+	mHighRateTxShortBuf = (short *) malloc(2 * OUTBUFLEN * mChanM * sizeof(short));
 
 	/*
 	 * Setup per-channel variables. The low rate transmit vectors 
@@ -79,13 +73,13 @@ bool RadioInterface::init()
 	 */
 	for (i = 0; i < mChanM; i++) {
 		if (chanActive[i]) {
-			chan->activateChan(i);
-			synth->activateChan(i);
+			mChannelizer->activateChan(i);
+			mSynthesis->activateChan(i);
 		}
 
-		lowRateRxBufs[i] =
+		mLowRateRxBufs[i] =
 			cxvec_alloc(2 * 625, 0, (cmplx *) rcvBuffer[i], 0);
-		lowRateTxBufs[i] =
+		mLowRateTxBufs[i] =
 			cxvec_alloc(2 * 625, RESAMP_FILT_LEN, (cmplx *) sendBuffer[i], 0);
 	}
 
@@ -96,20 +90,23 @@ void RadioInterface::close()
 {
 	int i;
 
-	cxvec_free(highRateTxBuf);
-	cxvec_free(highRateRxBuf);
+	cxvec_free(mHighRateTxBuf);
+	cxvec_free(mHighRateRxBuf);
+	free(mHighRateTxShortBuf);
 
 	/* Don't deallocate class member buffers */
 	for (i = 0; i < mChanM; i ++) {
-		lowRateRxBufs[i]->buf = NULL;
-		lowRateTxBufs[i]->buf = NULL;
+		mLowRateRxBufs[i]->buf = NULL;
+		mLowRateTxBufs[i]->buf = NULL;
 
-		cxvec_free(lowRateRxBufs[i]);
-		cxvec_free(lowRateTxBufs[i]);
+		cxvec_free(mLowRateRxBufs[i]);
+		cxvec_free(mLowRateTxBufs[i]);
 	}
 
-	delete chan;
-	delete synth;
+	delete mChannelizer;
+	delete mSynthesis;
+	mChannelizer = NULL;
+	mSynthesis = NULL;
 }
 
 /* Receive a timestamped chunk from the device */
@@ -119,25 +116,27 @@ void RadioInterface::pullBuffer()
 	bool localUnderrun;
 
 	/* Read samples. Fail if we don't get what we want. */
-	numRead = mRadio->readSamples((float *) highRateRxBuf->data,
+	numRead = mRadio->readSamples((float *) mHighRateRxBuf->data,
 				      OUTCHUNK * mChanM, &overrun,
 				      readTimestamp, &localUnderrun);
 
-	LOG(DEBUG) << "Rx read " << highRateRxBuf->len << " samples from device";
+	LOG(DEBUG) << "Rx read " << mHighRateRxBuf->len << " samples from device";
 	assert(numRead == (OUTCHUNK * mChanM));
 
-	highRateRxBuf->len = numRead;
+	mHighRateRxBuf->len = numRead;
 	underrun |= localUnderrun;
-	readTimestamp += (TIMESTAMP) highRateRxBuf->len;
+	readTimestamp += (TIMESTAMP) mHighRateRxBuf->len;
 
 	for (i = 0; i < mChanM; i++) {
-		lowRateRxBufs[i]->start_idx = rcvCursor;
-		lowRateRxBufs[i]->data = &lowRateRxBufs[i]->buf[rcvCursor];
-		lowRateRxBufs[i]->len = INCHUNK;
+		mLowRateRxBufs[i]->start_idx = rcvCursor;
+		mLowRateRxBufs[i]->data = &mLowRateRxBufs[i]->buf[rcvCursor];
+		mLowRateRxBufs[i]->len = INCHUNK;
 	}
 
 	/* Channelize */
-	numConverted = chan->rotate(highRateRxBuf, lowRateRxBufs);
+	uint64_t start = latencyTicks();
+	numConverted = mChannelizer->rotate(mHighRateRxBuf, mLowRateRxBufs);
+	mChanStats.addSince(start);
 	rcvCursor += numConverted;
 }
 
@@ -156,6 +155,7 @@ static void shiftTxBufs(struct cxvec **vecs, int chanM, int len, int n)
 void RadioInterface::pushBuffer()
 {
 	int i, numConverted, numChunks, numSent;
+	uint64_t start;
 
 	if (sendCursor < INCHUNK)
 		return;
@@ -164,24 +164,57 @@ void RadioInterface::pushBuffer()
 	numChunks = 1;
 
 	for (i = 0; i < mChanM; i++) {
-		lowRateTxBufs[i]->len = numChunks * INCHUNK;
+		mLowRateTxBufs[i]->len = numChunks * INCHUNK;
 	}
 
-	highRateTxBuf->len = numChunks * OUTCHUNK * mChanM;
-
-	numConverted = synth->rotate(lowRateTxBufs, highRateTxBuf);
+	mHighRateTxBuf->len = numChunks * OUTCHUNK * mChanM;
 
-	/* Write samples. Fail if we don't get what we want. */
-	numSent = mRadio->writeSamples((float *) highRateTxBuf->data,
-					numConverted,
-					&underrun,
-					writeTimestamp);
+	/*
+	 * Synthesize and write samples. The 16-bit path converts while
+	 * interleaving and falls back to floating point if the device
+	 * does not accept 16-bit samples. Fail if we don't get what we want.
+	 */
+	if (mShortTx) {
+		start = latencyTicks();
+		numConverted = mSynthesis->rotate(mLowRateTxBufs, mHighRateTxShortBuf,
+					     mHighRateTxBuf->len, SHRT_MAX);
+		mSynthStats.addSince(start);
+		numSent = mRadio->writeSamples(mHighRateTxShortBuf,
+					       numConverted,
+					       &underrun,
+					       writeTimestamp);
+		if (numSent < 0) {
+			LOG(ALERT) << "Device does not support 16-bit samples, "
+				   << "using floating point transmit";
+			mShortTx = false;
+
+			/*
+			 * The filterbank has already consumed this chunk, so
+			 * send the 16-bit output converted back to floating point
+			 */
+			float *data = (float *) mHighRateTxBuf->data;
+			for (i = 0; i < 2 * numConverted; i++)
+				data[i] = (float) mHighRateTxShortBuf[i] / SHRT_MAX;
+
+			numSent = mRadio->writeSamples(data, numConverted,
+						       &underrun,
+						       writeTimestamp);
+		}
+	} else {
+		start = latencyTicks();
+		numConverted = mSynthesis->rotate(mLowRateTxBufs, mHighRateTxBuf);
+		mSynthStats.addSince(start);
+		numSent = mRadio->writeSamples((float *) mHighRateTxBuf->data,
+						numConverted,
+						&underrun,
+						writeTimestamp);
+	}
 	assert(numSent == numConverted);
 	writeTimestamp += (TIMESTAMP) numSent;
 
 	/* Move unsent samples to beginning of buffer */
-	shiftTxBufs(lowRateTxBufs, mChanM, sendCursor, lowRateTxBufs[0]->len);
-	sendCursor -= lowRateTxBufs[0]->len;
+	shiftTxBufs(mLowRateTxBufs, mChanM, sendCursor, mLowRateTxBufs[0]->len);
+	sendCursor -= mLowRateTxBufs[0]->len;
 	assert(sendCursor >= 0);
 }
 
@@ -199,6 +232,12 @@ bool RadioInterface::activateChan(int num)
 
 	chanActive[num] = true;
 
+	/* Channelizers are created at start and pick up earlier activations */
+	if (mChannelizer)
+		mChannelizer->activateChan(num);
+	if (mSynthesis)
+		mSynthesis->activateChan(num);
+
 	return true;
 }
 
@@ -209,12 +248,17 @@ bool RadioInterface::deactivateChan(int num)
 		return false;
 	}
 
-	if (chanActive[num]) {
+	if (!chanActive[num]) {
 		LOG(ERR) << "Channel not active";
 		return false;
 	}
 
 	chanActive[num] = false;
 
+	if (mChannelizer)
+		mChannelizer->deactivateChan(num);
+	if (mSynthesis)
+		mSynthesis->deactivateChan(num);
+
 	return true;
 }
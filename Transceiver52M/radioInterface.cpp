@@ -22,6 +22,8 @@
 
 */
 
+#include <string.h>
+
 #include "radioInterface.h"
 #include <Logger.h>
 
@@ -32,6 +34,7 @@ RadioInterface::RadioInterface(RadioDevice *wRadio,
 			       int wTransceiverOversampling,
 			       GSM::Time wStartTime)
   : mChanM(wChanM), underrun(false), sendCursor(0), rcvCursor(0), mOn(false),
+    mShortTx(false),
     mRadio(wRadio), receiveOffset(wReceiveOffset),
     samplesPerSymbol(wRadioOversampling), powerScaling(1.0),
     loadTest(false), mAlignRadioServiceLoopThread(NULL)
@@ -40,9 +43,45 @@ RadioInterface::RadioInterface(RadioDevice *wRadio,
 
   mClock.set(wStartTime);
 
-  for (i = 0; i < mChanM; i++) {
+  // filterbanks and their buffers are created when the interface starts
+  mChannelizer = NULL;
+  mSynthesis = NULL;
+
+  for (i = 0; i < CHAN_MAX; i++) {
     chanActive[i] = false;
+    rxGate[i] = 0.0;
+    rxGatedTime[i] = RX_GATED_NONE;
   }
+
+  // pass up every burst until a schedule is set
+  memset(rxSlotActive, true, sizeof(rxSlotActive));
+}
+
+void RadioInterface::setSlotSchedule(int num, int tn, const bool *active)
+{
+  memcpy(rxSlotActive[num][tn], active, RX_SCHEDULE_FRAMES * sizeof(bool));
+}
+
+void RadioInterface::setEnergyGate(int num, float power)
+{
+  double scale = mRadio->fullScaleOutputValue();
+
+  rxGate[num] = power / (scale * scale);
+}
+
+/*
+ * Average power over the energy detector window, every fourth sample from
+ * the start of the burst, computed on the interleaved device samples.
+ */
+static float burstEnergy(const float *buf, int window)
+{
+  float energy = 0.0f;
+
+  for (int i = 0; i < window; i++)
+    energy += buf[8 * i + 0] * buf[8 * i + 0] +
+              buf[8 * i + 1] * buf[8 * i + 1];
+
+  return energy / window;
 }
 
 RadioInterface::~RadioInterface(void)
@@ -147,8 +186,6 @@ bool RadioInterface::start()
   mAlignRadioServiceLoopThread = new Thread(32768);
   mAlignRadioServiceLoopThread->start((void * (*)(void*))AlignRadioServiceLoopAdapter,
                                       (void*)this);
-  writeTimestamp = mRadio->initialWriteTimestamp();
-  readTimestamp = mRadio->initialReadTimestamp();
   for (i = 0; i < mChanM; i++) {
     sendBuffer[i] = new float[8*2*INCHUNK];
     rcvBuffer[i] = new float[8*2*OUTCHUNK];
@@ -157,7 +194,10 @@ bool RadioInterface::start()
   /* Init I/O specific variables if applicable */ 
   init();
 
+  // devices with a shared time pick their first timestamp when they start
   mRadio->start(); 
+  writeTimestamp = mRadio->initialWriteTimestamp();
+  readTimestamp = mRadio->initialReadTimestamp();
   LOG(DEBUG) << "Radio started";
   mRadio->updateAlignment(writeTimestamp-10000); 
   mRadio->updateAlignment(writeTimestamp-10000);
@@ -226,12 +266,26 @@ void RadioInterface::loadVectors(unsigned tN, int samplesPerBurst,
                                  int idx, GSM::Time rxClock)
 {
   int i;
+  unsigned fN = rxClock.FN() % RX_SCHEDULE_FRAMES;
 
   for (i = 0; i < mChanM; i++) {
-    if (chanActive[i]) {
-      signalVector rxVector(samplesPerBurst);
-      unRadioifyVector(rcvBuffer[i], idx * 2, rxVector);
-      radioVector *rxBurst = new radioVector(rxVector, rxClock);
+    // skip bursts the transceiver would discard before copying them out
+    if (chanActive[i] && rxSlotActive[i][tN][fN]) {
+      if ((rxGate[i] > 0.0) &&
+          (burstEnergy(rcvBuffer[i] + idx * 2,
+                       RX_ENERGY_WINDOW * samplesPerSymbol) <= rxGate[i])) {
+        rxGatedTime[i] = rxClock.FN() * 8 + tN;
+        continue;
+      }
+
+      if (mReceiveFIFO[i].full()) {
+        LOG(NOTICE) << "Receive FIFO overflow on channel " << i
+                    << ", dropping burst at " << rxClock;
+        continue;
+      }
+
+      radioVector *rxBurst = mReceiveFIFO[i].get(samplesPerBurst, rxClock);
+      unRadioifyVector(rcvBuffer[i], idx * 2, *rxBurst);
       mReceiveFIFO[i].write(rxBurst);
     }
   }
@@ -242,9 +296,6 @@ void RadioInterface::driveReceiveRadio()
   if (!mOn)
     return;
 
-  if (mReceiveFIFO[0].size() > 8)
-    return;
-
   pullBuffer();
 
   GSM::Time rcvClock = mClock.get();
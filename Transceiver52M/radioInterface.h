@@ -22,10 +22,24 @@
 #include "radioVector.h"
 #include "radioClock.h"
 #include "radioParams.h"
+#include "LatencyStats.h"
 
 #define INCHUNK    (625)
 #define OUTCHUNK   (625)
 
+/** Frames in a receive schedule, a multiple of every channel combination's cycle */
+#define RX_SCHEDULE_FRAMES	102
+
+/** Symbols in the burst energy detection window */
+#define RX_ENERGY_WINDOW	20
+
+/** Gated burst time that never matches a real burst */
+#define RX_GATED_NONE		(~0U)
+
+struct cxvec;
+class Channelizer;
+class Synthesis;
+
 /** class to interface the transceiver with the USRP */
 class RadioInterface {
 
@@ -45,6 +59,9 @@ private:
   unsigned rcvCursor;
 
   bool chanActive[CHAN_MAX];
+  bool rxSlotActive[CHAN_MAX][8][RX_SCHEDULE_FRAMES]; ///< slots to pass up, indexed by frame number modulo the schedule
+  float rxGate[CHAN_MAX];                     ///< burst energy gate in device units, zero to pass all bursts
+  volatile unsigned rxGatedTime[CHAN_MAX];    ///< last gated burst as FN * 8 + TN
  
   bool underrun;			      ///< indicates writes to USRP are too slow
   bool overrun;				      ///< indicates reads from USRP are too slow
@@ -58,7 +75,20 @@ private:
   int mRadioOversampling;
   int mTransceiverOversampling;
 
+  /** Filterbank state of the channelizing interface, one set per device */
+  Channelizer *mChannelizer;
+  Synthesis *mSynthesis;
+  struct cxvec *mHighRateTxBuf;
+  struct cxvec *mHighRateRxBuf;
+  short *mHighRateTxShortBuf;
+  struct cxvec *mLowRateTxBufs[CHAN_MAX];
+  struct cxvec *mLowRateRxBufs[CHAN_MAX];
+
   bool mOn;				      ///< indicates radio is on
+  bool mShortTx;                              ///< write 16-bit I/Q samples to the device
+
+  LatencyHistogram mChanStats;                ///< channelizer ticks per chunk, receive thread
+  LatencyHistogram mSynthStats;               ///< synthesis ticks per chunk, transmit thread
 
   double powerScaling;
 
@@ -148,18 +178,49 @@ public:
   /** returns the full-scale receive amplitude **/
   double fullScaleOutputValue();
 
+  /** returns the sample timestamp of the first sample, once started **/
+  TIMESTAMP startTimestamp() { return mRadio->initialReadTimestamp(); }
+
+  /** returns the device sample rate **/
+  double getSampleRate() { return mRadio->getSampleRate(); }
+
   /** set thread priority on current thread */
   void setPriority() { mRadio->setPriority(); }
 
   /** get transport bus type of attached device */ 
   enum RadioDevice::busType getBus() { return mRadio->getBus(); }
 
+  /** select 16-bit I/Q transmit samples, multichannel interface only */
+  void setShortTx(bool enable) { mShortTx = enable; }
+
+  /** channelizer and synthesis probe histograms */
+  const LatencyHistogram &channelizerStats() const { return mChanStats; }
+  const LatencyHistogram &synthesisStats() const { return mSynthStats; }
+
   /** activate a channel */
   bool activateChan(int num);
 
   /** deactivate a channel */
   bool deactivateChan(int num);
 
+  /**
+    select the receive bursts of a timeslot that are passed up the FIFO
+    @param num channel number
+    @param tn timeslot number
+    @param active RX_SCHEDULE_FRAMES flags indexed by frame number modulo the schedule
+  */
+  void setSlotSchedule(int num, int tn, const bool *active);
+
+  /**
+    drop bursts whose energy detection window falls at or below a power
+    @param num channel number
+    @param power average power at the receive FIFO scale, zero to pass all bursts
+  */
+  void setEnergyGate(int num, float power);
+
+  /** time of the last gated burst of a channel as FN * 8 + TN, or RX_GATED_NONE */
+  unsigned lastGated(int num) const { return rxGatedTime[num]; }
+
 protected:
 
   /** drive synchronization of Tx/Rx of USRP */
@@ -112,3 +112,24 @@ double getRadioOffset(int numChans, double rate, int sps,
 
 	return 0.0f;
 }
+
+/*
+ * Generate the channel-transceiver ordering. Attempt to match the RAD1
+ * ordering where the active channels are centered in the overall device
+ * bandwidth. C0 is always has the lowest ARFCN with increasing subsequent
+ * channels. When an even number of channels is selected, the carriers will
+ * be offset from the RF center by -200 kHz, or half ARFCN spacing.
+ */
+void genChanMap(int numARFCN, int chanM, int *chans)
+{
+	int i;
+
+	chans[0] = numARFCN / 2; 
+
+	for (i = 1; i < numARFCN; i++) {
+		if (!chans[i - 1])
+			chans[i] = chanM - 1;
+		else
+			chans[i] = chans[i - 1] - 1;
+	}
+}
@@ -51,4 +51,7 @@ double getRadioOffset(int chanM,
 		      int resampFiltLen = RESAMP_FILT_LEN,
 		      int chanFiltLen = CHAN_FILT_LEN);
 
+/* Map ARFCN's to channelizer paths centered in the device bandwidth */
+void genChanMap(int numARFCN, int chanM, int *chans);
+
 #endif /* RADIOPARAMS_H */
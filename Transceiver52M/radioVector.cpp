@@ -22,10 +22,23 @@
 #include "radioVector.h"
 
 radioVector::radioVector(const signalVector& wVector, GSM::Time& wTime)
-	: signalVector(wVector), mTime(wTime)
+	: signalVector(wVector), mTime(wTime), mPool(NULL)
 {
 }
 
+radioVector::radioVector(size_t wCapacity, RadioVectorPool *wPool)
+	: signalVector(wCapacity), mPool(wPool)
+{
+}
+
+void radioVector::release()
+{
+	if (mPool)
+		mPool->put(this);
+	else
+		delete this;
+}
+
 GSM::Time radioVector::getTime() const
 {
 	return mTime;
@@ -41,54 +54,157 @@ bool radioVector::operator>(const radioVector& other) const
 	return mTime > other.mTime;
 }
 
-GSM::Time VectorQueue::nextTime() const
+RadioVectorPool::RadioVectorPool(int wNumVectors, size_t wVectorLen)
+	: mFree(wNumVectors), mNumVectors(wNumVectors), mVectorLen(wVectorLen)
+{
+	mVectors = new radioVector *[mNumVectors];
+
+	for (int i = 0; i < mNumVectors; i++) {
+		mVectors[i] = new radioVector(mVectorLen, this);
+		mFree.write(mVectors[i]);
+	}
+}
+
+/* Pooled bursts are owned here regardless of where they were left */
+RadioVectorPool::~RadioVectorPool()
+{
+	while (mFree.readNoBlock());
+
+	for (int i = 0; i < mNumVectors; i++)
+		delete mVectors[i];
+
+	delete[] mVectors;
+}
+
+radioVector *RadioVectorPool::get(size_t len, const GSM::Time& wTime)
+{
+	radioVector *vec = NULL;
+
+	if (len <= mVectorLen)
+		vec = mFree.readNoBlock();
+
+	if (!vec) {
+		signalVector empty(len);
+		GSM::Time time = wTime;
+		return new radioVector(empty, time);
+	}
+
+	vec->mEnd = vec->mStart + len;
+	vec->setSymmetry(NONE);
+	vec->isRealOnly(false);
+	vec->setTime(wTime);
+
+	return vec;
+}
+
+void RadioVectorPool::put(radioVector *vec)
+{
+	mFree.write(vec);
+}
+
+VectorFIFO::VectorFIFO()
+	: mPool(VECTOR_FIFO_LEN + 4), mRing(VECTOR_FIFO_LEN)
+{
+}
+
+VectorFIFO::~VectorFIFO()
 {
-	GSM::Time retVal;
-	mLock.lock();
+	clear();
+}
+
+void VectorFIFO::clear()
+{
+	radioVector *vec;
+
+	while ((vec = mRing.readNoBlock()))
+		vec->release();
+}
+
+static std::vector<radioVector*> reservedHeap()
+{
+	std::vector<radioVector*> vec;
+	vec.reserve(VECTOR_QUEUE_LEN);
+	return vec;
+}
+
+VectorQueue::VectorQueue()
+	: mPool(2 * VECTOR_QUEUE_LEN), mRing(VECTOR_QUEUE_LEN),
+	  mQ(PointerCompare<radioVector>(), reservedHeap()),
+	  mClearRequests(0), mClearCount(0)
+{
+}
+
+VectorQueue::~VectorQueue()
+{
+	radioVector *vec;
+
+	while ((vec = mRing.readNoBlock()))
+		vec->release();
+
+	while (mQ.size()) {
+		mQ.top()->release();
+		mQ.pop();
+	}
+}
 
-	while (mQ.size()==0)
-		mWriteSignal.wait(mLock);
+bool VectorQueue::write(radioVector *vec)
+{
+	return mRing.write(vec);
+}
 
-	retVal = mQ.top()->getTime();
-	mLock.unlock();
+void VectorQueue::clear()
+{
+	__sync_fetch_and_add(&mClearRequests, 1);
+}
 
-	return retVal;
+/* Move newly written bursts into the heap, servicing clear requests */
+void VectorQueue::drain()
+{
+	radioVector *vec;
+	unsigned requests = mClearRequests;
+
+	if (requests != mClearCount) {
+		mClearCount = requests;
+		while ((vec = mRing.readNoBlock()))
+			vec->release();
+		while (mQ.size()) {
+			mQ.top()->release();
+			mQ.pop();
+		}
+	}
+
+	while ((vec = mRing.readNoBlock()))
+		mQ.push(vec);
 }
 
 radioVector* VectorQueue::getStaleBurst(const GSM::Time& targTime)
 {
-	mLock.lock();
-	if ((mQ.size()==0)) {
-		mLock.unlock();
+	drain();
+
+	if (!mQ.size())
 		return NULL;
-	}
 
 	if (mQ.top()->getTime() < targTime) {
 		radioVector* retVal = mQ.top();
 		mQ.pop();
-		mLock.unlock();
 		return retVal;
 	}
-	mLock.unlock();
 
 	return NULL;
 }
 
 radioVector* VectorQueue::getCurrentBurst(const GSM::Time& targTime)
 {
-	mLock.lock();
-	if ((mQ.size()==0)) {
-		mLock.unlock();
+	drain();
+
+	if (!mQ.size())
 		return NULL;
-	}
 
 	if (mQ.top()->getTime() == targTime) {
 		radioVector* retVal = mQ.top();
 		mQ.pop();
-		mLock.unlock();
 		return retVal;
 	}
-	mLock.unlock();
 
 	return NULL;
 }
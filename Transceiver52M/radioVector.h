@@ -24,6 +24,9 @@
 
 #include "sigProcLib.h"
 #include "GSMCommon.h"
+#include "radioParams.h"
+
+class RadioVectorPool;
 
 class radioVector : public signalVector {
 public:
@@ -32,18 +35,126 @@ public:
 	void setTime(const GSM::Time& wTime);
 	bool operator>(const radioVector& other) const;
 
+	/** Return the burst to its pool, or delete it if not pooled */
+	void release();
+
 private:
 	GSM::Time mTime;
+	RadioVectorPool *mPool;        ///< owning pool, NULL if heap allocated
+
+	/** Pooled burst constructor */
+	radioVector(size_t wCapacity, RadioVectorPool *wPool);
+
+	friend class RadioVectorPool;
 };
 
-class VectorFIFO : public InterthreadQueue<radioVector> {
+/* Longest burst in samples, including the extended guard period */
+#define VECTOR_BURST_LEN	((gSlotLen + 9) * SAMPSPERSYM)
+
+/*
+ * Fixed pool of preallocated bursts
+ *
+ * Bursts are taken by the single thread that produces into a FIFO and
+ * returned through release() by the single thread that consumes from it,
+ * so the free list is a ring running in the opposite direction. When the
+ * pool is exhausted, or a burst exceeds the preallocated length, bursts
+ * fall back to the heap.
+ */
+class RadioVectorPool {
+public:
+	RadioVectorPool(int wNumVectors, size_t wVectorLen = VECTOR_BURST_LEN);
+	~RadioVectorPool();
+
+	/** Take a burst of length len, producer side only */
+	radioVector *get(size_t len, const GSM::Time& wTime);
+
+private:
+	InterthreadRing<radioVector> mFree;
+	radioVector **mVectors;
+	int mNumVectors;
+	size_t mVectorLen;
+
+	/** Return a burst, consumer side only */
+	void put(radioVector *vec);
+
+	friend class radioVector;
 };
 
-class VectorQueue : public InterthreadPriorityQueue<radioVector> {
+/* Receive FIFO depth in bursts, roughly two chunks of all timeslots */
+#define VECTOR_FIFO_LEN		32
+
+/*
+ * Receive burst FIFO with a private burst pool
+ *
+ * Single producer and single consumer. The producer must check full()
+ * before taking a burst with get() so that the write cannot fail and
+ * bursts are only ever released on the consumer side.
+ */
+class VectorFIFO {
 public:
-	GSM::Time nextTime() const;
+	VectorFIFO();
+	~VectorFIFO();
+
+	/** Producer side */
+	radioVector *get(size_t len, const GSM::Time& wTime)
+		{ return mPool.get(len, wTime); }
+	bool full() const { return mRing.size() >= mRing.capacity(); }
+	bool write(radioVector *vec) { return mRing.write(vec); }
+
+	/** Consumer side */
+	radioVector *readNoBlock() { return mRing.readNoBlock(); }
+	radioVector *read(unsigned timeout) { return mRing.read(timeout); }
+	void clear();
+
+	size_t size() const { return mRing.size(); }
+
+private:
+	RadioVectorPool mPool;
+	InterthreadRing<radioVector> mRing;
+};
+
+/* Transmit ring depth in bursts, drained by the transmit thread every timeslot */
+#define VECTOR_QUEUE_LEN	128
+
+/*
+ * Transmit burst queue ordered by burst time
+ *
+ * Bursts are written by a single transceiver thread into a lock-free ring
+ * and sorted into a heap that is private to the transmit thread, so
+ * neither side takes a lock. All methods other than write() and clear()
+ * must only be called from the transmit thread.
+ */
+class VectorQueue {
+public:
+	VectorQueue();
+	~VectorQueue();
+
+	/** Take a pooled burst, check full() first so the write cannot fail */
+	radioVector *get(size_t len, const GSM::Time& wTime)
+		{ return mPool.get(len, wTime); }
+	bool full() const { return mRing.size() >= mRing.capacity(); }
+
+	/** Add a burst, returns false if the queue is full */
+	bool write(radioVector *vec);
+
+	/** Request that all queued bursts be dropped by the consumer */
+	void clear();
+
 	radioVector* getStaleBurst(const GSM::Time& targTime);
 	radioVector* getCurrentBurst(const GSM::Time& targTime);
+
+private:
+	typedef std::priority_queue<radioVector*, std::vector<radioVector*>,
+				    PointerCompare<radioVector> > BurstHeap;
+
+	RadioVectorPool mPool;
+	InterthreadRing<radioVector> mRing;
+	BurstHeap mQ;
+
+	volatile unsigned mClearRequests;
+	unsigned mClearCount;
+
+	void drain();
 };
 
 #endif /* RADIOVECTOR_H */
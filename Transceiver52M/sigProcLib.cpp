@@ -32,6 +32,9 @@
 #include "rcvLPF_651.h"
 
 #include <Logger.h>
+#include <Threads.h>
+
+#include "sigproc/sigproc.h"
 
 #define TABLESIZE 1024
 
@@ -48,6 +51,14 @@ static const float M_1_2PI_F = 1/M_2PI_F;
 signalVector *GMSKRotation = NULL;
 signalVector *GMSKReverseRotation = NULL;
 
+/**
+  Static modulator table of shaped symbol blocks indexed by the phase
+  quadrant and the three symbol window around each symbol, along with the
+  pulse that the table was built from
+*/
+signalVector *GMSKModTable = NULL;
+signalVector *GMSKModPulse = NULL;
+
 /** Static ideal RACH and midamble correlation waveforms */
 typedef struct {
   signalVector *sequence;
@@ -59,7 +70,33 @@ typedef struct {
 CorrelationSequence *gMidambles[] = {NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL};
 CorrelationSequence *gRACHSequence = NULL;
 
+/** Number of setup calls not yet matched by a destroy, one per drive loop */
+static int sigProcLibUsers = 0;
+
+/**
+  Scratch shared by the allocating wrappers, one workspace per oversampling
+  rate created on first use and guarded by a lock held for the whole call
+*/
+#define SHARED_WORKSPACE_SPS 8
+
+static DemodWorkspace *sharedWorkspaces[SHARED_WORKSPACE_SPS + 1];
+static Mutex sharedWorkspaceLock;
+
 void sigProcLibDestroy(void) {
+  if ((sigProcLibUsers > 0) && --sigProcLibUsers)
+    return;
+
+  sharedWorkspaceLock.lock();
+  for (int i = 0; i <= SHARED_WORKSPACE_SPS; i++) {
+    delete sharedWorkspaces[i];
+    sharedWorkspaces[i] = NULL;
+  }
+  sharedWorkspaceLock.unlock();
+
+  delete GMSKModTable;
+  delete GMSKModPulse;
+  GMSKModTable = NULL;
+  GMSKModPulse = NULL;
   if (GMSKRotation) {
     delete GMSKRotation;
     GMSKRotation = NULL;
@@ -227,9 +264,58 @@ void initGMSKRotationTables(int samplesPerSymbol) {
   }
 }
 
+/* Ternary symbol states of the modulator window, zero is a guard symbol */
+#define MOD_SYM_STATES		3
+#define MOD_WINDOW_STATES	(MOD_SYM_STATES * MOD_SYM_STATES * MOD_SYM_STATES)
+
+/*
+ * The shaping pulse spans two symbols, so each block of samplesPerSymbol
+ * output samples only depends on the previous, current and next symbol.
+ * Symbol n is rotated by j^n, so the quadrant of n fixes the rotation of
+ * the whole window. Tabulate every block once instead of rotating and
+ * convolving every burst.
+ */
+void initGMSKModTable(int samplesPerSymbol) {
+  static const complex quadrant[4] = {
+    complex(1.0, 0.0), complex(0.0, 1.0), complex(-1.0, 0.0), complex(0.0, -1.0)
+  };
+
+  delete GMSKModTable;
+  delete GMSKModPulse;
+
+  GMSKModPulse = generateGSMPulse(2, samplesPerSymbol);
+  GMSKModTable = new signalVector(4 * MOD_WINDOW_STATES * samplesPerSymbol);
+
+  const signalVector &p = *GMSKModPulse;
+  signalVector::iterator tablePtr = GMSKModTable->begin();
+
+  for (int q = 0; q < 4; q++) {
+    for (int w = 0; w < MOD_WINDOW_STATES; w++) {
+      float prev = (float) (w / (MOD_SYM_STATES * MOD_SYM_STATES) - 1);
+      float cur = (float) ((w / MOD_SYM_STATES) % MOD_SYM_STATES - 1);
+      float next = (float) (w % MOD_SYM_STATES - 1);
+
+      // same tap alignment as the NO_DELAY convolution of the symbols
+      for (int r = 0; r < samplesPerSymbol; r++) {
+        complex val = quadrant[(q + 1) % 4] * (next * p[r].real()) +
+                      quadrant[q] * (cur * p[r + samplesPerSymbol].real());
+        if (r == 0)
+          val += quadrant[(q + 3) % 4] * (prev * p[2 * samplesPerSymbol].real());
+        *tablePtr++ = val;
+      }
+    }
+  }
+}
+
 void sigProcLibSetup(int samplesPerSymbol) {
+  // tables are shared, later users must share the same oversampling
+  if (sigProcLibUsers++)
+    return;
+
+  convolve_init();
   initTrigTables();
   initGMSKRotationTables(samplesPerSymbol);
+  initGMSKModTable(samplesPerSymbol);
 }
 
 void GMSKRotate(signalVector &x) {
@@ -267,170 +353,221 @@ void GMSKReverseRotate(signalVector &x) {
 }
 
 
-signalVector* convolve(const signalVector *a,
-		       const signalVector *b,
-		       signalVector *c,
-		       ConvType spanType,
-		       unsigned startIx,
-		       unsigned len)
+/*
+ * Output span of a convolution type for input and tap lengths. Output index
+ * zero corresponds to index 'startIndex' of the full convolution.
+ */
+static bool convolveSpan(ConvType spanType, int La, int Lb,
+			 unsigned startIx, unsigned len,
+			 int *startIndex, unsigned *outSize)
 {
-  if ((a==NULL) || (b==NULL)) return NULL; 
-  int La = a->size();
-  int Lb = b->size();
-
-  int startIndex;
-  unsigned int outSize;
   switch (spanType) {
     case FULL_SPAN:
-      startIndex = 0;
-      outSize = La+Lb-1;
+      *startIndex = 0;
+      *outSize = La+Lb-1;
       break;
     case OVERLAP_ONLY:
-      startIndex = La;
-      outSize = abs(La-Lb)+1;
+      *startIndex = La;
+      *outSize = abs(La-Lb)+1;
       break;
     case START_ONLY:
-      startIndex = 0;
-      outSize = La;
+      *startIndex = 0;
+      *outSize = La;
       break;
     case WITH_TAIL:
-      startIndex = Lb;
-      outSize = La;
+      *startIndex = Lb;
+      *outSize = La;
       break;
     case NO_DELAY:
       if (Lb % 2) 
-	startIndex = Lb/2;
+	*startIndex = Lb/2;
       else
-	startIndex = Lb/2-1;
-      outSize = La;
+	*startIndex = Lb/2-1;
+      *outSize = La;
       break;
     case CUSTOM:
-      startIndex = startIx;
-      outSize = len;
+      *startIndex = startIx;
+      *outSize = len;
       break;
     default:
+      return false;
+  }
+
+  return true;
+}
+
+/*
+ * Reset a reusable convolution buffer to len samples, including start
+ * samples of headroom, reallocating only if the buffer is too small.
+ * Returns NULL, leaving no buffer, if the allocation fails.
+ */
+static struct cxvec *scratchVector(struct cxvec **vec,
+				   int len, int start, int flags)
+{
+  if (!*vec || ((*vec)->buf_len < len)) {
+    if (*vec)
+      cxvec_free(*vec);
+    *vec = cxvec_alloc(len, start, NULL, flags);
+    if (!*vec)
       return NULL;
   }
 
-  
+  (*vec)->flags = flags;
+  (*vec)->start_idx = start;
+  (*vec)->data = (*vec)->buf + start;
+  (*vec)->len = len - start;
+
+  return *vec;
+}
+
+/* Grow a scratch signal vector to at least len samples */
+static complex *scratchVector(signalVector &vec, size_t len)
+{
+  if (vec.size() < len)
+    vec.resize(len);
+
+  return vec.begin();
+}
+
+/*
+ * Run a convolution through the libsigproc kernels. Taps are passed in
+ * kernel order, which is reversed. The input is copied into a buffer with
+ * zeroed headroom and tail so that every output in the requested span reads
+ * valid memory, which matches the implicit zero extension of the input at
+ * both ends. If realInput is set, imaginary input components are ignored.
+ * An optional scratch vector holds the input buffer across calls.
+ */
+static signalVector *convolveTaps(const signalVector *a,
+				  struct cxvec *h,
+				  bool realInput,
+				  signalVector *c,
+				  ConvType spanType,
+				  unsigned startIx,
+				  unsigned len,
+				  struct cxvec **scratch = NULL)
+{
+  if (!h)
+    return NULL;
+
+  int La = a->size();
+  int Lb = h->len;
+  int startIndex;
+  unsigned outSize;
+
+  if (!convolveSpan(spanType, La, Lb, startIx, len, &startIndex, &outSize))
+    return NULL;
+
   if (c==NULL)
     c = new signalVector(outSize);
   else if (c->size()!=outSize)
     return NULL;
 
-  signalVector::const_iterator aStart = a->begin();
-  signalVector::const_iterator bStart = b->begin();
-  signalVector::const_iterator aEnd = a->end();
-  signalVector::const_iterator bEnd = b->end();
-  signalVector::iterator cPtr = c->begin();
-  int t = startIndex;
-  int stopIndex = startIndex + outSize;
+  if (!outSize) return c;
+  if (!La) {
+    c->fill(0.0);
+    return c;
+  }
+
+  int headroom = Lb-1;
+  int dataLen = startIndex + (int) outSize;
+  if (dataLen < La) dataLen = La;
+  struct cxvec *in;
+  if (scratch)
+    in = scratchVector(scratch, headroom + dataLen, headroom, 0);
+  else
+    in = cxvec_alloc(headroom + dataLen, headroom, NULL, 0);
+  if (!in) {
+    LOG(ERR) << "Failed to allocate convolution buffer";
+    return NULL;
+  }
+
+  const complex *aP = a->begin();
+  cmplx *x = in->data;
+  memset(in->buf, 0, headroom * sizeof(cmplx));
+  if (realInput) {
+    for (int i = 0; i < La; i++) {
+      x[i].real = aP[i].real();
+      x[i].imag = 0.0f;
+    }
+  }
+  else {
+    memcpy(x, aP, La * sizeof(cmplx));
+  }
+  memset(&x[La], 0, (dataLen - La) * sizeof(cmplx));
+
+  struct cxvec out;
+  in->data += startIndex;
+  in->len = outSize;
+  cxvec_init(&out, outSize, outSize, 0, (cmplx *) c->begin(), 0);
+
+  cxvec_convolve(in, h, &out);
+
+  if (!scratch)
+    cxvec_free(in);
+
+  return c;
+}
+
+signalVector* convolve(const signalVector *a,
+		       const signalVector *b,
+		       signalVector *c,
+		       ConvType spanType,
+		       unsigned startIx,
+		       unsigned len)
+{
+  if ((a==NULL) || (b==NULL)) return NULL; 
+  int Lb = b->size();
+
+  if (!Lb) {
+    int startIndex;
+    unsigned outSize;
+    if (!convolveSpan(spanType, a->size(), Lb, startIx, len,
+                      &startIndex, &outSize))
+      return NULL;
+    if (c==NULL)
+      c = new signalVector(outSize);
+    else if (c->size()!=outSize)
+      return NULL;
+    c->fill(0.0);
+    return c;
+  }
+
+  /*
+   * Taps are aligned and reversed for the kernels. Symmetric taps only
+   * define the leading half, which is mirrored into the trailing half.
+   * Real valued taps and inputs select complex-real multiplication and
+   * drop imaginary components. Symmetric convolution always uses
+   * complex input.
+   */
+  int flags = CXVEC_FLG_MEM_ALIGN;
+  if (b->isRealOnly()) flags |= CXVEC_FLG_REAL_ONLY;
+
+  struct cxvec *h = cxvec_alloc(Lb, 0, NULL, flags);
+  if (!h)
+    return NULL;
+  const complex *bP = b->begin();
+  bool realInput = false;
+
   switch (b->getSymmetry()) {
   case NONE:
-    {
-      while (t < stopIndex) {
-	signalVector::const_iterator aP = aStart+t;
-	signalVector::const_iterator bP = bStart;
-	if (a->isRealOnly() && b->isRealOnly()) {
-	  float sum = 0.0;
-	  while (bP < bEnd) {
-	    if (aP < aStart) break;
-	    if (aP < aEnd) sum += (aP->real())*(bP->real());
-	    aP--;
-	    bP++;
-	  }
-	  *cPtr++ = sum;
-	}
-	else if (a->isRealOnly()) {
-	  complex sum = 0.0;
-	  while (bP < bEnd) {
-	    if (aP < aStart) break;
-	    if (aP < aEnd) sum += (*bP)*(aP->real());
-	    aP--;
-	    bP++;
-	  }
-	  *cPtr++ = sum;
-	}
-	else if (b->isRealOnly()) {
-	  complex sum = 0.0;
-	  while (bP < bEnd) {
-	    if (aP < aStart) break;
-	    if (aP < aEnd) sum += (*aP)*(bP->real());
-	    aP--;
-	    bP++;
-	  }
-	  *cPtr++ = sum;
-	}
-	else {
-	  complex sum = 0.0;
-	  while (bP < bEnd) {
-	    if (aP < aStart) break;
-	    if (aP < aEnd) sum += (*aP)*(*bP);
-	    aP--;
-	    bP++;
-	  }
-	  *cPtr++ = sum;
-	}
-	t++;
-      }
-    }
+    for (int i = 0; i < Lb; i++)
+      h->data[i] = *(const cmplx *) &bP[Lb-1-i];
+    realInput = a->isRealOnly();
     break;
   case ABSSYM:
-    {
-      complex sum = 0.0;
-      bool isOdd = (bool) (Lb % 2);
-      if (isOdd) 
-	bEnd = bStart + (Lb+1)/2;
-      else 
-	bEnd = bStart + Lb/2;
-      while (t < stopIndex) {
-	signalVector::const_iterator aP = aStart+t;
-	signalVector::const_iterator aPsym = aP-Lb+1;
-	signalVector::const_iterator bP = bStart;
-	sum = 0.0;
-        if (!b->isRealOnly()) {
-	  while (bP < bEnd) {
-	    if (aP < aStart) break;
-	    if (aP == aPsym)
-	      sum+= (*aP)*(*bP);
-	    else if ((aP < aEnd) && (aPsym >= aStart)) 
-	      sum+= ((*aP)+(*aPsym))*(*bP);
-	    else if (aP < aEnd)
-	      sum += (*aP)*(*bP);
-	    else if (aPsym >= aStart)
-	      sum += (*aPsym)*(*bP);
-	    aP--;
-	    aPsym++;
-	    bP++;
-	  }
-        }
-        else {
-          while (bP < bEnd) {
-            if (aP < aStart) break;
-            if (aP == aPsym)
-              sum+= (*aP)*(bP->real());
-            else if ((aP < aEnd) && (aPsym >= aStart))
-              sum+= ((*aP)+(*aPsym))*(bP->real());
-            else if (aP < aEnd)
-              sum += (*aP)*(bP->real());
-            else if (aPsym >= aStart)
-              sum += (*aPsym)*(bP->real());
-            aP--;
-            aPsym++;
-            bP++;
-          }
-        }
-	*cPtr++ = sum;
-	t++;
-      }
+    for (int i = 0; i < (Lb+1)/2; i++) {
+      h->data[i] = *(const cmplx *) &bP[i];
+      h->data[Lb-1-i] = *(const cmplx *) &bP[i];
     }
     break;
   default:
+    cxvec_free(h);
     return NULL;
-    break;
   }
-    
-    
+
+  c = convolveTaps(a, h, realInput, c, spanType, startIx, len);
+  cxvec_free(h);
+
   return c;
 }
 
@@ -529,22 +666,138 @@ signalVector* correlate(signalVector *a,
 		        unsigned startIx,
 			unsigned len)
 {
-  signalVector *tmp = NULL;
+  if (bReversedConjugated || !a || !b || !b->size())
+    return convolve(a,b,c,spanType,startIx,len);
+
+  /*
+   * Reversal of the conjugated sequence cancels with the reversal into
+   * kernel order, so load conjugated taps directly in sequence order.
+   */
+  int Lb = b->size();
+  int flags = CXVEC_FLG_MEM_ALIGN;
+  if (b->isRealOnly()) flags |= CXVEC_FLG_REAL_ONLY;
 
-  if (!bReversedConjugated) {
-    tmp = reverseConjugate(b);
+  struct cxvec *h = cxvec_alloc(Lb, 0, NULL, flags);
+  if (!h)
+    return NULL;
+  signalVector::iterator bP = b->begin();
+  for (int i = 0; i < Lb; i++) {
+    h->data[i].real = bP[i].real();
+    h->data[i].imag = b->isRealOnly() ? 0.0f : -bP[i].imag();
   }
-  else {
-    tmp = b;
+
+  c = convolveTaps(a,h,a->isRealOnly(),c,spanType,startIx,len);
+  cxvec_free(h);
+
+  return c;
+}
+
+DemodWorkspace::DemodWorkspace(int samplesPerSymbol)
+  : input(NULL), taps(NULL), mlse(NULL)
+{
+  // full burst with tail, longest taps are the oversampled RACH sequence
+  int burstLen = (gSlotLen + 9) * samplesPerSymbol;
+  int tapsLen = 64 * samplesPerSymbol;
+
+  corr.resize(burstLen);
+  shift.resize(burstLen);
+  chan.resize(6 * samplesPerSymbol);
+  filtered.resize(burstLen);
+
+  scratchVector(&input, 2 * tapsLen + burstLen, tapsLen, 0);
+  scratchVector(&taps, tapsLen, 0, CXVEC_FLG_MEM_ALIGN);
+  mlse = mlse_alloc(gSlotLen + 9);
+}
+
+DemodWorkspace::~DemodWorkspace()
+{
+  if (input) cxvec_free(input);
+  if (taps) cxvec_free(taps);
+  mlse_free(mlse);
+}
+
+/*
+ * Locked access to the shared workspace for an oversampling rate, rates
+ * outside of the shared range get a workspace of their own.
+ */
+class SharedWorkspace {
+
+ public:
+
+  SharedWorkspace(int samplesPerSymbol)
+    : mLock(sharedWorkspaceLock), mLocal(NULL)
+  {
+    if ((samplesPerSymbol < 1) || (samplesPerSymbol > SHARED_WORKSPACE_SPS)) {
+      mLocal = new DemodWorkspace(samplesPerSymbol);
+      mWorkspace = mLocal;
+      return;
+    }
+
+    if (!sharedWorkspaces[samplesPerSymbol])
+      sharedWorkspaces[samplesPerSymbol] =
+        new DemodWorkspace(samplesPerSymbol);
+    mWorkspace = sharedWorkspaces[samplesPerSymbol];
   }
 
-  c = convolve(a,tmp,c,spanType,startIx,len);
+  ~SharedWorkspace() { delete mLocal; }
 
-  if (!bReversedConjugated) delete tmp;
+  operator DemodWorkspace &() { return *mWorkspace; }
 
-  return c;
+ private:
+
+  ScopedLock mLock;
+  DemodWorkspace *mLocal;
+  DemodWorkspace *mWorkspace;
+
+  SharedWorkspace(const SharedWorkspace &);
+  SharedWorkspace &operator=(const SharedWorkspace &);
+};
+
+/* Load unsymmetric taps in kernel order into the workspace */
+static struct cxvec *workspaceTaps(const signalVector &b, DemodWorkspace &ws)
+{
+  int Lb = b.size();
+  int flags = CXVEC_FLG_MEM_ALIGN;
+  if (b.isRealOnly()) flags |= CXVEC_FLG_REAL_ONLY;
+
+  struct cxvec *h = scratchVector(&ws.taps, Lb, 0, flags);
+  if (!h)
+    return NULL;
+  const complex *bP = b.begin();
+  for (int i = 0; i < Lb; i++)
+    h->data[i] = *(const cmplx *) &bP[Lb-1-i];
+
+  return h;
 }
 
+/* Correlate against a reversed and conjugated sequence without allocating */
+static signalVector *correlate(signalVector *a,
+			       signalVector *bReversedConjugated,
+			       signalVector *c,
+			       ConvType spanType,
+			       unsigned startIx,
+			       unsigned len,
+			       DemodWorkspace &ws)
+{
+  if (!bReversedConjugated->size() ||
+      (bReversedConjugated->getSymmetry() != NONE))
+    return NULL;
+
+  struct cxvec *h = workspaceTaps(*bReversedConjugated, ws);
+
+  return convolveTaps(a, h, a->isRealOnly(), c, spanType,
+		      startIx, len, &ws.input);
+}
+
+
+/* map a real sample in [-1,1] to a soft bit in [0,1] */
+static inline float softSlice(float x)
+{
+  float v = 0.5*(x+1.0F);
+  if (v > 1.0) return 1.0;
+  if (v < 0.0) return 0.0;
+  return v;
+}
 
 /* soft output slicer */
 bool vectorSlicer(signalVector *x) 
@@ -553,19 +806,62 @@ bool vectorSlicer(signalVector *x)
   signalVector::iterator xP = x->begin();
   signalVector::iterator xPEnd = x->end();
   while (xP < xPEnd) {
-    *xP = (complex) (0.5*(xP->real()+1.0F));
-    if (xP->real() > 1.0) *xP = 1.0;
-    if (xP->real() < 0.0) *xP = 0.0;
+    *xP = softSlice(xP->real());
     xP++;
   }
   return true;
 }
   
+/* Check that the modulator table was built for a pulse */
+static bool modTableMatches(const signalVector &gsmPulse, int samplesPerSymbol)
+{
+  if (!GMSKModTable || (gsmPulse.size() != GMSKModPulse->size()) ||
+      (gsmPulse.size() != (size_t) (2 * samplesPerSymbol + 1)))
+    return false;
+
+  return !memcmp(gsmPulse.begin(), GMSKModPulse->begin(),
+                 gsmPulse.size() * sizeof(complex));
+}
+
+/* Table driven modulator, copies one shaped block per symbol */
+static signalVector *modulateBurstTable(const BitVector &wBurst,
+                                        int guardPeriodLength,
+                                        int samplesPerSymbol)
+{
+  int numSymbols = wBurst.size() + guardPeriodLength;
+  int numBits = wBurst.size();
+  signalVector *shapedBurst = new signalVector(numSymbols * samplesPerSymbol);
+
+  const complex *table = GMSKModTable->begin();
+  complex *out = shapedBurst->begin();
+
+  // symbol states are -1, 0 and +1 offset by one
+  int prev = 1;
+  int cur = numBits ? 2 * (wBurst[0] & 0x01) : 1;
+
+  for (int n = 0; n < numSymbols; n++) {
+    int next = (n + 1 < numBits) ? 2 * (wBurst[n + 1] & 0x01) : 1;
+    int index = (n & 0x03) * MOD_WINDOW_STATES +
+                (prev * MOD_SYM_STATES + cur) * MOD_SYM_STATES + next;
+
+    const complex *block = &table[index * samplesPerSymbol];
+    for (int i = 0; i < samplesPerSymbol; i++)
+      *out++ = block[i];
+
+    prev = cur;
+    cur = next;
+  }
+
+  return shapedBurst;
+}
+
 signalVector *modulateBurst(const BitVector &wBurst,
 			    const signalVector &gsmPulse,
 			    int guardPeriodLength,
 			    int samplesPerSymbol)
 {
+  if (modTableMatches(gsmPulse, samplesPerSymbol))
+    return modulateBurstTable(wBurst, guardPeriodLength, samplesPerSymbol);
 
   //static complex staticBurst[157];
 
@@ -617,27 +913,10 @@ float sinc(float x)
   return 1.0F;
 }
 
-void delayVector(signalVector &wBurst,
-		 float delay)
+/* Shift a vector in place by whole samples with zero fill */
+static void shiftVector(signalVector &wBurst,
+			int intOffset)
 {
-  
-  int   intOffset = (int) floor(delay);
-  float fracOffset = delay - intOffset;
-  
-  // do fractional shift first, only do it for reasonable offsets
-  if (fabs(fracOffset) > 1e-2) {
-    // create sinc function
-    signalVector sincVector(21); 
-    sincVector.isRealOnly(true);
-    signalVector::iterator sincBurstItr = sincVector.begin();
-    for (int i = 0; i < 21; i++) 
-      *sincBurstItr++ = (complex) sinc(M_PI_F*(i-10-fracOffset));
-  
-    signalVector shiftedBurst(wBurst.size());
-    convolve(&wBurst,&sincVector,&shiftedBurst,NO_DELAY);
-    wBurst.clone(shiftedBurst);
-  }
-
   if (intOffset < 0) {
     intOffset = -intOffset;
     signalVector::iterator wBurstItr = wBurst.begin();
@@ -656,6 +935,50 @@ void delayVector(signalVector &wBurst,
       *wBurstItr-- = 0.0;
   }
 }
+
+void delayVector(signalVector &wBurst,
+		 float delay)
+{
+  int intOffset = (int) floor(delay);
+
+  if (fabs(delay - intOffset) > 1e-2) {
+    SharedWorkspace ws(1);
+    delayVector(wBurst, delay, ws);
+  }
+  else {
+    shiftVector(wBurst, intOffset);
+  }
+}
+
+void delayVector(signalVector &wBurst,
+		 float delay,
+		 DemodWorkspace &ws)
+{
+  int   intOffset = (int) floor(delay);
+  float fracOffset = delay - intOffset;
+  
+  // do fractional shift first, only do it for reasonable offsets
+  if (fabs(fracOffset) > 1e-2) {
+    // 21 tap real sinc loaded directly in kernel order
+    struct cxvec *h = scratchVector(&ws.taps, 21, 0,
+				    CXVEC_FLG_MEM_ALIGN | CXVEC_FLG_REAL_ONLY);
+    if (!h)
+      return;
+    for (int i = 0; i < 21; i++) {
+      h->data[20-i].real = sinc(M_PI_F*(i-10-fracOffset));
+      h->data[20-i].imag = 0.0f;
+    }
+
+    size_t len = wBurst.size();
+    signalVector shiftedBurst(scratchVector(ws.shift, len), 0, len);
+    if (!convolveTaps(&wBurst, h, wBurst.isRealOnly(), &shiftedBurst,
+		      NO_DELAY, 0, 0, &ws.input))
+      return;
+    shiftedBurst.copyTo(wBurst);
+  }
+
+  shiftVector(wBurst, intOffset);
+}
   
 signalVector *gaussianNoise(int length, 
 			    float variance, 
@@ -930,17 +1253,28 @@ bool detectRACHBurst(signalVector &rxBurst,
 		     complex *amplitude,
 		     float* TOA)
 {
+  SharedWorkspace ws(samplesPerSymbol);
 
-  //static complex staticData[500];
- 
-  //signalVector correlatedRACH(staticData,0,rxBurst.size());
-  signalVector correlatedRACH(rxBurst.size());
-  correlate(&rxBurst,gRACHSequence->sequenceReversedConjugated,&correlatedRACH,NO_DELAY,true);
+  return detectRACHBurst(rxBurst, detectThreshold, samplesPerSymbol,
+                         amplitude, TOA, ws);
+}
 
+/*
+ * Peak detection and peak-to-mean test on a RACH correlation, the valley
+ * power is measured after the correlation peak.
+ */
+static bool detectRACHPeak(signalVector &correlatedRACH,
+			   float detectThreshold,
+			   int samplesPerSymbol,
+			   complex *amplitude,
+			   float *TOA,
+			   float *peakToMean)
+{
   float meanPower;
   complex peakAmpl = peakDetect(correlatedRACH,TOA,&meanPower);
 
   float valleyPower = 0.0; 
+  *peakToMean = 0.0;
 
   // check for bogus results
   if ((*TOA < 0.0) || (*TOA > correlatedRACH.size())) {
@@ -965,16 +1299,212 @@ bool detectRACHBurst(signalVector &rxBurst,
   }
 
   float RMS = sqrtf(valleyPower/(float) numSamples)+0.00001;
-  float peakToMean = peakAmpl.abs()/RMS;
+  *peakToMean = peakAmpl.abs()/RMS;
 
-  LOG(DEBUG) << "RACH peakAmpl=" << peakAmpl << " RMS=" << RMS << " peakToMean=" << peakToMean;
+  LOG(DEBUG) << "RACH peakAmpl=" << peakAmpl << " RMS=" << RMS << " peakToMean=" << *peakToMean;
   *amplitude = peakAmpl/(gRACHSequence->gain);
 
   *TOA = (*TOA) - gRACHSequence->TOA - 8*samplesPerSymbol;
 
-  LOG(DEBUG) << "RACH thresh: " << peakToMean;
+  LOG(DEBUG) << "RACH thresh: " << *peakToMean;
 
-  return (peakToMean > detectThreshold);
+  return (*peakToMean > detectThreshold);
+}
+
+bool detectRACHBurst(signalVector &rxBurst,
+		     float detectThreshold,
+		     int samplesPerSymbol,
+		     complex *amplitude,
+		     float* TOA,
+		     DemodWorkspace &ws)
+{
+  size_t corrLen = rxBurst.size();
+  signalVector correlatedRACH(scratchVector(ws.corr, corrLen), 0, corrLen);
+  if (!correlate(&rxBurst,gRACHSequence->sequenceReversedConjugated,&correlatedRACH,NO_DELAY,0,0,ws))
+    return false;
+
+  float peakToMean;
+
+  return detectRACHPeak(correlatedRACH, detectThreshold, samplesPerSymbol,
+                        amplitude, TOA, &peakToMean);
+}
+
+RACHBatch::RACHBatch(int maxBursts, int samplesPerSymbol)
+  : mNumBursts(0), mSamplesPerSymbol(samplesPerSymbol),
+    mSpectrum(NULL), mHaveSpectrum(false)
+{
+  int i;
+
+  if (maxBursts < 1)
+    maxBursts = 1;
+  mMaxBursts = maxBursts;
+
+  // full burst with tail against the oversampled RACH sequence
+  int burstLen = (gSlotLen + 9) * samplesPerSymbol;
+  int seqLen = gRACHSynchSequence.size() * samplesPerSymbol;
+
+  mFFTLen = 1;
+  while (mFFTLen < burstLen + seqLen - 1)
+    mFFTLen <<= 1;
+  mMaxLen = mFFTLen - seqLen + 1;
+
+  mBuf = cxvec_alloc(mFFTLen * mMaxBursts, 0, NULL, CXVEC_FLG_MEM_ALIGN);
+  mSpectrum = cxvec_alloc(mFFTLen, 0, NULL, CXVEC_FLG_MEM_ALIGN);
+
+  mNumPlans = 1;
+  while ((1 << (mNumPlans - 1)) < mMaxBursts)
+    mNumPlans++;
+
+  mForward = new struct fft_hdl *[mNumPlans];
+  mInverse = new struct fft_hdl *[mNumPlans];
+  for (i = 0; i < mNumPlans; i++) {
+    int howmany = 1 << i;
+    if (howmany > mMaxBursts) howmany = mMaxBursts;
+
+    mForward[i] = init_fft_batch(0, mFFTLen, howmany,
+				 mBuf->data, 1, mFFTLen);
+    mInverse[i] = init_fft_batch(1, mFFTLen, howmany,
+				 mBuf->data, 1, mFFTLen);
+    assert(mForward[i] && mInverse[i]);
+  }
+
+  mLens = new int[mMaxBursts];
+  mResults = new RACHResult[mMaxBursts];
+}
+
+RACHBatch::~RACHBatch()
+{
+  for (int i = 0; i < mNumPlans; i++) {
+    free_fft(mForward[i]);
+    free_fft(mInverse[i]);
+  }
+
+  delete[] mForward;
+  delete[] mInverse;
+  delete[] mLens;
+  delete[] mResults;
+
+  cxvec_free(mBuf);
+  cxvec_free(mSpectrum);
+}
+
+/* Smallest plan that covers the first 'bursts' slots of the buffer */
+int RACHBatch::plan(int bursts) const
+{
+  int i = 0;
+
+  while ((1 << i) < bursts)
+    i++;
+
+  return i;
+}
+
+/*
+ * Transform the reversed conjugated RACH sequence once through the first
+ * buffer slot. The inverse FFT scaling is folded into the cached spectrum.
+ */
+bool RACHBatch::loadSpectrum()
+{
+  if (!gRACHSequence)
+    return false;
+
+  signalVector *seq = gRACHSequence->sequenceReversedConjugated;
+  int Lb = seq->size();
+  if (Lb > mFFTLen - mMaxLen + 1) {
+    LOG(ERR) << "RACH sequence too long for batch FFT length " << mFFTLen;
+    return false;
+  }
+
+  cmplx *x = mBuf->data;
+  const complex *seqP = seq->begin();
+  for (int i = 0; i < Lb; i++) {
+    x[i].real = seqP[i].real();
+    x[i].imag = seq->isRealOnly() ? 0.0f : seqP[i].imag();
+  }
+  memset(&x[Lb], 0, (mFFTLen - Lb) * sizeof(cmplx));
+
+  fft_batch_execute(mForward[0]);
+
+  float scale = 1.0f / mFFTLen;
+  for (int i = 0; i < mFFTLen; i++) {
+    mSpectrum->data[i].real = x[i].real * scale;
+    mSpectrum->data[i].imag = x[i].imag * scale;
+  }
+
+  mHaveSpectrum = true;
+
+  return true;
+}
+
+int RACHBatch::add(const signalVector &rxBurst)
+{
+  int La = rxBurst.size();
+
+  if ((mNumBursts >= mMaxBursts) || (La > mMaxLen))
+    return -1;
+
+  // the first slot is free while the batch is empty
+  if (!mHaveSpectrum && (mNumBursts || !loadSpectrum()))
+    return -1;
+
+  cmplx *x = mBuf->data + mNumBursts * mFFTLen;
+  const complex *aP = rxBurst.begin();
+  if (rxBurst.isRealOnly()) {
+    for (int i = 0; i < La; i++) {
+      x[i].real = aP[i].real();
+      x[i].imag = 0.0f;
+    }
+  }
+  else {
+    memcpy(x, aP, La * sizeof(cmplx));
+  }
+  memset(&x[La], 0, (mFFTLen - La) * sizeof(cmplx));
+
+  mLens[mNumBursts] = La;
+
+  return mNumBursts++;
+}
+
+int RACHBatch::detect(float detectThreshold)
+{
+  int i, n, count = 0;
+
+  if (!mNumBursts)
+    return 0;
+
+  int p = plan(mNumBursts);
+  fft_batch_execute(mForward[p]);
+
+  const cmplx *h = mSpectrum->data;
+  for (i = 0; i < mNumBursts; i++) {
+    cmplx *x = mBuf->data + i * mFFTLen;
+    for (n = 0; n < mFFTLen; n++) {
+      float re = x[n].real * h[n].real - x[n].imag * h[n].imag;
+      float im = x[n].real * h[n].imag + x[n].imag * h[n].real;
+      x[n].real = re;
+      x[n].imag = im;
+    }
+  }
+
+  fft_batch_execute(mInverse[p]);
+
+  // same output alignment as the NO_DELAY time domain correlation
+  int Lb = gRACHSequence->sequenceReversedConjugated->size();
+  int startIndex = (Lb % 2) ? Lb/2 : Lb/2-1;
+
+  for (i = 0; i < mNumBursts; i++) {
+    RACHResult *res = &mResults[i];
+    complex *corrP = (complex *) (mBuf->data + i * mFFTLen + startIndex);
+    signalVector correlatedRACH(corrP, 0, mLens[i]);
+
+    res->detected = detectRACHPeak(correlatedRACH, detectThreshold,
+                                   mSamplesPerSymbol, &res->amplitude,
+                                   &res->TOA, &res->peakToMean);
+    if (res->detected)
+      count++;
+  }
+
+  return count;
 }
 
 bool energyDetect(signalVector &rxBurst,
@@ -1008,11 +1538,41 @@ bool analyzeTrafficBurst(signalVector &rxBurst,
                          signalVector **channelResponse,
 			 float *channelResponseOffset) 
 {
+  SharedWorkspace ws(samplesPerSymbol);
+  signalVector *chan = NULL;
+
+  if (requestChannel)
+    chan = new signalVector(6*samplesPerSymbol);
+
+  bool detected = analyzeTrafficBurst(rxBurst, TSC, detectThreshold,
+                                      samplesPerSymbol, amplitude, TOA,
+                                      maxTOA, chan, channelResponseOffset, ws);
+  if (chan && detected)
+    *channelResponse = chan;
+  else
+    delete chan;
+
+  return detected;
+}
+
+bool analyzeTrafficBurst(signalVector &rxBurst,
+			 unsigned TSC,
+			 float detectThreshold,
+			 int samplesPerSymbol,
+			 complex *amplitude,
+			 float *TOA,
+			 unsigned maxTOA,
+			 signalVector *channelResponse,
+			 float *channelResponseOffset,
+			 DemodWorkspace &ws)
+{
 
   assert(TSC<8);
   assert(amplitude);
   assert(TOA);
   assert(gMidambles[TSC]);
+  assert(!channelResponse ||
+         (channelResponse->size() == (size_t) 6*samplesPerSymbol));
 
   if (maxTOA < 3*samplesPerSymbol) maxTOA = 3*samplesPerSymbol;
   unsigned spanTOA = maxTOA;
@@ -1027,12 +1587,14 @@ bool analyzeTrafficBurst(signalVector &rxBurst,
 
   signalVector burstSegment(rxBurst.begin(),startIx,windowLen);
 
-  //static complex staticData[200];
-  //signalVector correlatedBurst(staticData,0,corrLen);
-  signalVector correlatedBurst(corrLen);
-  correlate(&burstSegment, gMidambles[TSC]->sequenceReversedConjugated,
-					    &correlatedBurst, CUSTOM,true,
-					    expectedTOAPeak-maxTOA,corrLen);
+  // the window widens beyond the default span for large delays, so offset
+  // the correlation to keep the TOA reference fixed
+  unsigned corrStart = expectedTOAPeak+(spanTOA-5*samplesPerSymbol)-maxTOA;
+
+  signalVector correlatedBurst(scratchVector(ws.corr, corrLen), 0, corrLen);
+  if (!correlate(&burstSegment, gMidambles[TSC]->sequenceReversedConjugated,
+		 &correlatedBurst, CUSTOM, corrStart, corrLen, ws))
+    return false;
 
   float meanPower;
   *amplitude = peakDetect(correlatedBurst,TOA,&meanPower);
@@ -1078,11 +1640,12 @@ bool analyzeTrafficBurst(signalVector &rxBurst,
 
   LOG(DEBUG) << "autocorr: " << correlatedBurst;
   
-  if (requestChannel && (peakToMean > detectThreshold)) {
+  if (channelResponse && (peakToMean > detectThreshold)) {
     float TOAoffset = maxTOA; //gMidambles[TSC]->TOA+(66*samplesPerSymbol-startIx);
-    delayVector(correlatedBurst,-(*TOA));
+    delayVector(correlatedBurst,-(*TOA),ws);
     // midamble only allows estimation of a 6-tap channel
-    signalVector channelVector(6*samplesPerSymbol);
+    signalVector channelVector(scratchVector(ws.chan, 6*samplesPerSymbol),
+                               0, 6*samplesPerSymbol);
     float maxEnergy = -1.0;
     int maxI = -1;
     for (int i = 0; i < 7; i++) {
@@ -1096,10 +1659,9 @@ bool analyzeTrafficBurst(signalVector &rxBurst,
       }
     }
 	
-    *channelResponse = new signalVector(channelVector.size());
-    correlatedBurst.segmentCopyTo(**channelResponse,(int) floor(TOAoffset+(maxI-5)*samplesPerSymbol),(*channelResponse)->size());
-    scaleVector(**channelResponse,complex(1.0,0.0)/gMidambles[TSC]->gain);
-    LOG(DEBUG) << "channelResponse: " << **channelResponse;
+    correlatedBurst.segmentCopyTo(*channelResponse,(int) floor(TOAoffset+(maxI-5)*samplesPerSymbol),channelResponse->size());
+    scaleVector(*channelResponse,complex(1.0,0.0)/gMidambles[TSC]->gain);
+    LOG(DEBUG) << "channelResponse: " << *channelResponse;
     
     if (channelResponseOffset) 
       *channelResponseOffset = 5*samplesPerSymbol-maxI;
@@ -1134,36 +1696,44 @@ SoftVector *demodulateBurst(signalVector &rxBurst,
 			 float TOA) 
 
 {
-  scaleVector(rxBurst,((complex) 1.0)/channel);
-  delayVector(rxBurst,-TOA);
+  SharedWorkspace ws(samplesPerSymbol);
+  SoftVector *burstBits = new SoftVector(rxBurst.size()/samplesPerSymbol);
 
-  signalVector *shapedBurst = &rxBurst;
+  demodulateBurst(rxBurst, gsmPulse, samplesPerSymbol,
+                  channel, TOA, *burstBits, ws);
 
-  // shift up by a quarter of a frequency
-  // ignore starting phase, since spec allows for discontinuous phase
-  GMSKReverseRotate(*shapedBurst);
-
-  // run through slicer
-  if (samplesPerSymbol > 1) {
-     signalVector *decShapedBurst = decimateVector(*shapedBurst,samplesPerSymbol);
-     shapedBurst = decShapedBurst;
-  }
-
-  LOG(DEBUG) << "shapedBurst: " << *shapedBurst;
+  return burstBits;
+}
 
-  vectorSlicer(shapedBurst);
+bool demodulateBurst(signalVector &rxBurst,
+		     const signalVector &gsmPulse,
+		     int samplesPerSymbol,
+		     complex channel,
+		     float TOA,
+		     SoftVector &bits,
+		     DemodWorkspace &ws)
+{
+  if (bits.size()*samplesPerSymbol > rxBurst.size())
+    return false;
 
-  SoftVector *burstBits = new SoftVector(shapedBurst->size());
+  scaleVector(rxBurst,((complex) 1.0)/channel);
+  delayVector(rxBurst,-TOA,ws);
 
-  SoftVector::iterator burstItr = burstBits->begin();
-  signalVector::iterator shapedItr = shapedBurst->begin();
-  for (; shapedItr < shapedBurst->end(); shapedItr++) 
-    *burstItr++ = shapedItr->real();
+  // shift up by a quarter of a frequency
+  // ignore starting phase, since spec allows for discontinuous phase
+  GMSKReverseRotate(rxBurst);
 
-  if (samplesPerSymbol > 1) delete shapedBurst;
+  LOG(DEBUG) << "shapedBurst: " << rxBurst;
 
-  return burstBits;
+  // run symbol spaced samples through slicer
+  SoftVector::iterator burstItr = bits.begin();
+  signalVector::iterator shapedItr = rxBurst.begin();
+  for (; burstItr < bits.end(); burstItr++) {
+    *burstItr = softSlice(shapedItr->real());
+    shapedItr += samplesPerSymbol;
+  }
 
+  return true;
 }
 
 
@@ -1458,54 +2028,117 @@ SoftVector *equalizeBurst(signalVector &rxBurst,
 		       signalVector &w, // feedforward filter
 		       signalVector &b) // feedback filter
 {
+  SharedWorkspace ws(samplesPerSymbol);
+  SoftVector *burstBits = new SoftVector(rxBurst.size());
 
-  delayVector(rxBurst,-TOA);
+  equalizeBurst(rxBurst, TOA, samplesPerSymbol, w, b, *burstBits, ws);
 
-  signalVector* postForwardFull = convolve(&rxBurst,&w,NULL,FULL_SPAN);
+  return burstBits;
+}
+
+bool equalizeBurst(signalVector &rxBurst,
+		   float TOA,
+		   int samplesPerSymbol,
+		   signalVector &w, // feedforward filter
+		   signalVector &b, // feedback filter
+		   SoftVector &bits,
+		   DemodWorkspace &ws)
+{
+  if (!w.size() || (w.getSymmetry() != NONE) ||
+      (bits.size() > rxBurst.size()))
+    return false;
 
-  signalVector* postForward = new signalVector(rxBurst.size());
-  postForwardFull->segmentCopyTo(*postForward,w.size()-1,rxBurst.size());
-  delete postForwardFull;
+  delayVector(rxBurst,-TOA,ws);
 
-  signalVector::iterator dPtr = postForward->begin();
+  // full span feedforward output starting past the filter delay
+  size_t len = rxBurst.size();
+  signalVector postForward(scratchVector(ws.filtered, len), 0, len);
+  if (!convolveTaps(&rxBurst, workspaceTaps(w, ws), rxBurst.isRealOnly(),
+                    &postForward, CUSTOM, w.size()-1, len, &ws.input))
+    return false;
+
+  signalVector::iterator dPtr = postForward.begin();
   signalVector::iterator dBackPtr;
   signalVector::iterator rotPtr = GMSKRotation->begin();
   signalVector::iterator revRotPtr = GMSKReverseRotation->begin();
-
-  signalVector *DFEoutput = new signalVector(postForward->size());
-  signalVector::iterator DFEItr = DFEoutput->begin();
+  SoftVector::iterator burstItr = bits.begin();
 
   // NOTE: can insert the midamble and/or use midamble to estimate BER
-  for (; dPtr < postForward->end(); dPtr++) {
+  // decisions only feed back into later symbols, so stop at the output length
+  for (; burstItr < bits.end(); dPtr++) {
     dBackPtr = dPtr-1;
     signalVector::iterator bPtr = b.begin();
-    while ( (bPtr < b.end()) && (dBackPtr >= postForward->begin()) ) {
+    while ( (bPtr < b.end()) && (dBackPtr >= postForward.begin()) ) {
       *dPtr = *dPtr + (*bPtr)*(*dBackPtr);
       bPtr++;
       dBackPtr--;
     }
     *dPtr = *dPtr * (*revRotPtr);
-    *DFEItr = *dPtr;
+    *burstItr++ = softSlice(dPtr->real());
     // make decision on symbol
     *dPtr = (dPtr->real() > 0.0) ? 1.0 : -1.0;
-    //*DFEItr = *dPtr;
     *dPtr = *dPtr * (*rotPtr);
-    DFEItr++;
     rotPtr++;
     revRotPtr++;
   }
 
-  vectorSlicer(DFEoutput);
+  return true;
+}
+
+bool mlseEqualizeBurst(signalVector &rxBurst,
+		       float TOA,
+		       int samplesPerSymbol,
+		       const signalVector &channel,
+		       SoftVector &bits,
+		       DemodWorkspace &ws)
+{
+  int len = rxBurst.size()/samplesPerSymbol;
+  int taps = channel.size()/samplesPerSymbol;
+  if (taps > MLSE_MAX_TAPS) taps = MLSE_MAX_TAPS;
+
+  if ((taps < 1) || (bits.size() > (size_t) len))
+    return false;
+
+  if (len > ws.mlse->max_len) {
+    mlse_free(ws.mlse);
+    ws.mlse = mlse_alloc(len);
+    if (!ws.mlse)
+      return false;
+  }
+
+  delayVector(rxBurst,-TOA,ws);
 
-  SoftVector *burstBits = new SoftVector(postForward->size());
-  SoftVector::iterator burstItr = burstBits->begin();
-  DFEItr = DFEoutput->begin();
-  for (; DFEItr < DFEoutput->end(); DFEItr++) 
-    *burstItr++ = DFEItr->real();
+  // remove the GMSK rotation from symbol spaced samples and taps, which
+  // leaves a time invariant channel over real valued symbols
+  complex h[MLSE_MAX_TAPS];
+  complex *r = scratchVector(ws.shift, len);
+  signalVector::iterator revRotPtr = GMSKReverseRotation->begin();
 
-  delete postForward;
+  float maxPow = 0.0;
+  for (int i = 0; i < taps; i++) {
+    h[i] = channel[i*samplesPerSymbol] * revRotPtr[i*samplesPerSymbol];
+    if (h[i].norm2() > maxPow) maxPow = h[i].norm2();
+  }
 
-  delete DFEoutput;
+  // taps 10 dB below the strongest are mostly estimation noise, drop them
+  // and shorten the trellis when they trail the response
+  for (int i = 0; i < taps; i++) {
+    if (h[i].norm2() < 0.1F*maxPow) h[i] = 0.0;
+  }
+  while ((taps > 1) && (h[taps-1].norm2() == 0.0F))
+    taps--;
 
-  return burstBits;
+  for (int i = 0; i < len; i++)
+    r[i] = rxBurst[i*samplesPerSymbol] * revRotPtr[i*samplesPerSymbol];
+
+  if (mlse_detect(ws.mlse, (cmplx *) h, taps, (cmplx *) r, len,
+                  bits.begin(), bits.size()) < 0)
+    return false;
+
+  // metric difference is four times the sample for a single ideal tap
+  SoftVector::iterator burstItr = bits.begin();
+  for (; burstItr < bits.end(); burstItr++)
+    *burstItr = softSlice(0.25F * *burstItr);
+
+  return true;
 }
@@ -90,6 +90,40 @@ class signalVector: public Vector<complex>
   void isRealOnly(bool wOnly) { realOnly = wOnly;};
 };
 
+struct cxvec;
+struct mlse;
+
+/**
+	Scratch storage for the receive demodulation path.
+	Buffers are sized for a full burst at construction and only grow if
+	a larger request arrives, so steady state demodulation does not touch
+	the heap. Not thread safe, each receiving thread keeps its own. The
+	overloads without a workspace argument share one per oversampling rate
+	and serialize on it.
+*/
+class DemodWorkspace {
+
+ public:
+
+  /** Constructor, sizes buffers for bursts at the given oversampling */
+  DemodWorkspace(int samplesPerSymbol = 1);
+  ~DemodWorkspace();
+
+  signalVector corr;          ///< correlator output
+  signalVector shift;         ///< fractional delay output
+  signalVector chan;          ///< channel estimate candidate
+  signalVector filtered;      ///< feedforward filter output
+
+  struct cxvec *input;        ///< convolution input with zeroed headroom
+  struct cxvec *taps;         ///< aligned convolution taps in kernel order
+  struct mlse *mlse;          ///< sequence estimator path metrics
+
+ private:
+
+  DemodWorkspace(const DemodWorkspace &);
+  DemodWorkspace &operator=(const DemodWorkspace &);
+};
+
 /** Convert a linear number to a dB value */
 float dB(float x);
 
@@ -102,10 +136,10 @@ float vectorNorm2(const signalVector &x);
 /** Compute the average power of a vector */
 float vectorPower(const signalVector &x);
 
-/** Setup the signal processing library */
+/** Setup the signal processing library, nested calls share the first setup */
 void sigProcLibSetup(int samplesPerSymbol);
 
-/** Destroy the signal processing library */
+/** Destroy the signal processing library once every setup has been matched */
 void sigProcLibDestroy(void);
 
 /** 
@@ -177,6 +211,11 @@ float sinc(float x);
 void delayVector(signalVector &wBurst,
 		 float delay);
 
+/** Delay a vector in place using workspace scratch buffers */
+void delayVector(signalVector &wBurst,
+		 float delay,
+		 DemodWorkspace &ws);
+
 /** Add two vectors in-place */
 bool addVector(signalVector &x,
 	       signalVector &y);
@@ -273,6 +312,89 @@ bool detectRACHBurst(signalVector &rxBurst,
 		     complex *amplitude,
 		     float* TOA);
 
+/** RACH correlator/detector using workspace scratch buffers */
+bool detectRACHBurst(signalVector &rxBurst,
+		     float detectThreshold,
+		     int samplesPerSymbol,
+		     complex *amplitude,
+		     float* TOA,
+		     DemodWorkspace &ws);
+
+struct fft_hdl;
+
+/** Per-burst result of a batched RACH detection */
+struct RACHResult {
+  bool detected;              ///< peak-to-mean above the detection threshold
+  complex amplitude;          ///< estimated amplitude of the RACH burst
+  float TOA;                  ///< estimated time-of-arrival in samples
+  float peakToMean;           ///< post-correlator peak-to-mean ratio
+};
+
+/**
+	Batched RACH correlator/detector.
+	Queued bursts are zero padded into a shared buffer and correlated
+	against a cached spectrum of the RACH sequence with one forward and
+	one inverse FFT pass over the whole batch. Peak detection then follows
+	detectRACHBurst(). FFT plans are created in the constructor, which
+	must not run concurrently with other FFTW planning. Not thread safe.
+*/
+class RACHBatch {
+
+ public:
+
+  /** Constructor
+      @param maxBursts maximum number of bursts per batch
+      @param samplesPerSymbol the number of samples per GSM symbol
+  */
+  RACHBatch(int maxBursts, int samplesPerSymbol = 1);
+  ~RACHBatch();
+
+  /** Queue a burst for detection, the samples are copied
+      @return batch index of the burst, or -1 if the batch is full or the burst is too long
+  */
+  int add(const signalVector &rxBurst);
+
+  /** Correlate and detect all queued bursts
+      @param detectThreshold post-correlator peak-to-mean detection threshold
+      @return number of detected bursts
+  */
+  int detect(float detectThreshold);
+
+  /** Result of a queued burst, valid after detect() until clear() */
+  const RACHResult &result(int index) const { return mResults[index]; }
+
+  /** Drop all queued bursts and results */
+  void clear() { mNumBursts = 0; }
+
+  int size() const { return mNumBursts; }
+  int capacity() const { return mMaxBursts; }
+
+ private:
+
+  int mMaxBursts;
+  int mNumBursts;
+  int mSamplesPerSymbol;
+  int mFFTLen;
+  int mMaxLen;                ///< longest burst that avoids circular aliasing
+
+  struct cxvec *mBuf;         ///< zero padded bursts, one FFT length apart
+  struct cxvec *mSpectrum;    ///< scaled spectrum of the reversed conjugated sequence
+  bool mHaveSpectrum;
+
+  struct fft_hdl **mForward;  ///< plans over the first 1, 2, 4, ... bursts
+  struct fft_hdl **mInverse;
+  int mNumPlans;
+
+  int *mLens;
+  RACHResult *mResults;
+
+  bool loadSpectrum();
+  int plan(int bursts) const;
+
+  RACHBatch(const RACHBatch &);
+  RACHBatch &operator=(const RACHBatch &);
+};
+
 /**
         Normal burst correlator, detector, channel estimator.
         @param rxBurst The received GSM burst of interest.
@@ -298,6 +420,25 @@ bool analyzeTrafficBurst(signalVector &rxBurst,
 			 signalVector** channelResponse = NULL,
 			 float *channelResponseOffset = NULL);
 
+/**
+        Normal burst correlator, detector, channel estimator using workspace
+        scratch buffers.
+        @param channelResponse Caller allocated channel estimate output of
+               6*samplesPerSymbol samples, or NULL if no estimate is desired.
+               Written only if the burst is detected.
+        @return True if burst SNR is larger that the detectThreshold value.
+*/
+bool analyzeTrafficBurst(signalVector &rxBurst,
+			 unsigned TSC,
+			 float detectThreshold,
+			 int samplesPerSymbol,
+			 complex *amplitude,
+			 float *TOA,
+			 unsigned maxTOA,
+			 signalVector *channelResponse,
+			 float *channelResponseOffset,
+			 DemodWorkspace &ws);
+
 /**
 	Decimate a vector.
         @param wVector The vector of interest.
@@ -322,6 +463,20 @@ SoftVector *demodulateBurst(signalVector &rxBurst,
 			 complex channel,
 			 float TOA);
 
+/**
+        Demodulates a received burst into caller allocated soft bits.
+        @param bits Output soft bits, no more than the number of symbols in rxBurst.
+        @param ws Workspace scratch buffers.
+        @return False if the output is longer than the burst.
+*/
+bool demodulateBurst(signalVector &rxBurst,
+		     const signalVector &gsmPulse,
+		     int samplesPerSymbol,
+		     complex channel,
+		     float TOA,
+		     SoftVector &bits,
+		     DemodWorkspace &ws);
+
 /**
         Creates a simple Kaiser-windowed low-pass FIR filter.
         @param cutoffFreq The digital 3dB bandwidth of the filter.
@@ -386,4 +541,36 @@ SoftVector *equalizeBurst(signalVector &rxBurst,
 		       signalVector &w, 
 		       signalVector &b);
 
+/**
+	Equalize/demodulate a received burst into caller allocated soft bits.
+	@param bits Output soft bits, no more than the number of samples in rxBurst.
+	@param ws Workspace scratch buffers.
+	@return False if the output is longer than the burst.
+*/
+bool equalizeBurst(signalVector &rxBurst,
+		   float TOA,
+		   int samplesPerSymbol,
+		   signalVector &w,
+		   signalVector &b,
+		   SoftVector &bits,
+		   DemodWorkspace &ws);
+
+/**
+	Equalize/demodulate a received burst via maximum likelihood sequence
+	estimation over the symbol spaced channel response.
+	@param rxBurst The received burst to be demodulated.
+	@param TOA The time-of-arrival of the received burst.
+	@param samplesPerSymbol The number of samples per GSM symbol.
+	@param channel The channel response, truncated to the supported memory.
+	@param bits Output soft bits, no more than the number of symbols in rxBurst.
+	@param ws Workspace scratch buffers.
+	@return False if the burst or channel cannot be equalized.
+*/
+bool mlseEqualizeBurst(signalVector &rxBurst,
+		       float TOA,
+		       int samplesPerSymbol,
+		       const signalVector &channel,
+		       SoftVector &bits,
+		       DemodWorkspace &ws);
+
 #endif /* SIGPROCLIB_H */
@@ -34,10 +34,220 @@ Harvind S. Samra, hssamra@kestrelsp.com
 #include <Logger.h>
 #include <Configuration.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 using namespace std;
 
 ConfigurationTable gConfig;
 
+/* Workspace regression trials per oversampling rate */
+#define NUM_TRIALS	32
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, int sps, int trial)
+{
+  if (ok)
+    return;
+
+  cout << "FAIL: " << what << " at " << sps << " sps, trial " << trial << endl;
+  failures++;
+}
+
+static bool sameSamples(const signalVector &a, const signalVector &b)
+{
+  return (a.size() == b.size()) &&
+         !memcmp(a.begin(), b.begin(), a.size() * sizeof(complex));
+}
+
+static bool sameBits(const SoftVector &a, const SoftVector &b)
+{
+  return (a.size() == b.size()) &&
+         !memcmp(a.begin(), b.begin(), a.size() * sizeof(float));
+}
+
+static void randomBits(BitVector &bits, size_t start, size_t len)
+{
+  for (size_t i = start; i < start + len; i++)
+    bits[i] = random() & 0x01;
+}
+
+/* Modulate a burst and add noise and a fractional delay */
+static signalVector *receivedBurst(const BitVector &bits,
+                                   const signalVector &gsmPulse,
+                                   int guard, int sps)
+{
+  signalVector *burst = modulateBurst(bits, gsmPulse, guard, sps);
+  signalVector *noise = gaussianNoise(burst->size(), 0.01);
+
+  addVector(*burst, *noise);
+  delayVector(*burst, (random() % 100) / 100.0 * sps);
+  delete noise;
+
+  return burst;
+}
+
+/* Table and convolution modulator trials per oversampling rate */
+#define NUM_MOD_TRIALS	300
+
+/* Largest sample difference between the table and convolution modulators */
+static float maxModError(int sps)
+{
+  return (sps == 1) ? 2e-4 : 1e-3;
+}
+
+/*
+ * Modulate random normal and access bursts through the modulator table and
+ * through the convolution path. The same pulse padded with a zero tap at
+ * each end has the same response and delay, but does not match the table,
+ * so modulateBurst() convolves it.
+ */
+static void testModulator(int sps)
+{
+  signalVector *gsmPulse = generateGSMPulse(2, sps);
+  signalVector padded(gsmPulse->size() + 2);
+  padded.fill(0.0);
+  gsmPulse->copyToSegment(padded, 1);
+  padded.isRealOnly(true);
+  padded.setSymmetry(ABSSYM);
+
+  float worst = 0.0;
+
+  for (int n = 0; n < NUM_MOD_TRIALS; n++) {
+    bool access = n & 0x01;
+    BitVector bits(access ? 88 : 148);
+    randomBits(bits, 0, bits.size());
+    int guard = access ? 68 : 8;
+
+    signalVector *table = modulateBurst(bits, *gsmPulse, guard, sps);
+    signalVector *conv = modulateBurst(bits, padded, guard, sps);
+
+    if (table->size() != conv->size()) {
+      check(false, "modulated burst length", sps, n);
+    }
+    else {
+      for (size_t i = 0; i < table->size(); i++) {
+        float err = ((*table)[i] - (*conv)[i]).abs();
+        if (err > worst)
+          worst = err;
+      }
+    }
+
+    delete table;
+    delete conv;
+  }
+
+  cout << "modulator error at " << sps << " sps: " << worst << endl;
+  check(worst <= maxModError(sps), "modulator error", sps, -1);
+  delete gsmPulse;
+}
+
+/*
+ * The overloads without a workspace argument, a fresh workspace per call
+ * and one workspace reused across RACH and normal bursts must all produce
+ * identical results.
+ */
+static void testWorkspaceDemod(int sps)
+{
+  int TSC = 2;
+  int detected = 0;
+
+  signalVector *gsmPulse = generateGSMPulse(2, sps);
+  generateRACHSequence(*gsmPulse, sps);
+  generateMidamble(*gsmPulse, sps, TSC);
+
+  DemodWorkspace reused(sps);
+
+  for (int n = 0; n < NUM_TRIALS; n++) {
+    /* Access burst */
+    BitVector rach(BitVector(BitVector("01010101"), gRACHSynchSequence),
+                   BitVector(36 + 3));
+    randomBits(rach, 8 + gRACHSynchSequence.size(), 36 + 3);
+
+    signalVector *rx = receivedBurst(rach, *gsmPulse, 68, sps);
+    complex amp[3];
+    float toa[3];
+    bool ok[3];
+
+    signalVector rx0(*rx), rx1(*rx), rx2(*rx);
+    DemodWorkspace fresh(sps);
+    ok[0] = detectRACHBurst(rx0, 5, sps, &amp[0], &toa[0]);
+    ok[1] = detectRACHBurst(rx1, 5, sps, &amp[1], &toa[1], fresh);
+    ok[2] = detectRACHBurst(rx2, 5, sps, &amp[2], &toa[2], reused);
+    for (int i = 1; i < 3; i++)
+      check((ok[i] == ok[0]) && (amp[i] == amp[0]) && (toa[i] == toa[0]),
+            "RACH detection", sps, n);
+    delete rx;
+
+    /* Normal burst */
+    BitVector normal(BitVector(BitVector(61), gTrainingSequence[TSC]),
+                     BitVector(61));
+    randomBits(normal, 0, 61);
+    randomBits(normal, 61 + 26, 61);
+
+    rx = receivedBurst(normal, *gsmPulse, 8, sps);
+
+    signalVector *chanResp = NULL;
+    signalVector chan1(6 * sps), chan2(6 * sps);
+    float offset[3];
+
+    ok[0] = analyzeTrafficBurst(*rx, TSC, 5, sps, &amp[0], &toa[0], 1,
+                                true, &chanResp, &offset[0]);
+    DemodWorkspace freshAnalyze(sps);
+    ok[1] = analyzeTrafficBurst(*rx, TSC, 5, sps, &amp[1], &toa[1], 1,
+                                &chan1, &offset[1], freshAnalyze);
+    ok[2] = analyzeTrafficBurst(*rx, TSC, 5, sps, &amp[2], &toa[2], 1,
+                                &chan2, &offset[2], reused);
+    for (int i = 1; i < 3; i++)
+      check((ok[i] == ok[0]) && (amp[i] == amp[0]) && (toa[i] == toa[0]),
+            "normal burst detection", sps, n);
+
+    if (!ok[0]) {
+      delete rx;
+      continue;
+    }
+
+    detected++;
+    check(sameSamples(chan1, *chanResp) && sameSamples(chan2, *chanResp) &&
+          (offset[1] == offset[0]) && (offset[2] == offset[0]),
+          "channel estimate", sps, n);
+
+    rx0 = *rx; rx1 = *rx; rx2 = *rx;
+    SoftVector *bits = demodulateBurst(rx0, *gsmPulse, sps, amp[0], toa[0]);
+    SoftVector bits1(bits->size()), bits2(bits->size());
+    DemodWorkspace freshDemod(sps);
+    demodulateBurst(rx1, *gsmPulse, sps, amp[0], toa[0], bits1, freshDemod);
+    demodulateBurst(rx2, *gsmPulse, sps, amp[0], toa[0], bits2, reused);
+    check(sameBits(bits1, *bits) && sameBits(bits2, *bits),
+          "demodulation", sps, n);
+    delete bits;
+
+    /* The decision feedback equalizer runs at the symbol rate */
+    signalVector *w, *b;
+    if ((sps == 1) && designDFE(*chanResp, 100.0, 7, &w, &b)) {
+      rx0 = *rx; rx1 = *rx; rx2 = *rx;
+      bits = equalizeBurst(rx0, toa[0] - offset[0], sps, *w, *b);
+      SoftVector bits1(bits->size()), bits2(bits->size());
+      DemodWorkspace freshEqualize(sps);
+      equalizeBurst(rx1, toa[0] - offset[0], sps, *w, *b, bits1,
+                    freshEqualize);
+      equalizeBurst(rx2, toa[0] - offset[0], sps, *w, *b, bits2, reused);
+      check(sameBits(bits1, *bits) && sameBits(bits2, *bits),
+            "equalization", sps, n);
+      delete bits;
+      delete w;
+      delete b;
+    }
+
+    delete chanResp;
+    delete rx;
+  }
+
+  check(detected > NUM_TRIALS / 2, "normal burst detection rate", sps, -1);
+  delete gsmPulse;
+}
+
 int main(int argc, char **argv) {
 
   gLogInit("sigProcLibTest","DEBUG");
@@ -165,4 +375,16 @@ int main(int argc, char **argv) {
 
   sigProcLibDestroy();
 
+  srandom(1);
+  int rates[] = { 1, 4 };
+  for (int i = 0; i < 2; i++) {
+    sigProcLibSetup(rates[i]);
+    testModulator(rates[i]);
+    testWorkspaceDemod(rates[i]);
+    sigProcLibDestroy();
+  }
+
+  cout << (failures ? "FAIL" : "PASS") << endl;
+
+  return failures ? 1 : 0;
 }
@@ -27,6 +27,14 @@
 
 #include "convolve.h"
 
+/*! \brief Select convolution kernels for the running processor
+ *
+ * Only generic kernels are available in this build.
+ */
+void convolve_init(void)
+{
+}
+
 /*! \brief Convolve two complex vectors 
  *  \param[in] in_vec Complex input signal
  *  \param[in] h_vec Complex filter taps (stored in reverse order)
@@ -38,7 +46,7 @@
  *
  * All vectors are 'complex', but the filter taps may consist of real values
  * in that the imaginary component is ignored and complex-real multiplication
- * is performed instead.
+ * is performed instead. Taps are treated as real if flagged as real only.
  *
  * Convolution format is loosely influenced by the FIR filtering operations
  * in TI DSPLIB. For more information on TI DSPLIB, see:
@@ -64,15 +72,10 @@ int cxvec_convolve(struct cxvec *restrict in_vec,
 		return -1;
 	}
 
-	if (!(h_vec->flags & CXVEC_FLG_REAL_ONLY)) {
-		fprintf(stderr, "convolve: Filter taps must be real\n");
-		return -1;
-	}
-
-	switch (h_vec->len) {
-	default:
+	if (h_vec->flags & CXVEC_FLG_REAL_ONLY)
 		mac_func = mac_real_vec_n;
-	}
+	else
+		mac_func = mac_cmplx_vec_n;
 
 	a = in_vec->data;	/* input */
 	h = h_vec->data;	/* taps */
@@ -104,15 +107,10 @@ int single_convolve(cmplx *restrict in,
 	int i;
 	void (*mac_func)(cmplx *, cmplx *, cmplx *, int);
 
-	if (!(h->flags & CXVEC_FLG_REAL_ONLY)) {
-		fprintf(stderr, "convolve: Filter taps must be real\n");
-		return -1;
-	}
-
-	switch (h->len) {
-	default:
+	if (h->flags & CXVEC_FLG_REAL_ONLY)
 		mac_func = mac_real_vec_n;
-	}
+	else
+		mac_func = mac_cmplx_vec_n;
 
 	out->real = 0.0f;
 	out->imag = 0.0f;
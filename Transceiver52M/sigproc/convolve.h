@@ -26,21 +26,21 @@
 #include "sigvec.h"
 
 /* Generic multiply and accumulate complex-real */
-inline void mac_real(cmplx *x, cmplx *h, cmplx *y)
+static inline void mac_real(cmplx *x, cmplx *h, cmplx *y)
 {
 	y->real += x->real * h->real;
 	y->imag += x->imag * h->real;
 }
 
 /* Generic multiply and accumulate complex-complex */
-inline void mac_cmplx(cmplx *x, cmplx *h, cmplx *y)
+static inline void mac_cmplx(cmplx *x, cmplx *h, cmplx *y)
 {
 	y->real += x->real * h->real - x->imag * h->imag;
 	y->imag += x->real * h->imag + x->imag * h->real;
 }
 
 /* Generic vector complex-real multiply and accumulate */
-inline void mac_real_vec_n(cmplx *x, cmplx *h, cmplx *y, int len)
+static inline void mac_real_vec_n(cmplx *x, cmplx *h, cmplx *y, int len)
 {
 	int i;
 
@@ -50,7 +50,7 @@ inline void mac_real_vec_n(cmplx *x, cmplx *h, cmplx *y, int len)
 }
 
 /* Generic vector complex-complex multiply and accumulate */
-inline void mac_cmplx_vec_n(cmplx *x, cmplx *h, cmplx *y, int len)
+static inline void mac_cmplx_vec_n(cmplx *x, cmplx *h, cmplx *y, int len)
 {
 	int i;
 
@@ -59,6 +59,7 @@ inline void mac_cmplx_vec_n(cmplx *x, cmplx *h, cmplx *y, int len)
 	}
 }
 
+void convolve_init(void);
 int cxvec_convolve(struct cxvec *a_vec, struct cxvec *h_vec, struct cxvec *c_vec);
 int single_convolve(cmplx *in, struct cxvec *h_vec, cmplx *out);
 
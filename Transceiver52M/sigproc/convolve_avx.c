@@ -0,0 +1,148 @@
+/*
+ * convolve_avx.c
+ *
+ * Intel AVX2/FMA optimized complex convolution
+ *
+ * Copyright (C) 2012 Free Software Foundation, Inc.
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */ 
+
+#include <immintrin.h>
+
+#include "convolve_avx.h"
+
+/*
+ * Complex input samples are interleaved (real, imag) pairs, so a 256-bit
+ * load covers four samples. Real taps are stored as complex values with
+ * zero imaginary parts, so duplicating the even elements of a tap load
+ * (moveldup) yields the (h, h) pairs that scale four samples at once and
+ * no shuffling of the input is necessary.
+ */
+
+/* Sum the four complex lanes of an accumulator and store one output */
+static inline void sum_store(__m256 acc, float *y)
+{
+	__m128 m0, m1;
+
+	m0 = _mm256_castps256_ps128(acc);
+	m1 = _mm256_extractf128_ps(acc, 1);
+	m0 = _mm_add_ps(m0, m1);
+	m1 = _mm_movehl_ps(m0, m0);
+	m0 = _mm_add_ps(m0, m1);
+
+	_mm_storel_pi((__m64 *) y, m0);
+}
+
+/* 8-tap AVX complex-real convolution */
+void conv_real_avx8(float *restrict x,
+		    float *restrict h,
+		    float *restrict y,
+		    int in_len)
+{
+	int i;
+	__m256 m0, m1, m2;
+
+	/* Load filter taps */
+	m0 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[0]));
+	m1 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[8]));
+
+	for (i = 0; i < in_len; i++) {
+		m2 = _mm256_mul_ps(_mm256_loadu_ps(&x[2*i + 0]), m0);
+		m2 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[2*i + 8]), m1, m2);
+
+		sum_store(m2, &y[2*i]);
+	}
+}
+
+/* 16-tap AVX complex-real convolution */
+void conv_real_avx16(float *restrict x,
+		     float *restrict h,
+		     float *restrict y,
+		     int in_len)
+{
+	int i;
+	__m256 m0, m1, m2, m3, m4, m5;
+
+	/* Load filter taps */
+	m0 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[0]));
+	m1 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[8]));
+	m2 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[16]));
+	m3 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[24]));
+
+	for (i = 0; i < in_len; i++) {
+		/* Two independent accumulation chains */
+		m4 = _mm256_mul_ps(_mm256_loadu_ps(&x[2*i + 0]), m0);
+		m5 = _mm256_mul_ps(_mm256_loadu_ps(&x[2*i + 8]), m1);
+		m4 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[2*i + 16]), m2, m4);
+		m5 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[2*i + 24]), m3, m5);
+
+		sum_store(_mm256_add_ps(m4, m5), &y[2*i]);
+	}
+}
+
+/* N-tap AVX complex-real convolution where N is a multiple of 4 */
+void conv_real_avx4n(float *restrict x,
+		     float *restrict h,
+		     float *restrict y,
+		     int h_len, int in_len)
+{
+	int i, n;
+	__m256 m0, m1;
+
+	for (i = 0; i < in_len; i++) {
+		m1 = _mm256_setzero_ps();
+
+		for (n = 0; n < h_len / 4; n++) {
+			m0 = _mm256_moveldup_ps(_mm256_loadu_ps(&h[8*n]));
+			m1 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[2*i + 8*n]),
+					     m0, m1);
+		}
+
+		sum_store(m1, &y[2*i]);
+	}
+}
+
+/*
+ * N-tap AVX complex-complex convolution where N is a multiple of 4
+ *
+ * Products of the input with the real and imaginary tap parts are
+ * accumulated separately, the latter against pair swapped input samples.
+ * A final add-subtract forms (xr*hr - xi*hi, xi*hr + xr*hi).
+ */
+void conv_cmplx_avx4n(float *restrict x,
+		      float *restrict h,
+		      float *restrict y,
+		      int h_len, int in_len)
+{
+	int i, n;
+	__m256 m0, m1, m2, m3, m4;
+
+	for (i = 0; i < in_len; i++) {
+		m3 = _mm256_setzero_ps();
+		m4 = _mm256_setzero_ps();
+
+		for (n = 0; n < h_len / 4; n++) {
+			m0 = _mm256_loadu_ps(&h[8*n]);
+			m1 = _mm256_loadu_ps(&x[2*i + 8*n]);
+			m2 = _mm256_permute_ps(m1, _MM_SHUFFLE(2, 3, 0, 1));
+
+			m3 = _mm256_fmadd_ps(m1, _mm256_moveldup_ps(m0), m3);
+			m4 = _mm256_fmadd_ps(m2, _mm256_movehdup_ps(m0), m4);
+		}
+
+		sum_store(_mm256_addsub_ps(m3, m4), &y[2*i]);
+	}
+}
@@ -0,0 +1,36 @@
+/*
+ * convolve_avx.h
+ *
+ * Intel AVX2/FMA convolution kernels
+ *
+ * Copyright (C) 2012 Free Software Foundation, Inc.
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */ 
+
+#ifndef _CONVOLVE_AVX_H_
+#define _CONVOLVE_AVX_H_
+
+/*
+ * Kernels are built with AVX2/FMA code generation enabled and must only be
+ * called after convolve_init() has verified processor support. Taps are
+ * stored in reverse order and may be unaligned.
+ */
+void conv_real_avx8(float *x, float *h, float *y, int in_len);
+void conv_real_avx16(float *x, float *h, float *y, int in_len);
+void conv_real_avx4n(float *x, float *h, float *y, int h_len, int in_len);
+void conv_cmplx_avx4n(float *x, float *h, float *y, int h_len, int in_len);
+
+#endif /* _CONVOLVE_AVX_H_ */
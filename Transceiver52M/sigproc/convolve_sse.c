@@ -1,7 +1,7 @@
 /*
  * convolve_sse.c
  *
- * Intel SSE3 optimized complex convolution
+ * Intel SSE3 optimized complex convolution with runtime AVX2/FMA dispatch
  *
  * Copyright (C) 2012 Thomas Tsou <ttsou@vt.edu>
  * 
@@ -20,6 +20,10 @@
  * See the COPYING file in the main directory for details.
  */ 
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <string.h>
 #include <assert.h>
 #include <xmmintrin.h>
@@ -28,6 +32,14 @@
 
 #include "convolve.h"
 
+#ifdef HAVE_AVX2
+#include <cpuid.h>
+#include "convolve_avx.h"
+#endif
+
+/* Set by convolve_init() if AVX2 and FMA kernels may be used */
+static int use_avx = 0;
+
 #ifndef _MM_SHUFFLE
 #define _MM_SHUFFLE(fp3,fp2,fp1,fp0) \
 	(((fp3) << 6) | ((fp2) << 4) | ((fp1) << 2) | ((fp0)))
@@ -48,6 +60,21 @@ static void conv_real_generic(cmplx *x,
 	}
 }
 
+/* Generic non-optimized complex-complex convolution */
+static void conv_cmplx_generic(cmplx *x,
+			       cmplx *h,
+			       cmplx *y,
+			       int h_len, int len)
+{
+	int i;
+
+	memset(y, 0, len * sizeof(cmplx));
+
+	for (i = 0; i < len; i++) {
+		mac_cmplx_vec_n(&x[i], h, &y[i], h_len);
+	}
+}
+
 /* 4-tap SSE3 complex-real convolution */
 static void conv_real_sse4(float *restrict x,
 			   float *restrict h,
@@ -357,38 +384,82 @@ static void conv_real_sse20(float *restrict x,
 	}
 }
 
-/*! \brief Convolve two complex vectors 
- *  \param[in] in_vec Complex input signal
- *  \param[in] h_vec Complex filter taps (stored in reverse order)
- *  \param[out] out_vec Complex vector output
+#ifdef HAVE_AVX2
+/* Check for processor and operating system AVX2 and FMA support */
+static int cpu_has_avx2_fma(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0_lo, xcr0_hi;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+
+	/* FMA, OSXSAVE and AVX */
+	if ((ecx & (bit_FMA | bit_OSXSAVE | bit_AVX)) !=
+	    (bit_FMA | bit_OSXSAVE | bit_AVX))
+		return 0;
+
+	/* XMM and YMM state must be enabled by the operating system */
+	__asm__ __volatile__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+	if ((xcr0_lo & 0x06) != 0x06)
+		return 0;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	return (ebx & bit_AVX2) ? 1 : 0;
+}
+#endif
+
+/*! \brief Select convolution kernels for the running processor
  *
- * Modified convole with filter length dependent SSE optimization.
- * See generic convole call for additional information.
+ * Queries the processor once and enables the AVX2/FMA kernels if supported.
+ * The SSE3 and generic kernels are used otherwise or if this call is never
+ * made. Repeated calls are harmless.
  */
-int cxvec_convolve(struct cxvec *restrict in_vec,
-		   struct cxvec *restrict h_vec,
-		   struct cxvec *restrict out_vec)
+void convolve_init(void)
 {
-	int i;
-	cmplx *x, *h, *y;
-	void (*conv_func)(float *, float *, float *, int);
+#ifdef HAVE_AVX2
+	use_avx = cpu_has_avx2_fma();
+#endif
+}
 
-	if (in_vec->len < out_vec->len) { 
-		fprintf(stderr, "convolve: Invalid vector length\n");
-		return -1;
+/* Run the best available kernel over 'len' outputs */
+static void conv_dispatch(cmplx *x, struct cxvec *h_vec, cmplx *y, int len)
+{
+	void (*conv_func)(float *, float *, float *, int);
+	int h_len = h_vec->len;
+
+#ifdef HAVE_AVX2
+	if (use_avx && !(h_len % 4)) {
+		if (!(h_vec->flags & CXVEC_FLG_REAL_ONLY)) {
+			conv_cmplx_avx4n((float *) x, (float *) h_vec->data,
+					 (float *) y, h_len, len);
+		} else if (h_len == 8) {
+			conv_real_avx8((float *) x, (float *) h_vec->data,
+				       (float *) y, len);
+		} else if (h_len == 16) {
+			conv_real_avx16((float *) x, (float *) h_vec->data,
+					(float *) y, len);
+		} else {
+			conv_real_avx4n((float *) x, (float *) h_vec->data,
+					(float *) y, h_len, len);
+		}
+		return;
 	}
-
-	if (in_vec->flags & CXVEC_FLG_REAL_ONLY) {
-		fprintf(stderr, "convolve: Input data must be complex\n");
-		return -1;
+#endif
+	if (!(h_vec->flags & CXVEC_FLG_REAL_ONLY)) {
+		conv_cmplx_generic(x, h_vec->data, y, h_len, len);
+		return;
 	}
 
-	if (!(h_vec->flags & (CXVEC_FLG_REAL_ONLY | CXVEC_FLG_MEM_ALIGN))) {
-		fprintf(stderr, "convolve: Taps must be real and aligned\n");
-		return -1;
-	}
+	/* SSE3 kernels use aligned tap loads */
+	if (!(h_vec->flags & CXVEC_FLG_MEM_ALIGN))
+		h_len = 0;
 
-	switch (h_vec->len) {
+	switch (h_len) {
 	case 4:
 		conv_func = conv_real_sse4;
 		break;
@@ -408,22 +479,42 @@ int cxvec_convolve(struct cxvec *restrict in_vec,
 		conv_func = NULL;
 	}
 
-	x = in_vec->data;	/* input */
-	h = h_vec->data;	/* taps */
-	y = out_vec->data;	/* output */
-
 	if (!conv_func) {
-		conv_real_generic(&x[-(h_vec->len - 1)],
-				  h,
-				  y,
-				  h_vec->len, out_vec->len);
+		conv_real_generic(x, h_vec->data, y, h_vec->len, len);
 	} else {
-		conv_func((float *) &x[-(h_vec->len - 1)],
-			  (float *) h,
-			  (float *) y, out_vec->len);
+		conv_func((float *) x, (float *) h_vec->data,
+			  (float *) y, len);
 	}
+}
 
-	return i;
+/*! \brief Convolve two complex vectors 
+ *  \param[in] in_vec Complex input signal
+ *  \param[in] h_vec Complex filter taps (stored in reverse order)
+ *  \param[out] out_vec Complex vector output
+ *
+ * Modified convole with filter length dependent SSE3 or AVX2/FMA
+ * optimization. Real taps use complex-real kernels, otherwise a
+ * complex-complex kernel is used. See generic convole call for additional
+ * information.
+ */
+int cxvec_convolve(struct cxvec *restrict in_vec,
+		   struct cxvec *restrict h_vec,
+		   struct cxvec *restrict out_vec)
+{
+	if (in_vec->len < out_vec->len) { 
+		fprintf(stderr, "convolve: Invalid vector length\n");
+		return -1;
+	}
+
+	if (in_vec->flags & CXVEC_FLG_REAL_ONLY) {
+		fprintf(stderr, "convolve: Input data must be complex\n");
+		return -1;
+	}
+
+	conv_dispatch(&in_vec->data[-(h_vec->len - 1)], h_vec,
+		      out_vec->data, out_vec->len);
+
+	return out_vec->len;
 }
 
 /*! \brief Single output convolution 
@@ -431,50 +522,14 @@ int cxvec_convolve(struct cxvec *restrict in_vec,
  *  \param[in] h Complex vector filter taps
  *  \param[out] out Pointer to complex output sample
  *
- * Modified single output convole with filter length dependent SSE
- * optimization. See generic convole call for additional information.
+ * Modified single output convole with filter length dependent SSE3 or
+ * AVX2/FMA optimization. See generic convole call for additional information.
  */
 int single_convolve(cmplx *restrict in,
 		    struct cxvec *restrict h_vec,
 		    cmplx *restrict out)
 {
-	void (*conv_func)(float *, float *, float *, int);
-
-	if (!(h_vec->flags & (CXVEC_FLG_REAL_ONLY | CXVEC_FLG_MEM_ALIGN))) {
-		fprintf(stderr, "convolve: Taps must be real and aligned\n");
-		return -1;
-	}
-
-	switch (h_vec->len) {
-	case 4:
-		conv_func = conv_real_sse4;
-		break;
-	case 8:
-		conv_func = conv_real_sse8;
-		break;
-	case 12:
-		conv_func = conv_real_sse12;
-		break;
-	case 16:
-		conv_func = conv_real_sse16;
-		break;
-	case 20:
-		conv_func = conv_real_sse20;
-		break;
-	default:
-		conv_func = NULL;
-	}
-
-	if (!conv_func) {
-		conv_real_generic(&in[-(h_vec->len - 1)],
-				  h_vec->data,
-				  out,
-				  h_vec->len, 1);
-	} else {
-		conv_func((float *) &in[-(h_vec->len - 1)],
-			  (float *) h_vec->data,
-			  (float *) out, 1);
-	}
+	conv_dispatch(&in[-(h_vec->len - 1)], h_vec, out, 1);
 
 	return 1;
 }
@@ -20,6 +20,7 @@
  * See the COPYING file in the main directory for details.
  */ 
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -33,6 +34,7 @@ struct fft_hdl {
 	fftwf_complex *fft_out;
 	fftwf_plan fft_plan;
 	int fft_len;
+	int fft_batch;
 };
 
 /*! \brief Initialize FFT backend 
@@ -56,6 +58,59 @@ struct fft_hdl *init_fft(int reverse, int m)
 	hdl->fft_plan = fftwf_plan_dft_1d(m, hdl->fft_in, hdl->fft_out,
 					  direction, FFTW_MEASURE);
 	hdl->fft_len = m;
+	hdl->fft_batch = 0;
+
+	return hdl;
+}
+
+/*! \brief Initialize batched FFT backend on an external buffer
+ *  \param[in] reverse FFT direction
+ *  \param[in] m FFT length
+ *  \param[in] howmany Number of transforms per execution
+ *  \param[in] buf Caller owned buffer transformed in place
+ *  \param[in] stride Distance between consecutive points of a transform
+ *  \param[in] dist Distance between the first points of two transforms
+ *
+ * Sample n of transform k is located at buf[k * dist + n * stride]. With a
+ * stride equal to the partition buffer length and a distance of one, each
+ * transform runs across the filterbank partitions directly, so no
+ * interleaving or copies through FFTW owned memory are necessary. The
+ * buffer contents are overwritten during planning and the buffer must
+ * remain valid for the lifetime of the handle.
+ */
+struct fft_hdl *init_fft_batch(int reverse, int m, int howmany,
+			       struct cmplx *buf, int stride, int dist)
+{
+	struct fft_hdl *hdl;
+	fftwf_complex *data = (fftwf_complex *) buf;
+
+	int direction = FFTW_FORWARD;
+	if (reverse)
+		direction = FFTW_BACKWARD;
+
+	if ((m <= 0) || (howmany <= 0) || !buf) {
+		fprintf(stderr, "init_fft_batch: invalid input\n");
+		return NULL;
+	}
+
+	hdl = (struct fft_hdl *) malloc(sizeof(struct fft_hdl));
+	if (!hdl)
+		return NULL;
+
+	hdl->fft_in = NULL;
+	hdl->fft_out = NULL;
+	hdl->fft_plan = fftwf_plan_many_dft(1, &m, howmany,
+					    data, NULL, stride, dist,
+					    data, NULL, stride, dist,
+					    direction, FFTW_MEASURE);
+	hdl->fft_len = m;
+	hdl->fft_batch = howmany;
+
+	if (!hdl->fft_plan) {
+		fprintf(stderr, "init_fft_batch: planning failed\n");
+		free(hdl);
+		return NULL;
+	}
 
 	return hdl;
 }
@@ -65,8 +120,11 @@ struct fft_hdl *init_fft(int reverse, int m)
 void free_fft(struct fft_hdl *hdl)
 {
 	fftwf_destroy_plan(hdl->fft_plan);
-	fftwf_free(hdl->fft_in);
-	fftwf_free(hdl->fft_out);
+
+	if (!hdl->fft_batch) {
+		fftwf_free(hdl->fft_in);
+		fftwf_free(hdl->fft_out);
+	}
 
 	free(hdl);
 }
@@ -83,6 +141,11 @@ int cxvec_fft(struct fft_hdl *hdl, struct cxvec *in, struct cxvec *out)
 	int i;
 	int fft_len = hdl->fft_len;
 
+	if (hdl->fft_batch) {
+		fprintf(stderr, "cxvec_fft: invalid batched handle\n");
+		return -1;
+	}
+
 	if (in->len % fft_len) {
 		fprintf(stderr, "cxvec_fft: invalid input length\n");
 		fprintf(stderr, "in->len %i, fft_len: fft_len %i\n",
@@ -102,3 +165,18 @@ int cxvec_fft(struct fft_hdl *hdl, struct cxvec *in, struct cxvec *out)
 
 	return 0;
 }
+
+/*! \brief Run all transforms of a batched FFT handle
+ *  \param[in] hdl Handle returned from init_fft_batch()
+ */
+int fft_batch_execute(struct fft_hdl *hdl)
+{
+	if (!hdl->fft_batch) {
+		fprintf(stderr, "fft_batch_execute: invalid handle\n");
+		return -1;
+	}
+
+	fftwf_execute(hdl->fft_plan);
+
+	return 0;
+}
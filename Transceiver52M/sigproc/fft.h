@@ -29,4 +29,9 @@ struct fft_hdl *init_fft(int reverse, int m);
 void free_fft(struct fft_hdl *hdl);
 int cxvec_fft(struct fft_hdl *hdl, struct cxvec *in, struct cxvec *out);
 
+/* Batched in-place transforms over caller owned strided buffers */
+struct fft_hdl *init_fft_batch(int reverse, int m, int howmany,
+			       struct cmplx *buf, int stride, int dist);
+int fft_batch_execute(struct fft_hdl *hdl);
+
 #endif /* _FFT_H_ */
@@ -0,0 +1,319 @@
+/*
+ * mlse.c
+ *
+ * Maximum likelihood sequence estimation for linearized GMSK
+ *
+ * Copyright (C) 2012 Thomas Tsou <ttsou@vt.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */ 
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+
+#ifdef USE_SSE3
+#include <xmmintrin.h>
+#endif
+
+#include "mlse.h"
+
+#define ALIGN_SZ		16
+
+/*
+ * Soft output sequence detection over a trellis of the most recent
+ * (taps - 1) binary symbols using forward and backward max-log metrics.
+ *
+ * Input samples and channel taps are symbol spaced with the GMSK rotation
+ * removed, so that the received signal is modeled as
+ *
+ *     in[n] = sum(h[k] * d[n - k]), d = +/-1
+ *
+ * A branch index packs the newest symbol in bit 0 and the oldest in bit
+ * (taps - 1), so the state after a branch is the index without its top bit
+ * and the previous state is the index shifted down by one. The output for
+ * each symbol is the difference of the best path metrics of -1 and +1, which
+ * reduces to 4 * Re(in[n]) for an ideal single tap channel.
+ */
+
+/*! \brief Allocate MLSE scratch state
+ *  \param[in] max_len Longest input in symbols
+ */
+struct mlse *mlse_alloc(int max_len)
+{
+	struct mlse *mlse;
+	float *buf;
+	int len;
+
+	if (max_len <= 0)
+		return NULL;
+
+	len = (max_len + 2) * MLSE_MAX_STATES + 8 * MLSE_MAX_STATES;
+	buf = (float *) memalign(ALIGN_SZ, len * sizeof(float));
+	if (!buf)
+		return NULL;
+
+	mlse = (struct mlse *) malloc(sizeof(struct mlse));
+	mlse->max_len = max_len;
+	mlse->alpha = buf;
+	mlse->beta[0] = &mlse->alpha[max_len * MLSE_MAX_STATES];
+	mlse->beta[1] = &mlse->beta[0][MLSE_MAX_STATES];
+	mlse->bm = &mlse->beta[1][MLSE_MAX_STATES];
+	mlse->yr = &mlse->bm[2 * MLSE_MAX_STATES];
+	mlse->yi = &mlse->yr[2 * MLSE_MAX_STATES];
+	mlse->e = &mlse->yi[2 * MLSE_MAX_STATES];
+
+	return mlse;
+}
+
+/*! \brief Free MLSE scratch state */
+void mlse_free(struct mlse *mlse)
+{
+	if (!mlse)
+		return;
+
+	free(mlse->alpha);
+	free(mlse);
+}
+
+/* Expected noiseless output and its energy for every branch */
+static void gen_branches(struct mlse *mlse, const cmplx *h, int taps)
+{
+	int i, k;
+	float yr, yi;
+
+	for (i = 0; i < 2 << (taps - 1); i++) {
+		yr = yi = 0.0f;
+		for (k = 0; k < taps; k++) {
+			if (i & (1 << k)) {
+				yr += h[k].real;
+				yi += h[k].imag;
+			} else {
+				yr -= h[k].real;
+				yi -= h[k].imag;
+			}
+		}
+
+		mlse->yr[i] = yr;
+		mlse->yi[i] = yi;
+		mlse->e[i] = yr * yr + yi * yi;
+	}
+}
+
+#ifdef USE_SSE3
+/* Branch metrics relative to the input energy, which is common to all */
+static void branch_metrics(struct mlse *mlse, const cmplx *in, int num)
+{
+	int i;
+	__m128 m0, m1, m2, rr, ri;
+
+	rr = _mm_set1_ps(in->real);
+	ri = _mm_set1_ps(in->imag);
+
+	for (i = 0; i < num; i += 4) {
+		m0 = _mm_mul_ps(rr, _mm_load_ps(&mlse->yr[i]));
+		m1 = _mm_mul_ps(ri, _mm_load_ps(&mlse->yi[i]));
+		m2 = _mm_add_ps(m0, m1);
+		m2 = _mm_add_ps(m2, m2);
+		_mm_store_ps(&mlse->bm[i], _mm_sub_ps(_mm_load_ps(&mlse->e[i]), m2));
+	}
+}
+
+/* Add-compare-select into the next state metrics, 8 states at a time */
+static void forward(const float *prev, float *next, const float *bm, int states)
+{
+	int i;
+	__m128 p0, p1, m0, m1;
+
+	for (i = 0; i < states; i += 8) {
+		p0 = _mm_load_ps(&prev[i / 2]);
+		p1 = _mm_load_ps(&prev[i / 2 + states / 2]);
+
+		m0 = _mm_add_ps(_mm_unpacklo_ps(p0, p0), _mm_load_ps(&bm[i]));
+		m1 = _mm_add_ps(_mm_unpacklo_ps(p1, p1), _mm_load_ps(&bm[i + states]));
+		_mm_store_ps(&next[i], _mm_min_ps(m0, m1));
+
+		m0 = _mm_add_ps(_mm_unpackhi_ps(p0, p0), _mm_load_ps(&bm[i + 4]));
+		m1 = _mm_add_ps(_mm_unpackhi_ps(p1, p1), _mm_load_ps(&bm[i + states + 4]));
+		_mm_store_ps(&next[i + 4], _mm_min_ps(m0, m1));
+	}
+}
+
+/* Best successor metrics of each state, 4 states at a time */
+static void backward(const float *next, float *prev, const float *bm, int states)
+{
+	int i;
+	__m128 m0, m1;
+
+	for (i = 0; i < states; i += 4) {
+		m0 = _mm_add_ps(_mm_load_ps(&next[(2 * i) & (states - 1)]),
+				_mm_load_ps(&bm[2 * i]));
+		m1 = _mm_add_ps(_mm_load_ps(&next[(2 * i + 4) & (states - 1)]),
+				_mm_load_ps(&bm[2 * i + 4]));
+
+		_mm_store_ps(&prev[i],
+			     _mm_min_ps(_mm_shuffle_ps(m0, m1, _MM_SHUFFLE(2, 0, 2, 0)),
+					_mm_shuffle_ps(m0, m1, _MM_SHUFFLE(3, 1, 3, 1))));
+	}
+}
+
+/* Best full path metric of -1 less that of +1 for the newest symbol */
+static float decide(const float *alpha, const float *beta, int states)
+{
+	int i;
+	float lo[4], hi[4];
+	__m128 m0, m1, neg, pos;
+
+	neg = pos = _mm_set1_ps(1e30f);
+
+	for (i = 0; i < states; i += 8) {
+		m0 = _mm_add_ps(_mm_load_ps(&alpha[i]), _mm_load_ps(&beta[i]));
+		m1 = _mm_add_ps(_mm_load_ps(&alpha[i + 4]), _mm_load_ps(&beta[i + 4]));
+
+		neg = _mm_min_ps(neg, _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(2, 0, 2, 0)));
+		pos = _mm_min_ps(pos, _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+	neg = _mm_min_ps(neg, _mm_movehl_ps(neg, neg));
+	pos = _mm_min_ps(pos, _mm_movehl_ps(pos, pos));
+	_mm_storeu_ps(lo, neg);
+	_mm_storeu_ps(hi, pos);
+
+	return (lo[0] < lo[1] ? lo[0] : lo[1]) - (hi[0] < hi[1] ? hi[0] : hi[1]);
+}
+#else
+static void branch_metrics(struct mlse *mlse, const cmplx *in, int num)
+{
+	int i;
+	float m;
+
+	for (i = 0; i < num; i++) {
+		m = in->real * mlse->yr[i] + in->imag * mlse->yi[i];
+		mlse->bm[i] = mlse->e[i] - (m + m);
+	}
+}
+
+static void forward(const float *prev, float *next, const float *bm, int states)
+{
+	int i;
+	float m0, m1;
+
+	for (i = 0; i < states; i++) {
+		m0 = prev[i / 2] + bm[i];
+		m1 = prev[i / 2 + states / 2] + bm[i + states];
+		next[i] = m0 < m1 ? m0 : m1;
+	}
+}
+
+static void backward(const float *next, float *prev, const float *bm, int states)
+{
+	int i;
+	float m0, m1;
+
+	for (i = 0; i < states; i++) {
+		m0 = next[(2 * i) & (states - 1)] + bm[2 * i];
+		m1 = next[(2 * i + 1) & (states - 1)] + bm[2 * i + 1];
+		prev[i] = m0 < m1 ? m0 : m1;
+	}
+}
+
+static float decide(const float *alpha, const float *beta, int states)
+{
+	int i;
+	float m, neg = 1e30f, pos = 1e30f;
+
+	for (i = 0; i < states; i++) {
+		m = alpha[i] + beta[i];
+		if (i & 1) {
+			if (m < pos)
+				pos = m;
+		} else if (m < neg) {
+			neg = m;
+		}
+	}
+
+	return neg - pos;
+}
+#endif
+
+/*! \brief Detect a symbol spaced sequence with soft outputs
+ *  \param[in] mlse Scratch state
+ *  \param[in] h Channel taps with the GMSK rotation removed
+ *  \param[in] taps Number of channel taps, at most MLSE_MAX_TAPS
+ *  \param[in] in Input samples with the GMSK rotation removed
+ *  \param[in] len Number of input samples, at most the allocated length
+ *  \param[out] llr Path metric difference of each symbol, positive for +1
+ *  \param[in] llr_len Number of outputs, at most len
+ *
+ *  Symbols before the first input are treated as unknown.
+ */
+int mlse_detect(struct mlse *mlse, const cmplx *h, int taps,
+		const cmplx *in, int len, float *llr, int llr_len)
+{
+	int n, states;
+	float *alpha, *beta, *prev;
+	cmplx pad[MLSE_MIN_TAPS];
+
+	if ((taps <= 0) || (taps > MLSE_MAX_TAPS) ||
+	    (len > mlse->max_len) || (llr_len > len))
+		return -1;
+
+	if (taps < MLSE_MIN_TAPS) {
+		memset(pad, 0, sizeof(pad));
+		memcpy(pad, h, taps * sizeof(cmplx));
+		h = pad;
+		taps = MLSE_MIN_TAPS;
+	}
+
+	states = 1 << (taps - 1);
+	gen_branches(mlse, h, taps);
+
+	/* Forward metrics for every symbol from an unknown starting state */
+	memset(mlse->beta[0], 0, states * sizeof(float));
+	alpha = mlse->beta[0];
+
+	for (n = 0; n < len; n++) {
+		branch_metrics(mlse, &in[n], 2 * states);
+		forward(alpha, &mlse->alpha[n * states], mlse->bm, states);
+		alpha = &mlse->alpha[n * states];
+	}
+
+	/* Backward metrics and decisions from an unterminated end */
+	beta = mlse->beta[0];
+	prev = mlse->beta[1];
+	memset(beta, 0, states * sizeof(float));
+
+	for (n = len - 1; n >= 0; n--) {
+		if (n < llr_len)
+			llr[n] = decide(&mlse->alpha[n * states], beta, states);
+
+		if (!n)
+			break;
+
+		branch_metrics(mlse, &in[n], 2 * states);
+		backward(beta, prev, mlse->bm, states);
+
+		alpha = beta;
+		beta = prev;
+		prev = alpha;
+	}
+
+	return 0;
+}
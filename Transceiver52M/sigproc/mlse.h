@@ -0,0 +1,50 @@
+/*
+ * mlse.h
+ *
+ * Maximum likelihood sequence estimation for linearized GMSK
+ *
+ * Copyright (C) 2012 Thomas Tsou <ttsou@vt.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */ 
+
+#ifndef _MLSE_H_
+#define _MLSE_H_
+
+#include "sigvec.h"
+
+/* Channel length limits in symbols, shorter channels are zero padded */
+#define MLSE_MIN_TAPS		4
+#define MLSE_MAX_TAPS		6
+#define MLSE_MAX_STATES		(1 << (MLSE_MAX_TAPS - 1))
+
+/*! \brief MLSE equalizer scratch state */
+struct mlse {
+	int max_len;
+	float *alpha;
+	float *beta[2];
+	float *bm;
+	float *yr;
+	float *yi;
+	float *e;
+};
+
+struct mlse *mlse_alloc(int max_len);
+void mlse_free(struct mlse *mlse);
+
+int mlse_detect(struct mlse *mlse, const cmplx *h, int taps,
+		const cmplx *in, int len, float *llr, int llr_len);
+
+#endif /* _MLSE_H_ */
@@ -28,6 +28,7 @@ extern "C" {
 #include "sigvec.h"
 #include "convolve.h"
 #include "fft.h"
+#include "mlse.h"
 
 #ifdef __cplusplus
 }
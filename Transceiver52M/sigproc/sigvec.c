@@ -39,8 +39,19 @@
  */
 #define ALIGN_SZ		16
 
-static void cxvec_init(struct cxvec *vec, int len, int buf_len,
-		       int start, cmplx *buf, int flags)
+/*! \brief Initialize a complex vector around an existing buffer
+ *  \param[in] vec The complex vector to initialize
+ *  \param[in] len Length of useful data in complex samples
+ *  \param[in] buf_len The buffer length in complex samples
+ *  \param[in] start Starting index for useful data
+ *  \param[in] buf Pointer to the buffer
+ *  \param[in] flags Flags for various vector attributes
+ *
+ *  No memory is allocated, which allows wrapping externally owned or
+ *  stack based vectors.
+ */
+void cxvec_init(struct cxvec *vec, int len, int buf_len,
+		int start, cmplx *buf, int flags)
 {
 	vec->len = len;
 	vec->buf_len = buf_len;
@@ -56,7 +67,8 @@ static void cxvec_init(struct cxvec *vec, int len, int buf_len,
  *  \param[in] buf Pointer to a pre-existing buffer
  *  \param[in] flags Flags for various vector attributes
  *
- *  If buf is NULL, then a buffer will be allocated.
+ *  If buf is NULL, then a buffer will be allocated. Returns NULL on invalid
+ *  input or if memory cannot be allocated.
  */
 struct cxvec *cxvec_alloc(int len, int start, cmplx *buf, int flags)
 {
@@ -69,12 +81,19 @@ struct cxvec *cxvec_alloc(int len, int start, cmplx *buf, int flags)
 	}
 
 	vec = (struct cxvec *) malloc(sizeof(struct cxvec));
+	if (!vec)
+		return NULL;
 
 	if (!buf) {
 		if (flags & CXVEC_FLG_MEM_ALIGN)
 			buf = (cmplx *) memalign(ALIGN_SZ, sizeof(cmplx) * len);
 		else
 			buf = (cmplx *) malloc(sizeof(cmplx) * len);
+
+		if (!buf) {
+			free(vec);
+			return NULL;
+		}
 	}
 
 	cxvec_init(vec, len - start, len, start, buf, flags);
@@ -170,6 +189,42 @@ int cxvec_interlv(struct cxvec **in, struct cxvec *out, int m)
 	return i;
 }
 
+/* Round and saturate to the 16-bit range */
+static inline short sat_sc16(float val)
+{
+	long rnd = lrintf(val);
+
+	if (rnd > 32767)
+		return 32767;
+	if (rnd < -32768)
+		return -32768;
+
+	return rnd;
+}
+
+/*! \brief Interleave M complex vectors into 16-bit I/Q samples
+ *  \param[in] in Complex input vector pointers
+ *  \param[out] out Interleaved I/Q output of 2 * M * in[0]->len values
+ *  \param[in] m Number of channels
+ *  \param[in] scale Gain applied prior to rounding and saturation
+ *
+ *  Equivalent to cxvec_interlv() followed by conversion to sc16.
+ */
+int cxvec_interlv_sc16(struct cxvec **in, short *out, int m, float scale)
+{
+	int i, n;
+	short *dst = out;
+
+	for (i = 0; i < in[0]->len; i++) {
+		for (n = 0; n < m; n++) {
+			*dst++ = sat_sc16(in[n]->data[i].real * scale);
+			*dst++ = sat_sc16(in[n]->data[i].imag * scale);
+		}
+	}
+
+	return i;
+}
+
 /*! \brief Reverse a complex vector
  *  \param[in] in Complex input vector
  *  \param[out] out Complex output vector pointers
@@ -54,6 +54,8 @@ enum cxvec_conv_type {
 /* Complex vectors */
 struct cxvec *cxvec_alloc(int len, int start, cmplx *buf, int flags);
 void cxvec_free(struct cxvec *vec);
+void cxvec_init(struct cxvec *vec, int len, int buf_len,
+		int start, cmplx *buf, int flags);
 void cxvec_reset(struct cxvec *vec);
 int cxvec_rvrs(struct cxvec *in, struct cxvec *out);
 int cxvec_cp(struct cxvec *dst, struct cxvec *src);
@@ -67,6 +69,7 @@ int cxvecs_set_idx(struct cxvec **vecs, int m, int idx);
 
 /* Interleavers */
 int cxvec_interlv(struct cxvec **in, struct cxvec *out, int chan_m);
+int cxvec_interlv_sc16(struct cxvec **in, short *out, int chan_m, float scale);
 int cxvec_deinterlv_fw(struct cxvec *in, struct cxvec **out, int chan_m);
 int cxvec_deinterlv_rv(struct cxvec *in, struct cxvec **out, int chan_m);
 
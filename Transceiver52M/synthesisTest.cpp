@@ -0,0 +1,325 @@
+/*
+ * Synthesis filterbank 16-bit output and sparse transform test
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+/*
+ * Drives identical random input through the floating point and 16-bit
+ * synthesis outputs and checks that the 16-bit samples stay within
+ * rounding of the floating point output scaled to full scale.
+ *
+ * Also checks the sparse transform, used when few channels are active,
+ * against the full FFT of a filterbank with every channel active, for
+ * both the synthesis and the receive channelizer, with a channel
+ * activated while streaming.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <iostream>
+
+#include <Logger.h>
+#include <Configuration.h>
+
+#include "Synthesis.h"
+#include "Channelizer.h"
+#include "radioParams.h"
+
+using namespace std;
+
+ConfigurationTable gConfig;
+
+#define CHUNKMUL		9
+#define INCHUNK			(RESAMP_INRATE * CHUNKMUL)
+#define OUTCHUNK		(RESAMP_OUTRATE * CHUNKMUL)
+#define NUM_CHUNKS		16
+
+/* Allowed deviation in 16-bit steps, rounding plus float accumulation */
+#define MAX_ERROR		0.6
+
+/* Allowed deviation of the sparse transform from the full FFT */
+#define MAX_SPARSE_ERROR	1e-4
+
+static Synthesis *createSynth(int chanM, int *active, int numActive)
+{
+	Synthesis *synth = new Synthesis(chanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
+					 RESAMP_OUTRATE, RESAMP_INRATE, CHUNKMUL);
+	if (!synth->init(NULL))
+		return NULL;
+
+	for (int i = 0; i < numActive; i++)
+		synth->activateChan(active[i]);
+
+	return synth;
+}
+
+/* Random input near GSM amplitude with occasional peaks into saturation */
+static void loadInput(struct cxvec **in, int chanM, float ampl)
+{
+	for (int n = 0; n < chanM; n++) {
+		for (int i = 0; i < in[n]->len; i++) {
+			float scale = (random() % 64) ? ampl : 4.0f * ampl;
+			in[n]->data[i].real = scale * (2.0f * random() / RAND_MAX - 1.0f);
+			in[n]->data[i].imag = scale * (2.0f * random() / RAND_MAX - 1.0f);
+		}
+	}
+}
+
+static bool testSynthesis(int chanM, int *active, int numActive)
+{
+	int i, n;
+	double err, maxErr = 0.0;
+	int clipped = 0;
+
+	Synthesis *floatSynth = createSynth(chanM, active, numActive);
+	Synthesis *shortSynth = createSynth(chanM, active, numActive);
+	if (!floatSynth || !shortSynth) {
+		cout << "Failed to initialize synthesis filterbank" << endl;
+		return false;
+	}
+
+	struct cxvec *in[CHAN_MAX];
+	for (n = 0; n < chanM; n++) {
+		in[n] = cxvec_alloc(INCHUNK + RESAMP_FILT_LEN,
+				    RESAMP_FILT_LEN, NULL, 0);
+		in[n]->len = INCHUNK;
+	}
+
+	struct cxvec *floatOut = cxvec_alloc(OUTCHUNK * chanM, 0, NULL, 0);
+	short *shortOut = new short[2 * OUTCHUNK * chanM];
+
+	for (int chunk = 0; chunk < NUM_CHUNKS; chunk++) {
+		loadInput(in, chanM, 0.5f / numActive);
+
+		floatSynth->rotate(in, floatOut);
+		shortSynth->rotate(in, shortOut, OUTCHUNK * chanM, SHRT_MAX);
+
+		for (i = 0; i < OUTCHUNK * chanM; i++) {
+			float ref[2] = { floatOut->data[i].real * SHRT_MAX,
+					 floatOut->data[i].imag * SHRT_MAX };
+
+			for (n = 0; n < 2; n++) {
+				if (fabs(ref[n]) > SHRT_MAX) {
+					if (shortOut[2 * i + n] != (ref[n] > 0 ? SHRT_MAX : SHRT_MIN)) {
+						cout << "Sample " << i << " not saturated" << endl;
+						return false;
+					}
+					clipped++;
+					continue;
+				}
+
+				err = fabs(ref[n] - shortOut[2 * i + n]);
+				if (err > maxErr)
+					maxErr = err;
+			}
+		}
+	}
+
+	cout << chanM << " channels, " << numActive << " active: "
+	     << "max error " << maxErr << " LSB, "
+	     << clipped << " saturated" << endl;
+
+	for (n = 0; n < chanM; n++)
+		cxvec_free(in[n]);
+	cxvec_free(floatOut);
+	delete[] shortOut;
+	delete floatSynth;
+	delete shortSynth;
+
+	return maxErr <= MAX_ERROR;
+}
+
+static bool isListed(int chan, int *list, int num)
+{
+	for (int i = 0; i < num; i++) {
+		if (list[i] == chan)
+			return true;
+	}
+
+	return false;
+}
+
+/* Largest difference from the reference, and the reference peak */
+static double maxDiff(struct cxvec *a, struct cxvec *ref, int len,
+		      double *peak)
+{
+	double diff = 0.0;
+
+	for (int i = 0; i < len; i++) {
+		diff = fmax(diff, fabs(a->data[i].real - ref->data[i].real));
+		diff = fmax(diff, fabs(a->data[i].imag - ref->data[i].imag));
+		*peak = fmax(*peak, fabs(ref->data[i].real));
+	}
+
+	return diff;
+}
+
+/* Reference output must carry signal for the comparison to mean anything */
+#define MIN_PEAK		0.01
+
+/*
+ * Synthesis with 'active' channels on from the start and 'late' switched
+ * on halfway, against full synthesis with zeros on the other channels
+ */
+static bool testSparseSynthesis(int chanM, int *active, int numActive, int late)
+{
+	int n, all[CHAN_MAX];
+	double maxErr = 0.0, peak = 0.0;
+
+	for (n = 0; n < chanM; n++)
+		all[n] = n;
+
+	Synthesis *sparse = createSynth(chanM, active, numActive);
+	Synthesis *full = createSynth(chanM, all, chanM);
+	if (!sparse || !full) {
+		cout << "Failed to initialize synthesis filterbank" << endl;
+		return false;
+	}
+
+	struct cxvec *in[CHAN_MAX];
+	for (n = 0; n < chanM; n++) {
+		in[n] = cxvec_alloc(INCHUNK + RESAMP_FILT_LEN,
+				    RESAMP_FILT_LEN, NULL, 0);
+		in[n]->len = INCHUNK;
+	}
+
+	struct cxvec *sparseOut = cxvec_alloc(OUTCHUNK * chanM, 0, NULL, 0);
+	struct cxvec *fullOut = cxvec_alloc(OUTCHUNK * chanM, 0, NULL, 0);
+
+	for (int chunk = 0; chunk < NUM_CHUNKS; chunk++) {
+		if (chunk == NUM_CHUNKS / 2)
+			sparse->activateChan(late);
+
+		loadInput(in, chanM, 0.5f / (numActive + 1));
+		for (n = 0; n < chanM; n++) {
+			if (isListed(n, active, numActive) ||
+			    ((n == late) && (chunk >= NUM_CHUNKS / 2)))
+				continue;
+			cxvec_reset(in[n]);
+		}
+
+		sparse->rotate(in, sparseOut);
+		full->rotate(in, fullOut);
+
+		maxErr = fmax(maxErr, maxDiff(sparseOut, fullOut,
+					      OUTCHUNK * chanM, &peak));
+	}
+
+	cout << chanM << " channel sparse synthesis, " << numActive
+	     << "+1 active: max error " << maxErr << ", peak " << peak << endl;
+
+	for (n = 0; n < chanM; n++)
+		cxvec_free(in[n]);
+	cxvec_free(sparseOut);
+	cxvec_free(fullOut);
+	delete sparse;
+	delete full;
+
+	return (maxErr <= MAX_SPARSE_ERROR) && (peak >= MIN_PEAK);
+}
+
+/*
+ * Channelizer with 'active' channels on from the start and 'late' switched
+ * on halfway, against the full channelizer. The late channel is compared
+ * once its resampler history has been refilled.
+ */
+static bool testSparseChannelizer(int chanM, int *active, int numActive, int late)
+{
+	int i, n;
+	double maxErr = 0.0, peak = 0.0;
+
+	Channelizer *sparse = new Channelizer(chanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
+					      RESAMP_INRATE, RESAMP_OUTRATE, CHUNKMUL);
+	Channelizer *full = new Channelizer(chanM, CHAN_FILT_LEN, RESAMP_FILT_LEN,
+					    RESAMP_INRATE, RESAMP_OUTRATE, CHUNKMUL);
+	if (!sparse->init(NULL) || !full->init(NULL)) {
+		cout << "Failed to initialize channelizer" << endl;
+		return false;
+	}
+
+	for (i = 0; i < numActive; i++)
+		sparse->activateChan(active[i]);
+	for (n = 0; n < chanM; n++)
+		full->activateChan(n);
+
+	struct cxvec *in = cxvec_alloc(OUTCHUNK * chanM, 0, NULL, 0);
+	struct cxvec *sparseOut[CHAN_MAX], *fullOut[CHAN_MAX];
+	for (n = 0; n < chanM; n++) {
+		sparseOut[n] = cxvec_alloc(INCHUNK, 0, NULL, 0);
+		fullOut[n] = cxvec_alloc(INCHUNK, 0, NULL, 0);
+	}
+
+	for (int chunk = 0; chunk < NUM_CHUNKS; chunk++) {
+		if (chunk == NUM_CHUNKS / 2)
+			sparse->activateChan(late);
+
+		for (i = 0; i < in->len; i++) {
+			in->data[i].real = 2.0f * random() / RAND_MAX - 1.0f;
+			in->data[i].imag = 2.0f * random() / RAND_MAX - 1.0f;
+		}
+
+		sparse->rotate(in, sparseOut);
+		full->rotate(in, fullOut);
+
+		for (n = 0; n < chanM; n++) {
+			if (isListed(n, active, numActive) ||
+			    ((n == late) && (chunk > NUM_CHUNKS / 2)))
+				maxErr = fmax(maxErr, maxDiff(sparseOut[n],
+							      fullOut[n], INCHUNK,
+							      &peak));
+		}
+	}
+
+	cout << chanM << " channel sparse channelizer, " << numActive
+	     << "+1 active: max error " << maxErr << ", peak " << peak << endl;
+
+	cxvec_free(in);
+	for (n = 0; n < chanM; n++) {
+		cxvec_free(sparseOut[n]);
+		cxvec_free(fullOut[n]);
+	}
+	delete sparse;
+	delete full;
+
+	return (maxErr <= MAX_SPARSE_ERROR) && (peak >= MIN_PEAK);
+}
+
+int main(int argc, char **argv)
+{
+	int active1[] = { 0 };
+	int active5[] = { 2, 1, 4 };
+	int active10[] = { 5, 4, 3, 2, 1, 0, 9, 8 };
+
+	gLogInit("synthesisTest", "WARNING");
+	srandom(1);
+
+	if (!testSynthesis(1, active1, 1) ||
+	    !testSynthesis(5, active5, 3) ||
+	    !testSynthesis(10, active10, 8) ||
+	    !testSparseSynthesis(10, active1, 1, 7) ||
+	    !testSparseSynthesis(10, active5, 2, 9) ||
+	    !testSparseChannelizer(10, active1, 1, 7) ||
+	    !testSparseChannelizer(10, active5, 2, 9)) {
+		cout << "FAIL" << endl;
+		return 1;
+	}
+
+	cout << "PASS" << endl;
+	return 0;
+}
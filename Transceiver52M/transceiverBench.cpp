@@ -0,0 +1,1176 @@
+/*
+ * Transceiver throughput and latency benchmark
+ *
+ * Copyright 2012  Thomas Tsou <ttsou@vt.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * See the COPYING file in the main directory for details.
+ */
+
+/*
+ * Measures the transceiver without hardware in two parts. First, the
+ * modulator, demodulator, channelizer and synthesis filterbank are timed
+ * in isolation to give per-stage latency percentiles and an estimate of
+ * the ARFCN's a single core can sustain. The equalizers are compared for
+ * cost and bit error rate on simulated multipath. Second, the complete radio
+ * interface, drive loop and transceiver stack runs against a DummyLoad
+ * that replays recorded or synthetic multi-ARFCN I/Q, while this program
+ * stands in for the GSM core on the UDP interfaces. By default the sample
+ * clock is unpaced so the stack runs as fast as it is able. With several
+ * devices, the stack is replicated on one DummyLoad per device sharing a
+ * worker pool, and all devices follow the clock of the first. Bursts move
+ * over the UDP data sockets, singly or batched into framed datagrams, or
+ * over shared memory rings when requested.
+ *
+ * Usage: transceiverBench [-c ARFCNs] [-d devices] [-w workers]
+ *                         [-t seconds] [-s speed] [-l slack] [-f file]
+ *                         [-p port] [-m] [-b batch]
+ *
+ * A replay file contains interleaved 32-bit float I/Q at the device rate of
+ * the selected channelizer, 400 kHz per channel.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <sys/resource.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include <algorithm>
+#include <vector>
+#include <iostream>
+
+#include <GSMCommon.h>
+#include <Logger.h>
+#include <Configuration.h>
+
+#include "Transceiver.h"
+#include "WorkerPool.h"
+#include "DummyLoad.h"
+#include "Channelizer.h"
+#include "Synthesis.h"
+#include "radioParams.h"
+
+using namespace std;
+
+ConfigurationTable gConfig;
+
+int Transceiver::mTSC = 0;
+
+/* Channelizer chunk sizes, must match the channelizing radio interface */
+#ifdef INCHUNK
+  #undef INCHUNK
+#endif
+#ifdef OUTCHUNK
+  #undef OUTCHUNK
+#endif
+
+#define CHUNKMUL		9
+#define INCHUNK			(RESAMP_INRATE * CHUNKMUL)
+#define OUTCHUNK		(RESAMP_OUTRATE * CHUNKMUL)
+
+/* Shortest synthetic loop aligned to both chunks and timeslots, 468 slots */
+#define REPLAY_CHUNKS		125
+
+/* Synthesis delay of the synthetic loop beyond the calibrated device offset */
+#define REPLAY_DELAY_SYMS	4
+
+#define STAGE_ITERS		2000
+#define EQ_BURSTS		500
+#define EQ_MAX_DELAY		6
+#define RACH_ITERS		200
+#define BENCH_TSC		0
+#define RX_OFFSET_SLOTS		3
+#define TX_LEAD_FRAMES		8
+#define WARMUP_SECS		1
+#define MAX_DEVICES		4
+
+/* Received burst rate of a single ARFCN */
+#define BURST_RATE		(GSM_RATE / 156.25)
+
+/* Symbol spaced multipath profiles for the equalizer comparison */
+struct EqProfile {
+	const char *name;
+	int taps;
+	float gain[EQ_MAX_DELAY][2];
+};
+
+static const EqProfile eqProfiles[] = {
+	{ "1 path", 1, { { 1.0f, 0.0f } } },
+	{ "2 path 2 sym", 3, { { 0.8f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.6f } } },
+	{ "3 path 3 sym", 4, { { 0.8f, 0.0f }, { 0.3f, 0.4f }, { 0.0f, 0.0f },
+			       { -0.3f, 0.2f } } },
+};
+
+static const float eqSNR[] = { 6.0f, 10.0f, 14.0f };
+
+struct CoreChannel {
+	int index;
+	UDPSocket *control;
+	UDPSocket *data;
+	BurstLink link;
+	BurstFrame *txFrame;
+	uint32_t txFrameFN;
+	DummyLoad *dev;
+	GSM::Time start;
+	int chanM;
+	unsigned seed;
+	Thread *thread;
+	volatile bool running;
+	volatile bool measure;
+	volatile unsigned rxBursts;
+	volatile unsigned txBursts;
+	vector<float> latency;
+};
+
+static double elapsedUs(const struct timespec &a, const struct timespec &b)
+{
+	return (b.tv_sec - a.tv_sec) * 1.0e6 + (b.tv_nsec - a.tv_nsec) * 1.0e-3;
+}
+
+/* Time stamp counter ticks, zero where not available */
+static unsigned long long readTSC()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static double cpuSeconds()
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1.0e-6 +
+	       usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1.0e-6;
+}
+
+/* Print latency percentiles and return the mean */
+static double printLatency(const char *name, vector<float> &usec)
+{
+	double sum = 0.0;
+
+	if (!usec.size()) {
+		cout << "  " << name << ": no samples" << endl;
+		return 0.0;
+	}
+
+	sort(usec.begin(), usec.end());
+	for (size_t i = 0; i < usec.size(); i++)
+		sum += usec[i];
+
+	size_t n = usec.size() - 1;
+
+	printf("  %-14s p50 %9.2f  p90 %9.2f  p99 %9.2f  max %9.2f  mean %9.2f us\n",
+	       name, usec[n / 2], usec[n * 9 / 10], usec[n * 99 / 100],
+	       usec[n], sum / usec.size());
+
+	return sum / usec.size();
+}
+
+/* Random normal burst bits around the benchmark training sequence */
+static BitVector randomBurst(unsigned *seed)
+{
+	BitVector burst(gSlotLen);
+	BitVector::iterator itr = burst.begin();
+
+	for (int i = 0; i < 61; i++)
+		*itr++ = rand_r(seed) & 0x01;
+
+	gTrainingSequence[BENCH_TSC].copyToSegment(burst, 61);
+
+	for (itr += 26; itr < burst.end(); itr++)
+		*itr = rand_r(seed) & 0x01;
+
+	return burst;
+}
+
+/* Random access burst with the synchronization sequence after the tail */
+static BitVector randomAccessBurst(unsigned *seed)
+{
+	BitVector burst(88);
+
+	for (size_t i = 0; i < burst.size(); i++)
+		burst[i] = rand_r(seed) & 0x01;
+
+	for (size_t i = 0; i < gRACHSynchSequence.size(); i++)
+		burst[8 + i] = gRACHSynchSequence[i] & 0x01;
+
+	return burst;
+}
+
+static Channelizer *createChan(int chanM, int *map, int numARFCN)
+{
+	Channelizer *chan = new Channelizer(chanM, CHAN_FILT_LEN,
+					    RESAMP_FILT_LEN, RESAMP_INRATE,
+					    RESAMP_OUTRATE, CHUNKMUL);
+	if (!chan->init(NULL))
+		return NULL;
+
+	for (int i = 0; i < numARFCN; i++)
+		chan->activateChan(map[i]);
+
+	return chan;
+}
+
+static Synthesis *createSynth(int chanM, int *map, int numARFCN)
+{
+	Synthesis *synth = new Synthesis(chanM, CHAN_FILT_LEN,
+					 RESAMP_FILT_LEN, RESAMP_OUTRATE,
+					 RESAMP_INRATE, CHUNKMUL);
+	if (!synth->init(NULL))
+		return NULL;
+
+	for (int i = 0; i < numARFCN; i++)
+		synth->activateChan(map[i]);
+
+	return synth;
+}
+
+static void randomVector(struct cxvec *vec, unsigned *seed)
+{
+	for (int i = 0; i < vec->len; i++) {
+		vec->data[i].real = (float) rand_r(seed) / RAND_MAX - 0.5f;
+		vec->data[i].imag = (float) rand_r(seed) / RAND_MAX - 0.5f;
+	}
+}
+
+/*
+ * Time each signal processing stage in isolation and estimate the number of
+ * ARFCN's that fit on one core alongside a filterbank of this size.
+ */
+static bool benchStages(int numARFCN, int chanM, int *map,
+			signalVector *pulse)
+{
+	int i, n;
+	unsigned seed = 1;
+	struct timespec t0, t1;
+	vector<float> modLat, demodLat, chanLat, synthLat;
+
+	modLat.reserve(STAGE_ITERS);
+	demodLat.reserve(STAGE_ITERS);
+	chanLat.reserve(STAGE_ITERS);
+	synthLat.reserve(STAGE_ITERS);
+
+	/* Modulator */
+	for (i = 0; i < STAGE_ITERS; i++) {
+		BitVector burst = randomBurst(&seed);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		signalVector *modBurst = modulateBurst(burst, *pulse, 8,
+						       SAMPSPERSYM);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		modLat.push_back(elapsedUs(t0, t1));
+		delete modBurst;
+	}
+
+	/* Detection and demodulation of a noisy normal burst */
+	signalVector *rxTemplate = modulateBurst(randomBurst(&seed), *pulse, 8,
+						 SAMPSPERSYM);
+	signalVector *noise = gaussianNoise(rxTemplate->size(), 0.01);
+	addVector(*rxTemplate, *noise);
+	delete noise;
+
+	signalVector rxBurst(rxTemplate->size());
+	SoftVector bits(gSlotLen);
+	DemodWorkspace ws(SAMPSPERSYM);
+	unsigned detected = 0;
+
+	for (i = 0; i < STAGE_ITERS; i++) {
+		complex amplitude;
+		float TOA;
+
+		rxTemplate->copyTo(rxBurst);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		if (analyzeTrafficBurst(rxBurst, BENCH_TSC, 3.0, SAMPSPERSYM,
+					&amplitude, &TOA, 0, NULL, NULL, ws)) {
+			demodulateBurst(rxBurst, *pulse, SAMPSPERSYM,
+					amplitude, TOA, bits, ws);
+			detected++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		demodLat.push_back(elapsedUs(t0, t1));
+	}
+	delete rxTemplate;
+
+	if (detected != STAGE_ITERS) {
+		cout << "Demodulator failed to detect benchmark burst" << endl;
+		return false;
+	}
+
+	/* Channelizer and synthesis filterbank, one chunk per call */
+	Channelizer *chan = createChan(chanM, map, numARFCN);
+	Synthesis *synth = createSynth(chanM, map, numARFCN);
+	if (!chan || !synth) {
+		cout << "Failed to initialize filterbanks" << endl;
+		return false;
+	}
+
+	struct cxvec *highRate = cxvec_alloc(OUTCHUNK * chanM, 0, NULL, 0);
+	struct cxvec *lowRate[CHAN_MAX];
+
+	for (n = 0; n < chanM; n++) {
+		lowRate[n] = cxvec_alloc(INCHUNK + RESAMP_FILT_LEN,
+					 RESAMP_FILT_LEN, NULL, 0);
+		lowRate[n]->len = INCHUNK;
+	}
+
+	for (i = 0; i < STAGE_ITERS; i++) {
+		randomVector(highRate, &seed);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		chan->rotate(highRate, lowRate);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		chanLat.push_back(elapsedUs(t0, t1));
+
+		for (n = 0; n < chanM; n++) {
+			lowRate[n]->len = INCHUNK;
+			randomVector(lowRate[n], &seed);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		synth->rotate(lowRate, highRate);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		synthLat.push_back(elapsedUs(t0, t1));
+	}
+
+	for (n = 0; n < chanM; n++)
+		cxvec_free(lowRate[n]);
+	cxvec_free(highRate);
+	delete chan;
+	delete synth;
+
+	cout << "Stage latency, " << STAGE_ITERS << " calls each" << endl;
+	double modMean = printLatency("modulate", modLat);
+	double demodMean = printLatency("demodulate", demodLat);
+	double chanMean = printLatency("channelizer", chanLat);
+	double synthMean = printLatency("synthesis", synthLat);
+
+	/* Load as a fraction of one core at real time */
+	double chunkRate = CHAN_RATE / OUTCHUNK;
+	double fbLoad = (chanMean + synthMean) * 1.0e-6 * chunkRate;
+	double arfcnLoad = (modMean + demodMean) * 1.0e-6 * BURST_RATE;
+
+	printf("  filterbank load %.3f core, per-ARFCN load %.3f core\n",
+	       fbLoad, arfcnLoad);
+	printf("  estimated ARFCN's per core %.1f\n",
+	       fbLoad < 1.0 ? (1.0 - fbLoad) / arfcnLoad : 0.0);
+
+	return true;
+}
+
+/* Bit errors over the burst payload, excluding tails and training sequence */
+static int payloadErrors(const BitVector &burst, const SoftVector &bits)
+{
+	int errors = 0;
+
+	for (int i = 3; i < 145; i++) {
+		if ((i >= 61) && (i < 87))
+			continue;
+		if ((bits[i] > 0.5f) != (bool) burst.bit(i))
+			errors++;
+	}
+
+	return errors;
+}
+
+/*
+ * Compare the decision feedback and sequence estimating equalizers on
+ * static multipath channels. Both use the channel estimated from each
+ * burst. Only the equalizer call is timed, since the DFE filter design is
+ * amortized over many bursts in the transceiver.
+ */
+static void benchEqualizers(signalVector *pulse)
+{
+	unsigned seed = 3;
+	unsigned long long c0, c1, dfeCycles = 0, mlseCycles = 0;
+	struct timespec t0, t1;
+	double dfeUs = 0.0, mlseUs = 0.0;
+	unsigned timed = 0;
+
+	DemodWorkspace ws(SAMPSPERSYM);
+	SoftVector bits(gSlotLen);
+	signalVector chan(6 * SAMPSPERSYM);
+
+	cout << "Equalizers, " << EQ_BURSTS << " bursts per point, "
+	     << "maximum delay " << EQ_MAX_DELAY << " symbols" << endl;
+	printf("  %-14s %4s %8s %10s %10s %10s\n",
+	       "channel", "SNR", "detected", "BER none", "BER DFE", "BER MLSE");
+
+	for (size_t p = 0; p < sizeof(eqProfiles) / sizeof(eqProfiles[0]); p++) {
+		const EqProfile &prof = eqProfiles[p];
+
+		for (size_t s = 0; s < sizeof(eqSNR) / sizeof(eqSNR[0]); s++) {
+			int detected = 0, errors[3] = { 0, 0, 0 };
+			float variance = pow(10.0, -eqSNR[s] / 10.0);
+
+			for (int n = 0; n < EQ_BURSTS; n++) {
+				BitVector burst = randomBurst(&seed);
+				signalVector *mod = modulateBurst(burst, *pulse, 8,
+								  SAMPSPERSYM);
+				signalVector rx(mod->size());
+				rx.fill(0.0);
+
+				for (int k = 0; k < prof.taps; k++) {
+					complex gain(prof.gain[k][0], prof.gain[k][1]);
+					for (size_t i = k * SAMPSPERSYM; i < rx.size(); i++)
+						rx[i] += gain * (*mod)[i - k * SAMPSPERSYM];
+				}
+				delete mod;
+
+				signalVector *noise = gaussianNoise(rx.size(), variance);
+				addVector(rx, *noise);
+				delete noise;
+
+				complex amplitude;
+				float TOA, chanOffset;
+				signalVector dfeBurst(rx), mlseBurst(rx);
+
+				if (!analyzeTrafficBurst(rx, BENCH_TSC, 3.0, SAMPSPERSYM,
+							 &amplitude, &TOA, EQ_MAX_DELAY,
+							 &chan, &chanOffset, ws))
+					continue;
+				detected++;
+
+				demodulateBurst(rx, *pulse, SAMPSPERSYM,
+						amplitude, TOA, bits, ws);
+				errors[0] += payloadErrors(burst, bits);
+
+				scaleVector(chan, complex(1.0, 0.0) / amplitude);
+				scaleVector(dfeBurst, complex(1.0, 0.0) / amplitude);
+				scaleVector(mlseBurst, complex(1.0, 0.0) / amplitude);
+
+				signalVector *w = NULL, *b = NULL;
+				designDFE(chan, amplitude.norm2() / variance, 7, &w, &b);
+
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				c0 = readTSC();
+				equalizeBurst(dfeBurst, TOA - chanOffset, SAMPSPERSYM,
+					      *w, *b, bits, ws);
+				c1 = readTSC();
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				errors[1] += payloadErrors(burst, bits);
+				dfeCycles += c1 - c0;
+				dfeUs += elapsedUs(t0, t1);
+				delete w;
+				delete b;
+
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				c0 = readTSC();
+				mlseEqualizeBurst(mlseBurst, TOA - chanOffset, SAMPSPERSYM,
+						  chan, bits, ws);
+				c1 = readTSC();
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				errors[2] += payloadErrors(burst, bits);
+				mlseCycles += c1 - c0;
+				mlseUs += elapsedUs(t0, t1);
+				timed++;
+			}
+
+			/* 116 payload bits per burst */
+			double total = detected ? detected * 116.0 : 1.0;
+			printf("  %-14s %4.0f %7.1f%% %10.5f %10.5f %10.5f\n",
+			       prof.name, eqSNR[s], 100.0 * detected / EQ_BURSTS,
+			       errors[0] / total, errors[1] / total,
+			       errors[2] / total);
+		}
+	}
+
+	if (!timed)
+		return;
+
+	printf("  DFE  %8.2f us %10.0f cycles per burst\n",
+	       dfeUs / timed, (double) dfeCycles / timed);
+	printf("  MLSE %8.2f us %10.0f cycles per burst\n",
+	       mlseUs / timed, (double) mlseCycles / timed);
+}
+
+/*
+ * Time RACH detection of an access burst on every timeslot of every ARFCN,
+ * as during a RACH storm, one burst at a time in the time domain and as a
+ * single frequency domain batch.
+ */
+static bool benchRACH(int numARFCN, signalVector *pulse)
+{
+	int i, n, num = 8 * numARFCN;
+	unsigned seed = 4;
+	struct timespec t0, t1;
+	vector<float> scalarLat, batchLat;
+	vector<signalVector *> bursts;
+	unsigned scalarDetected = 0, batchDetected = 0;
+
+	DemodWorkspace ws(SAMPSPERSYM);
+	RACHBatch batch(num, SAMPSPERSYM);
+
+	for (n = 0; n < num; n++) {
+		signalVector *mod = modulateBurst(randomAccessBurst(&seed), *pulse,
+						  68, SAMPSPERSYM);
+		signalVector *burst = new signalVector(mod->size());
+		burst->fill(0.0);
+
+		/* Spread arrival times over the access burst guard period */
+		int delay = (n % 32) * SAMPSPERSYM;
+		for (size_t k = 0; k + delay < burst->size(); k++)
+			(*burst)[k + delay] = (*mod)[k];
+		delete mod;
+
+		signalVector *noise = gaussianNoise(burst->size(), 0.01);
+		addVector(*burst, *noise);
+		delete noise;
+
+		bursts.push_back(burst);
+	}
+
+	scalarLat.reserve(RACH_ITERS);
+	batchLat.reserve(RACH_ITERS);
+
+	for (i = 0; i < RACH_ITERS; i++) {
+		scalarDetected = 0;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < num; n++) {
+			complex amplitude;
+			float TOA;
+
+			if (detectRACHBurst(*bursts[n], RACH_DETECT_THRESHOLD,
+					    SAMPSPERSYM, &amplitude, &TOA, ws))
+				scalarDetected++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		scalarLat.push_back(elapsedUs(t0, t1));
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		batch.clear();
+		for (n = 0; n < num; n++)
+			batch.add(*bursts[n]);
+		batchDetected = batch.detect(RACH_DETECT_THRESHOLD);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		batchLat.push_back(elapsedUs(t0, t1));
+	}
+
+	for (n = 0; n < num; n++)
+		delete bursts[n];
+
+	cout << "RACH detection, " << num << " bursts per frame, "
+	     << RACH_ITERS << " frames" << endl;
+	double scalarMean = printLatency("time domain", scalarLat);
+	double batchMean = printLatency("batched FFT", batchLat);
+	printf("  per burst %.2f us time domain, %.2f us batched\n",
+	       scalarMean / num, batchMean / num);
+
+	if ((scalarDetected != (unsigned) num) ||
+	    (batchDetected != (unsigned) num)) {
+		cout << "RACH detector missed benchmark bursts" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Generate a looped multi-ARFCN signal at the device rate. Each active
+ * channel carries normal bursts with random payloads on every timeslot.
+ * The loop is synthesized twice so the filterbank state at the start of
+ * the kept pass matches the end of the loop.
+ */
+static float *genReplay(int numARFCN, int chanM, int *map,
+			signalVector *pulse, int *len)
+{
+	int i, n, pass, pos, slot;
+	unsigned seed = 2;
+	int lowLen = INCHUNK * REPLAY_CHUNKS;
+	signalVector *streams[CHAN_MAX] = { NULL };
+
+	/* The receive clock labels the first slot RX_OFFSET_SLOTS before TN 0 */
+	for (i = 0; i < numARFCN; i++) {
+		streams[map[i]] = new signalVector(lowLen * SAMPSPERSYM);
+
+		for (pos = 0, slot = 0; pos < lowLen; slot++) {
+			int tn = (slot + 8 - RX_OFFSET_SLOTS) % 8;
+			signalVector *burst = modulateBurst(randomBurst(&seed),
+							    *pulse,
+							    8 + (tn % 4 == 0),
+							    SAMPSPERSYM);
+			scaleVector(*burst, 1.0 / numARFCN);
+			burst->copyToSegment(*streams[map[i]], pos);
+			pos += burst->size();
+			delete burst;
+		}
+	}
+
+	Synthesis *synth = createSynth(chanM, map, numARFCN);
+	if (!synth)
+		return NULL;
+
+	struct cxvec *in[CHAN_MAX];
+	for (n = 0; n < chanM; n++) {
+		in[n] = cxvec_alloc(INCHUNK + RESAMP_FILT_LEN,
+				    RESAMP_FILT_LEN, NULL, 0);
+	}
+	struct cxvec *out = cxvec_alloc(OUTCHUNK * chanM, 0, NULL, 0);
+
+	*len = OUTCHUNK * chanM * REPLAY_CHUNKS;
+	float *replay = new float[2 * *len];
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < REPLAY_CHUNKS; i++) {
+			for (n = 0; n < chanM; n++) {
+				in[n]->len = INCHUNK;
+				if (streams[n]) {
+					memcpy(in[n]->data,
+					       &streams[n]->begin()[i * INCHUNK],
+					       INCHUNK * sizeof(cmplx));
+				} else {
+					memset(in[n]->data, 0,
+					       INCHUNK * sizeof(cmplx));
+				}
+			}
+
+			synth->rotate(in, out);
+
+			if (pass) {
+				memcpy(&replay[2 * i * OUTCHUNK * chanM],
+				       out->data,
+				       OUTCHUNK * chanM * sizeof(cmplx));
+			}
+		}
+	}
+
+	for (n = 0; n < chanM; n++) {
+		cxvec_free(in[n]);
+		delete streams[n];
+	}
+	cxvec_free(out);
+	delete synth;
+
+	return replay;
+}
+
+static float *loadReplay(const char *file, int *len)
+{
+	FILE *fp = fopen(file, "r");
+	if (!fp) {
+		cout << "Failed to open replay file " << file << endl;
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	*len = ftell(fp) / (2 * sizeof(float));
+	fseek(fp, 0, SEEK_SET);
+
+	float *replay = new float[2 * *len];
+	if (!*len || (fread(replay, 2 * sizeof(float), *len, fp) != (size_t) *len)) {
+		cout << "Failed to read replay file " << file << endl;
+		delete[] replay;
+		replay = NULL;
+	}
+
+	fclose(fp);
+	return replay;
+}
+
+/* Issue a control command and check the response status */
+static bool sendCommand(UDPSocket *sock, const char *cmd)
+{
+	char response[MAX_UDP_LENGTH];
+	char name[MAX_UDP_LENGTH];
+	int status = -1;
+
+	sock->write(cmd, strlen(cmd) + 1);
+	if (sock->read(response, 1000) <= 0) {
+		cout << "No response to " << cmd << endl;
+		return false;
+	}
+
+	sscanf(response, "RSP %s %d", name, &status);
+	if (status) {
+		cout << "Command failed: " << cmd << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Device timestamp at the end of a received burst. Counting from the first
+ * received slot, every fourth slot starting from TN 0 is 157 symbols long.
+ */
+static TIMESTAMP burstStamp(CoreChannel *core, int fn, int tn)
+{
+	long long slot = (long long) (GSM::Time(fn, tn) - core->start) * 8 +
+			 tn - core->start.TN() + RX_OFFSET_SLOTS;
+	long long sym = (slot + 1) * 156 + (slot + 4 - RX_OFFSET_SLOTS % 4) / 4;
+
+	return core->dev->initialReadTimestamp() + sym * SAMPSPERSYM *
+	       RESAMP_OUTRATE * core->chanM / RESAMP_INRATE;
+}
+
+/* Send the batched transmit bursts of a core channel */
+static void flushFrame(CoreChannel *core)
+{
+	core->data->write(core->txFrame->data(), core->txFrame->size());
+	core->txFrame->clear();
+}
+
+/* Record latency of one received burst and answer it */
+static void answerBurst(CoreChannel *core, int fn, int tn,
+			const struct timespec &now)
+{
+	char txBuffer[gSlotLen + 6];
+	struct timespec readTime;
+	BurstRecord record;
+
+	core->rxBursts++;
+
+	if (core->measure &&
+	    core->dev->readTime(burstStamp(core, fn, tn) - 1, &readTime))
+		core->latency.push_back(elapsedUs(readTime, now));
+
+	GSM::Time txTime = GSM::Time(fn, tn) + TX_LEAD_FRAMES;
+	txBuffer[0] = txTime.TN();
+	for (int i = 0; i < 4; i++)
+		txBuffer[1 + i] = (txTime.FN() >> ((3 - i) * 8)) & 0x0ff;
+	txBuffer[5] = 0;
+
+	for (unsigned i = 0; i < gSlotLen; i++)
+		txBuffer[6 + i] = rand_r(&core->seed) & 0x01;
+
+	if (core->link.isOpen()) {
+		record.TN = txTime.TN();
+		record.FN = txTime.FN();
+		record.power = 0;
+		record.timing = 0;
+		memcpy(record.data, &txBuffer[6], gSlotLen);
+
+		if (core->link.downlink()->write(record))
+			core->txBursts++;
+		return;
+	}
+
+	/* Batch by frame as the GSM core does */
+	if (core->txFrame) {
+		if (!core->txFrame->empty() && (txTime.FN() != core->txFrameFN))
+			flushFrame(core);
+
+		core->txFrame->addHard(txTime.TN(), txTime.FN(), 0, &txBuffer[6]);
+		core->txFrameFN = txTime.FN();
+		if (core->txFrame->full())
+			flushFrame(core);
+
+		core->txBursts++;
+		return;
+	}
+
+	core->data->write(txBuffer, gSlotLen + 6);
+	core->txBursts++;
+}
+
+/*
+ * Stand-in for the GSM core on one ARFCN. Every demodulated burst is
+ * answered with a random transmit burst a few frames ahead, so transmit
+ * load follows the receive rate.
+ */
+static void *coreLoop(CoreChannel *core)
+{
+	char buffer[MAX_UDP_LENGTH];
+	struct timespec now;
+	BurstRecord records[BURST_FRAME_MAX];
+	int len, count;
+
+	while (core->running) {
+		count = 1;
+
+		if (core->link.isOpen()) {
+			if (!core->link.uplink()->read(records[0], 100))
+				continue;
+		} else {
+			len = core->data->read(buffer, 100);
+
+			if (BurstFrame::isFrame(buffer, len)) {
+				count = BurstFrame::parse(buffer, len, records);
+				if (count < 0)
+					continue;
+			} else {
+				if (len < (int) gSlotLen + 8)
+					continue;
+
+				records[0].TN = buffer[0];
+				records[0].FN = 0;
+				for (int i = 0; i < 4; i++)
+					records[0].FN = (records[0].FN << 8) |
+							(0x0ff & buffer[i + 1]);
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		for (int n = 0; n < count; n++)
+			answerBurst(core, records[n].FN, records[n].TN, now);
+	}
+
+	return NULL;
+}
+
+/*
+ * Run the full transceiver stack on replayed samples and report burst
+ * rates, receive latency from device read to demodulated burst, and the
+ * ARFCN's per core implied by the measured CPU time.
+ */
+static bool benchPipeline(int numARFCN, int chanM, int *map, int numDevices,
+			  const float *replay, int replayLen, double offset,
+			  int numWorkers, double speed, double seconds,
+			  int slack, int basePort, bool shm, int batch)
+{
+	int d, i, tn, numTrx = numDevices * numARFCN;
+	char cmd[MAX_UDP_LENGTH];
+	Transceiver *trx[MAX_DEVICES * CHAN_MAX];
+	CoreChannel core[MAX_DEVICES * CHAN_MAX];
+	DummyLoad *dev[MAX_DEVICES];
+	RadioInterface *radio[MAX_DEVICES];
+	DriveLoop *drive[MAX_DEVICES];
+
+	WorkerPool *pool = new WorkerPool(numWorkers);
+
+	for (d = 0; d < numDevices; d++) {
+		dev[d] = new DummyLoad(chanM * CHAN_RATE, offset);
+		dev[d]->open();
+		dev[d]->loadSamples(replay, replayLen);
+		dev[d]->setSpeed(speed);
+
+		radio[d] = new RadioInterface(dev[d], chanM, RX_OFFSET_SLOTS,
+					      SAMPSPERSYM, 0, false);
+
+		/* Secondary devices send clock indications through the first */
+		if (!d) {
+			drive[d] = new DriveLoop(basePort, "127.0.0.1", chanM,
+						 map[0], SAMPSPERSYM,
+						 GSM::Time(3,0), radio[d]);
+		} else {
+			drive[d] = new DriveLoop(0, NULL, chanM, -1,
+						 SAMPSPERSYM, GSM::Time(3,0),
+						 radio[d], drive[0]);
+		}
+		drive[d]->setWorkerPool(pool);
+		drive[d]->setTransmitSlack(slack);
+
+		for (i = 0; i < numARFCN; i++) {
+			int n = d * numARFCN + i;
+
+			radio[d]->activateChan(map[i]);
+			trx[n] = new Transceiver(basePort + 2 * n, "127.0.0.1",
+						 SAMPSPERSYM, radio[d], drive[d],
+						 map[i], i == 0);
+			pool->attach(trx[n]);
+		}
+
+		/* Only TRX0 is powered on, like from the GSM core */
+		if (d)
+			trx[0]->addSecondary(trx[d * numARFCN]);
+	}
+
+	for (i = 0; i < numTrx; i++)
+		trx[i]->start();
+	pool->start();
+
+	/* Absorb clock indications */
+	UDPSocket clockSocket(basePort + 100, "127.0.0.1", basePort);
+
+	for (i = 0; i < numTrx; i++) {
+		core[i].index = i;
+		core[i].txFrame = NULL;
+		core[i].control = new UDPSocket(basePort + 2 * i + 101,
+						"127.0.0.1", basePort + 2 * i + 1);
+		core[i].data = new UDPSocket(basePort + 2 * i + 102,
+					     "127.0.0.1", basePort + 2 * i + 2);
+		core[i].dev = dev[i / numARFCN];
+		core[i].chanM = chanM;
+		core[i].seed = 3 + i;
+		core[i].running = true;
+		core[i].measure = false;
+		core[i].rxBursts = 0;
+		core[i].txBursts = 0;
+		core[i].latency.reserve((size_t) (seconds * BURST_RATE * 8));
+
+		if (shm) {
+			sprintf(cmd, "/transceiverBench.%d.%d", getpid(), i);
+			if (!core[i].link.create(cmd)) {
+				cout << "Failed to create shared memory " << cmd << endl;
+				return false;
+			}
+
+			sprintf(cmd, "CMD SETSHM /transceiverBench.%d.%d",
+				getpid(), i);
+			bool ok = sendCommand(core[i].control, cmd);
+			core[i].link.unlink();
+			if (!ok)
+				return false;
+		}
+
+		if (batch > 0) {
+			sprintf(cmd, "CMD SETFORMAT %d %d", BURST_FRAME_VERSION,
+				batch);
+			if (!sendCommand(core[i].control, cmd))
+				return false;
+
+			core[i].txFrame = new BurstFrame(BurstFrame::HardPacked,
+							 batch);
+		}
+
+		if (!sendCommand(core[i].control, "CMD RXTUNE 890000") ||
+		    !sendCommand(core[i].control, "CMD TXTUNE 935000"))
+			return false;
+
+		for (tn = 0; tn < 8; tn++) {
+			sprintf(cmd, "CMD SETSLOT %d %d", tn, DriveLoop::I);
+			if (!sendCommand(core[i].control, cmd))
+				return false;
+		}
+	}
+
+	sprintf(cmd, "CMD SETTSC %d", BENCH_TSC);
+	if (!sendCommand(core[0].control, cmd))
+		return false;
+
+	/* Secondary devices are started by TRX0 and set their clock from it */
+	if (!sendCommand(core[0].control, "CMD POWERON"))
+		return false;
+
+	for (i = 0; i < numTrx; i++) {
+		core[i].start = drive[i / numARFCN]->getStartTime();
+		core[i].thread = new Thread(32768);
+		core[i].thread->start((void * (*)(void*)) coreLoop,
+				      (void *) &core[i]);
+	}
+
+	sleep(WARMUP_SECS);
+
+	/* Measurement interval */
+	struct timespec t0, t1;
+	unsigned rx0 = 0, tx0 = 0, rx1 = 0, tx1 = 0;
+
+	for (i = 0; i < numTrx; i++) {
+		rx0 += core[i].rxBursts;
+		tx0 += core[i].txBursts;
+		core[i].measure = true;
+	}
+	double cpu0 = cpuSeconds();
+	double read0 = dev[0]->numberRead();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	usleep((useconds_t) (seconds * 1.0e6));
+
+	for (i = 0; i < numTrx; i++) {
+		core[i].measure = false;
+		rx1 += core[i].rxBursts;
+		tx1 += core[i].txBursts;
+	}
+	double cpu1 = cpuSeconds();
+	double read1 = dev[0]->numberRead();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	for (i = 0; i < numTrx; i++) {
+		core[i].running = false;
+		core[i].thread->join();
+	}
+
+	double wall = elapsedUs(t0, t1) * 1.0e-6;
+	double gsmSecs = (read1 - read0) / (chanM * CHAN_RATE);
+	double rtf = gsmSecs / wall;
+	double cores = (cpu1 - cpu0) / wall;
+	double delivered = (rx1 - rx0) / (gsmSecs * BURST_RATE * numTrx);
+
+	vector<float> latency;
+	for (i = 0; i < numTrx; i++)
+		latency.insert(latency.end(), core[i].latency.begin(),
+			       core[i].latency.end());
+
+	cout << "Pipeline, " << numTrx << " ARFCN's on " << numDevices
+	     << " x " << chanM << " channels, " << pool->size() << " workers";
+	if (slack > 0)
+		cout << ", transmit paced at " << slack << " slots of slack";
+	if (shm)
+		cout << ", shared memory bursts";
+	else if (batch > 0)
+		cout << ", " << batch << " bursts per datagram";
+	cout << endl;
+	printf("  %.2f s of GSM time in %.2f s, %.2fx real time\n",
+	       gsmSecs, wall, rtf);
+	printf("  received %.0f bursts/s, transmitted %.0f bursts/s, "
+	       "%.1f%% of receive slots delivered\n",
+	       (rx1 - rx0) / wall, (tx1 - tx0) / wall, 100.0 * delivered);
+	printLatency("rx latency", latency);
+	printf("  %.2f cores busy, %.1f ARFCN's per core\n",
+	       cores, cores > 0.0 ? numTrx * rtf / cores : 0.0);
+
+	if (delivered < 0.99) {
+		cout << "  Receive bursts were lost, reduce the speed "
+		     << "for a sustainable rate" << endl;
+	}
+
+	/* Stage probes of the shared radio threads and the first transceiver */
+	core[0].control->write("CMD STATS", strlen("CMD STATS") + 1);
+	if (core[0].control->read(cmd, 1000) > 0)
+		cout << "  " << cmd << endl;
+
+	/* Transceiver threads block on their sockets, exit without teardown */
+	for (i = 0; i < numTrx; i++)
+		trx[i]->shutdown();
+	pool->stop();
+
+	return true;
+}
+
+static void usage(const char *prog)
+{
+	cout << "Usage: " << prog << " [-c ARFCNs] [-d devices] [-w workers] "
+	     << "[-t seconds] [-s speed] [-l slack] [-f file] [-p port] [-m] "
+	     << "[-b batch]" << endl;
+	cout << "  -c  number of ARFCN's per device (default 1)" << endl;
+	cout << "  -d  number of devices (default 1)" << endl;
+	cout << "  -w  demodulation workers (default one per ARFCN)" << endl;
+	cout << "  -t  pipeline measurement time in seconds (default 10)" << endl;
+	cout << "  -s  sample clock speed relative to real time, "
+	     << "0 for unpaced (default 0)" << endl;
+	cout << "  -l  transmit slack in timeslots, 0 to wake on every "
+	     << "clock update (default 0)" << endl;
+	cout << "  -f  replay file of float I/Q at the device rate" << endl;
+	cout << "  -p  base UDP port (default 6700)" << endl;
+	cout << "  -m  exchange bursts over shared memory instead of UDP" << endl;
+	cout << "  -b  bursts per framed UDP datagram, 0 for single bursts "
+	     << "(default 0)" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, chanM, replayLen;
+	double offset;
+	int numARFCN = 1, numDevices = 1, numWorkers = 0, slack = 0, basePort = 6700;
+	double seconds = 10.0, speed = 0.0;
+	const char *file = NULL;
+	bool shm = false;
+	int batch = 0;
+	int chanMap[CHAN_MAX];
+	float *replay;
+
+	while ((opt = getopt(argc, argv, "c:d:w:t:s:l:f:p:mb:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			numARFCN = atoi(optarg);
+			break;
+		case 'd':
+			numDevices = atoi(optarg);
+			break;
+		case 'w':
+			numWorkers = atoi(optarg);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 's':
+			speed = atof(optarg);
+			break;
+		case 'l':
+			slack = atoi(optarg);
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'p':
+			basePort = atoi(optarg);
+			break;
+		case 'm':
+			shm = true;
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((numARFCN < 1) || (numARFCN > (CHAN_MAX - 1))) {
+		cout << numARFCN << " channels not supported" << endl;
+		return 1;
+	}
+
+	if ((numDevices < 1) || (numDevices > MAX_DEVICES)) {
+		cout << numDevices << " devices not supported" << endl;
+		return 1;
+	}
+
+	if (numWorkers < 1)
+		numWorkers = numARFCN * numDevices;
+
+	gLogInit("transceiverBench", "WARNING");
+	srandom(1);
+
+	/* Channelizer selection as in the multi-ARFCN transceiver */
+	switch (numARFCN) {
+	case 1:
+		chanM = 1;
+		break;
+	case 2:
+	case 3:
+		chanM = 5;
+		break;
+	default:
+		chanM = 10;
+	}
+	genChanMap(numARFCN, chanM, chanMap);
+
+	sigProcLibSetup(SAMPSPERSYM);
+	signalVector *pulse = generateGSMPulse(2, SAMPSPERSYM);
+	generateMidamble(*pulse, SAMPSPERSYM, BENCH_TSC);
+	generateRACHSequence(*pulse, SAMPSPERSYM);
+
+	if (!benchStages(numARFCN, chanM, chanMap, pulse))
+		return 1;
+
+	benchEqualizers(pulse);
+
+	if (!benchRACH(numARFCN, pulse))
+		return 1;
+
+	offset = getRadioOffset(chanM);
+	if (file) {
+		replay = loadReplay(file, &replayLen);
+	} else {
+		replay = genReplay(numARFCN, chanM, chanMap, pulse, &replayLen);
+		offset += REPLAY_DELAY_SYMS / GSM_RATE;
+	}
+
+	if (!replay)
+		return 1;
+
+	if (!benchPipeline(numARFCN, chanM, chanMap, numDevices, replay,
+			   replayLen, offset, numWorkers, speed, seconds,
+			   slack, basePort, shm, batch))
+		return 1;
+
+	delete[] replay;
+	delete pulse;
+
+	return 0;
+}
@@ -171,7 +171,6 @@ int main(int argc, char *argv[])
 	// Start the transceiver interface.
 	// Sleep long enough for the USRP to bootload.
 	sleep(5);
-	gTRX.start();
 
 	// Set up the interface to the radio.
 	// Get a handle to the C0 transceiver interface.
@@ -179,7 +178,10 @@ int main(int argc, char *argv[])
 
 	// Tuning.
 	// Make sure its off for tuning.
+	// This also drops any shared memory link, so do it before the start offers one.
 	C0radio->powerOff();
+
+	gTRX.start();
 	// Get the ARFCN list.
 	unsigned C0 = gConfig.getNum("GSM.Radio.C0");
 	unsigned numARFCNs = gConfig.getNum("GSM.Radio.ARFCNs");
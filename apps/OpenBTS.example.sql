@@ -119,8 +119,19 @@ INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.Url','http://127.0.0.1/c
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.VisibleColumns','name username type context host',0,0,'Field names in subscriber registry visible in the database manager.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.db','/var/lib/asterisk/sqlite3dir/sqlite3.db',0,0,'The location of the sqlite3 database holding the subscriber registry.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Port','5064',0,0,'Port used by the SIP Authentication Server. NOTE: In some older releases (pre-2.8.1) this is called SIP.myPort.');
+INSERT INTO "CONFIG" VALUES('TRX.Affinity.Receive',NULL,1,1,'If not NULL, space-separated list of CPU numbers to pin the multi-ARFCN transceiver receive and channelizer threads to, one per device in device order.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Affinity.Transmit',NULL,1,1,'If not NULL, space-separated list of CPU numbers to pin the multi-ARFCN transceiver transmit and synthesis threads to, one per device in device order.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Affinity.Workers',NULL,1,1,'If not NULL, space-separated list of CPU numbers to pin the multi-ARFCN transceiver demodulation workers to, in worker order.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Batch',NULL,1,1,'If not NULL, number of bursts from 1 to 8 that the core and transceiver pack into each framed UDP datagram, with transmit bits packed 8 to a byte.  Transmit bursts of a frame are sent together when the batch fills, when the first burst of a later frame is written, or at the latest when the core clock reaches that frame, which is still ahead of the radio by the transceiver latency.  Not used with TRX.SharedMemory.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Devices',NULL,1,1,'If not NULL, space-separated list of UHD device arguments, such as serial=1234 or addr=192.168.10.2, one per radio device driven by the multi-ARFCN transceiver.  ARFCNs are spread evenly across the devices, each with its own channelizer and radio threads.  All devices must share a frequency reference and a PPS signal, see TRX.Devices.PPS; the first device provides the clock to the core.  By default, the first device found is used.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Devices.PPS',NULL,1,1,'If not NULL and non-zero, the devices in TRX.Devices share a 10 MHz reference and a PPS signal on their reference and PPS inputs.  At start, every device time is set on the same PPS edge, and each device starts streaming on a multiple of 60 ms of that time, so GSM time follows the sample timestamps on every device.  Required with more than one device.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Equalizer',NULL,1,1,'If not NULL, receive equalizer used by the multi-ARFCN transceiver when GSM.Radio.MaxExpectedDelaySpread is greater than 1.  DFE for decision feedback or MLSE for maximum likelihood sequence estimation.  By default, DFE.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.IP','127.0.0.1',1,0,'IP address of the transceiver application.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.Workers',NULL,1,1,'If not NULL, number of demodulation worker threads in the multi-ARFCN transceiver.  By default, one worker per ARFCN limited by the available CPUs.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.Port','5700',1,0,'IP port of the transceiver application.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.RadioFrequencyOffset','128',1,0,'Fine-tuning adjustment for the transceiver master clock.  Roughly 170 Hz/step.  Set at the factory.  Do not adjust without proper calibration.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.SharedMemory',NULL,1,1,'If not NULL and non-zero, offer the transceiver a shared memory segment per ARFCN for bursts instead of the UDP data sockets.  Only takes effect when the transceiver runs on the same host and accepts it; otherwise bursts stay on UDP.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.TransmitSlack',NULL,1,1,'If not NULL and greater than zero, the multi-ARFCN transceiver transmit thread sleeps until only this many timeslots of lead remain on the next burst and then pushes all due bursts at once, instead of waking on every radio clock update.  Must be less than the transmit latency of 24 timeslots.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.TxSC16',NULL,1,1,'If not NULL and non-zero, the multi-ARFCN transceiver converts synthesized transmit samples directly to 16-bit I/Q for the device instead of sending floating point.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.TxAttenOffset','2',1,0,'Hardware-specific gain adjustment for transmitter, matched to the power amplifier, expessed as an attenuationi in dB.  Set at the factory.  Do not adjust without proper calibration.  Static.');
 COMMIT;